@@ -1,7 +1,12 @@
 #include "BrickMap.hpp"
+#include <bit>
+#include <cfloat>
 #include <cmath>
 
-#include "Math/PerlinNoise.hpp"
+#include "Math/Normal.hpp"
+#include "Math/PerlinNoiseBatch.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
 
 BrickMap::BrickMap(vec3 position, ivec3 dimensions, float voxelSize)
     : m_VoxelSize(voxelSize) {
@@ -67,14 +72,178 @@ void
 BrickMap::PrintByteSize() const {
     const size_t sizeGrid = m_Grid.size() * sizeof(uint32);
     const size_t sizeBricks = m_Bricks.size() * sizeof(Brick);
+    const size_t sizePointers = (m_ColorPointers.size() + m_Parents.size()) * sizeof(uint32);
     const size_t sizeTextures = m_Textures.size() * sizeof(BrickTexture);
-    std::cout << "Size of brick map: " << PrefixedSize(sizeGrid + sizeBricks + sizeTextures) << '\n';
+    const size_t sizeLods = m_Lods.size() * sizeof(BrickLod);
+    std::cout << "Size of brick map: "
+            << PrefixedSize(sizeGrid + sizeBricks + sizePointers + sizeTextures + sizeLods) << '\n';
     std::cout << "\tGrid:\t\t" << PrefixedSize(sizeGrid) << '\n';
     std::cout << "\tBricks:\t\t" << PrefixedSize(sizeBricks) << '\n';
+    std::cout << "\tPointers:\t" << PrefixedSize(sizePointers) << '\n';
     std::cout << "\tTextures:\t" << PrefixedSize(sizeTextures) << '\n';
+    std::cout << "\tLODs:\t\t" << PrefixedSize(sizeLods) << '\n';
 
     std::cout << "Total grid cells: " << m_Grid.size() << '\n';
     std::cout << "Filled grid cells: " << m_Bricks.size() << '\n';
+    std::cout << "Voxels: " << m_VoxelCount << '\n';
+}
+
+// Sums colors so that LOD cells can be averaged, weight is the number of voxels a color represents.
+struct ColorSum {
+    void Add(const math::Color color, const uint32 weight) {
+        r += color.r * weight;
+        g += color.g * weight;
+        b += color.b * weight;
+        count += weight;
+    }
+
+    math::Color Average() const {
+        if (count == 0)
+            return {};
+        return {static_cast<uint8>(r / count), static_cast<uint8>(g / count), static_cast<uint8>(b / count), 255};
+    }
+
+    uint32 r = 0, g = 0, b = 0, count = 0;
+};
+
+// Counts the voxels in a cube of a brick, size is the side length and min must be aligned to it.
+static uint32
+CountVoxels(const BrickMap::Brick &brick, const ivec3 &min, const int size) {
+    // Every byte of the bitmask is one row of 8 voxels along x.
+    const uint32 rowMask = ((1u << size) - 1) << min.x;
+    uint32 count = 0;
+    for (int z = min.z; z < min.z + size; ++z) {
+        for (int y = min.y; y < min.y + size; ++y) {
+            const uint32 row = brick.bitmask[(y + 8 * z) / 4] >> (y % 4 * 8) & 0xFF;
+            count += std::popcount(row & rowMask);
+        }
+    }
+    return count;
+}
+
+static ivec3
+ChildOffset(const uint32 child) {
+    return {child & 1, child >> 1 & 1, child >> 2 & 1};
+}
+
+static void
+ResolveCell4(const BrickMap::Brick &brick, const BrickMap::BrickTexture &texture, BrickMap::BrickLod &lod,
+             const ivec3 &cell) {
+    ColorSum sum;
+    for (uint32 i = 0; i < 8; ++i) {
+        const uint32 voxelIndex = Flatten(cell * 2 + ChildOffset(i), ivec3(8));
+        if (brick.VoxelAt(voxelIndex))
+            sum.Add(texture.voxels[voxelIndex], 1);
+    }
+
+    const uint32 index = Flatten(cell, ivec3(4));
+    const uint32 bit = 1u << index % 32;
+    lod.colors4[index] = sum.Average();
+    lod.occupancy4[index / 32] = sum.count != 0 ? lod.occupancy4[index / 32] | bit : lod.occupancy4[index / 32] & ~bit;
+}
+
+static void
+ResolveCell2(const BrickMap::Brick &brick, BrickMap::BrickLod &lod, const ivec3 &cell) {
+    ColorSum sum;
+    for (uint32 i = 0; i < 8; ++i) {
+        const ivec3 child = cell * 2 + ChildOffset(i);
+        sum.Add(lod.colors4[Flatten(child, ivec3(4))], CountVoxels(brick, child * 2, 2));
+    }
+
+    const uint32 index = Flatten(cell, ivec3(2));
+    lod.colors2[index] = sum.Average();
+    lod.occupancy2 = sum.count != 0 ? lod.occupancy2 | 1u << index : lod.occupancy2 & ~(1u << index);
+}
+
+void
+BrickMap::UpdateLod(const uint32 brickIndex, const ivec3 &localPosition) {
+    const Brick &brick = m_Bricks[brickIndex];
+    BrickLod &lod = m_Lods[brickIndex];
+
+    ResolveCell4(brick, m_Textures[m_ColorPointers[brickIndex]], lod, localPosition / 2);
+    ResolveCell2(brick, lod, localPosition / 4);
+    lod.color = m_Infos[brickIndex].GetAverageColor();
+}
+
+void
+BrickMap::BuildLod(const uint32 brickIndex) {
+    const Brick &brick = m_Bricks[brickIndex];
+    BrickLod &lod = m_Lods[brickIndex] = {};
+
+    for (int z = 0; z < 4; ++z) {
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                ResolveCell4(brick, m_Textures[m_ColorPointers[brickIndex]], lod, {x, y, z});
+            }
+        }
+    }
+    for (uint32 i = 0; i < 8; ++i) {
+        ResolveCell2(brick, lod, ChildOffset(i));
+    }
+    lod.color = m_Infos[brickIndex].GetAverageColor();
+}
+
+const BrickMap::BrickInfo &
+BrickMap::GetBrickInfo(const uint32 brickIndex) {
+    BrickInfo &info = m_Infos[brickIndex];
+    if (!info.boundsDirty)
+        return info;
+
+    // Every byte of the bitmask is one row along x, so the bounds can be found from which rows are set.
+    const Brick &brick = m_Bricks[brickIndex];
+    uint32 rows = 0, rowsY = 0, rowsZ = 0;
+    for (uint32 i = 0; i < BRICK_SIZE / 32; ++i) {
+        const uint32 word = brick.bitmask[i];
+        if (word == 0)
+            continue;
+
+        rowsZ |= 1u << i / 2;
+        for (uint32 byte = 0; byte < 4; ++byte) {
+            const uint32 row = word >> (byte * 8) & 0xFF;
+            if (row != 0) {
+                rows |= row;
+                rowsY |= 1u << (i % 2 * 4 + byte);
+            }
+        }
+    }
+
+    if (rows == 0) {
+        info.min = ivec3(BRICK_DIMENSIONS);
+        info.max = ivec3(-1);
+    } else {
+        info.min = {std::countr_zero(rows), std::countr_zero(rowsY), std::countr_zero(rowsZ)};
+        info.max = ivec3(std::bit_width(rows), std::bit_width(rowsY), std::bit_width(rowsZ)) - 1;
+    }
+    info.boundsDirty = false;
+    return info;
+}
+
+BrickMap::BrickInfo
+BrickMap::ComputeBrickInfo(const uint32 brickIndex) const {
+    const Brick &brick = m_Bricks[brickIndex];
+    const BrickTexture &texture = m_Textures[m_ColorPointers[brickIndex]];
+
+    BrickInfo info;
+    for (int z = 0; z < BRICK_DIMENSIONS; ++z) {
+        for (int y = 0; y < BRICK_DIMENSIONS; ++y) {
+            for (int x = 0; x < BRICK_DIMENSIONS; ++x) {
+                const uint32 voxelIndex = Flatten({x, y, z}, ivec3(BRICK_DIMENSIONS));
+                if (brick.VoxelAt(voxelIndex))
+                    info.Add({x, y, z}, texture.voxels[voxelIndex]);
+            }
+        }
+    }
+    return info;
+}
+
+uint32
+BrickMap::SelectLod(const float distance, const float footprint) const {
+    // Size of a pixel measured in voxels.
+    const float pixelSize = distance * footprint / m_VoxelSize;
+    if (pixelSize < 2.0f)
+        return 0;
+
+    return std::min(static_cast<uint32>(std::log2(pixelSize)), static_cast<uint32>(BRICK_LOD_LEVELS - 1));
 }
 
 struct DataDDA {
@@ -85,6 +254,11 @@ struct DataDDA {
         gridStep = signDir;
         tDelta = signDir / ray.direction;
         tMax = (signDir * (vec3(position) - rayStart) + signDir * 0.5f + 0.5f) * tDelta;
+        // Axes the ray does not move along are never stepped, 0 / 0 would make them win every comparison.
+        for (int axis = 0; axis < 3; ++axis) {
+            if (gridStep[axis] == 0)
+                tDelta[axis] = tMax[axis] = FLT_MAX;
+        }
 
         stepAxis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : tMax.y < tMax.z ? 1 : 2;
         outOfBounds = ivec3(greaterThan(ray.direction, vec3(0))) * (gridSize + 1) - 1;
@@ -100,6 +274,12 @@ struct DataDDA {
         return position.x != outOfBounds.x && position.y != outOfBounds.y && position.z != outOfBounds.z;
     }
 
+    // Ray parameter in cells where the current cell was entered, the last plane crossed on any axis.
+    float EntryT() const {
+        const vec3 entry = tMax - tDelta;
+        return std::max(std::max(entry.x, entry.y), entry.z);
+    }
+
     vec3 rayStart{};
     ivec3 outOfBounds{};
     ivec3 position{};
@@ -110,19 +290,36 @@ struct DataDDA {
 };
 
 std::optional<VoxelHitResult>
-BrickMap::RayCast(const math::Ray &ray) {
+BrickMap::RayCast(const math::Ray &ray, const float footprint, TraversalRecorder *recorder, const float minDistance,
+                  const float maxDistance) {
+    PROFILE_SCOPE("BrickMap::RayCast");
+    RayCounters counters;
+    auto hit = TraverseCoarse(ray, footprint, minDistance, maxDistance, counters, recorder);
+    if (recorder)
+        recorder->RecordRay(counters.coarseSteps, counters.fineSteps, counters.bricksEntered, hit.has_value());
+    return hit;
+}
+
+std::optional<VoxelHitResult>
+BrickMap::TraverseCoarse(const math::Ray &ray, const float footprint, const float minDistance,
+                         const float maxDistance, RayCounters &counters, TraversalRecorder *recorder) {
     float tNear, tFar;
-    if (!ray.Intersect(m_BoundingBox, tNear, tFar)) {
+    if (!ray.Intersect(m_BoundingBox, tNear, tFar) || minDistance >= tFar || tNear > maxDistance) {
         return {};
     }
-    tNear = std::max(tNear + 1e-3f, 0.0f);
+    tNear = std::max(tNear + 1e-3f, minDistance);
     const ivec3 gridSize = m_Dimensions;
     const float brickSize = m_VoxelSize * BRICK_DIMENSIONS;
     DataDDA data(brickSize, {ray.origin + ray.direction * tNear - m_BoundingBox.min, ray.direction}, gridSize);
 
-    while (data.InBounds()) {
-        if (m_Grid[Flatten(data.position, gridSize)] != EMPTY_BRICK) {
+    while (data.InBounds() && tNear + data.EntryT() * brickSize <= maxDistance) {
+        const uint32 brickIndex = m_Grid[GetCellIndex(data.position)];
+        if (brickIndex != EMPTY_BRICK) {
             //std::cout << "Found brick\n";
+            counters.bricksEntered++;
+            if (recorder)
+                recorder->VisitBrick(brickIndex);
+
             vec3 lastTMax = data.tMax - data.tDelta[data.stepAxis];
             lastTMax[data.stepAxis] -= data.tDelta[data.stepAxis];
 
@@ -131,10 +328,34 @@ BrickMap::RayCast(const math::Ray &ray) {
 
             const math::BoundingBox brickBounds((vec3(data.position) + vec3(0.5f)) * brickSize + m_BoundingBox.min,
                                                 brickSize);
+
+            const uint32 level = footprint > 0.0f
+                                     ? SelectLod(length(brickBounds.GetCenter() - ray.origin), footprint)
+                                     : 0;
+            if (level == BRICK_LOD_LEVELS - 1) {
+                // The whole brick covers about a pixel, treat it as a single voxel.
+                ivec3 normal(0);
+                normal[data.stepAxis] = -data.gridStep[data.stepAxis];
+                return {{data.position * BRICK_DIMENSIONS, normal}};
+            }
+
+            // Skip the fine traversal if the ray misses the voxels in the brick, loose bounds are still conservative.
+            const BrickInfo &info = m_Infos[brickIndex];
+            const vec3 brickMin = vec3(data.position) * brickSize + m_BoundingBox.min;
+            const math::BoundingBox voxelBounds(brickMin + vec3(info.min) * m_VoxelSize,
+                                                brickMin + vec3(info.max + 1) * m_VoxelSize);
+            if (!ray.Intersect(voxelBounds)) {
+                counters.coarseSteps++;
+                data.Step();
+                continue;
+            }
+
             //return {};
-            const auto hit = TraverseFine(data.position, ray, brickBounds);
+            const auto hit = TraverseFine(data.position, ray, brickBounds, level, minDistance, maxDistance,
+                                           counters.fineSteps);
             if (hit) return hit;
         }
+        counters.coarseSteps++;
         data.Step();
     }
 
@@ -143,16 +364,16 @@ BrickMap::RayCast(const math::Ray &ray) {
 
 std::tuple<uint32 &, BrickMap::Brick &, BrickMap::BrickTexture &>
 BrickMap::GetHierarchy(const ivec3 &position) {
-    uint32 &cell = m_Grid[Flatten(position / 8, m_Dimensions)];
+    uint32 &cell = m_Grid[GetCellIndex(position / 8)];
     Brick &brick = m_Bricks[cell];
-    BrickTexture &texture = m_Textures[brick.colorPointer];
+    BrickTexture &texture = m_Textures[m_ColorPointers[cell]];
     return {cell, brick, texture};
 }
 
 
 std::optional<math::Color>
 BrickMap::GetVoxel(const ivec3 &position) const {
-    const uint32 brickIndex = m_Grid[Flatten(position / 8, m_Dimensions)];
+    const uint32 brickIndex = m_Grid[GetCellIndex(position / 8)];
     if (brickIndex == EMPTY_BRICK)
         return {};
 
@@ -160,31 +381,40 @@ BrickMap::GetVoxel(const ivec3 &position) const {
     if (!m_Bricks[brickIndex].VoxelAt(voxelIndex))
         return {};
 
-    return m_Textures[brickIndex].voxels[voxelIndex];
+    return m_Textures[m_ColorPointers[brickIndex]].voxels[voxelIndex];
 }
 
 std::optional<VoxelHitResult>
-BrickMap::TraverseFine(const ivec3 &brickPosition, const math::Ray &ray, const math::BoundingBox &brickBounds) {
+BrickMap::TraverseFine(const ivec3 &brickPosition, const math::Ray &ray, const math::BoundingBox &brickBounds,
+                       const uint32 level, const float minDistance, const float maxDistance, uint32 &steps) {
     //DataDDA data(m_VoxelSize, ray, ivec3(8));
     float tNear, tFar;
     if (!ray.Intersect(brickBounds, tNear, tFar)) {
         //std::cout << "Miss box\n";
         return {};
     }
-    tNear = std::max(tNear + 1e-3f, 0.0f);
-    DataDDA data(m_VoxelSize, {ray.origin + ray.direction * tNear - brickBounds.min, ray.direction}, ivec3(8));
+    tNear = std::max(tNear + 1e-3f, minDistance);
+    // Cells on a LOD level are 2^level voxels wide.
+    const int cellSize = 1 << level;
+    const ivec3 cellDimensions(BRICK_DIMENSIONS >> level);
+    const float cellWorldSize = m_VoxelSize * cellSize;
+    DataDDA data(cellWorldSize, {ray.origin + ray.direction * tNear - brickBounds.min, ray.direction}, cellDimensions);
 
     vec3 normal = brickBounds.GetNormal(data.rayStart);
 
-    const Brick &brick = m_Bricks[m_Grid[Flatten(brickPosition, m_Dimensions)]];
+    const uint32 brickIndex = m_Grid[GetCellIndex(brickPosition)];
+    const Brick &brick = m_Bricks[brickIndex];
+    const BrickLod &lod = m_Lods[brickIndex];
 
-    while (data.InBounds()) {
-        if (brick.VoxelAt(Flatten(data.position, ivec3(8)))) {
+    while (data.InBounds() && tNear + data.EntryT() * cellWorldSize <= maxDistance) {
+        const uint32 cellIndex = Flatten(data.position, cellDimensions);
+        if (level == 0 ? brick.VoxelAt(cellIndex) : lod.OccupiedAt(level, cellIndex)) {
             normal = vec3(0);
             normal[data.stepAxis] = -data.gridStep[data.stepAxis];
 
-            return {{brickPosition * 8 + data.position, normal}};
+            return {{brickPosition * 8 + data.position * cellSize, normal}};
         }
+        steps++;
         data.Step();
     }
     return {};
@@ -196,18 +426,22 @@ BrickMap::Insert(const ivec3 &position, const math::Color color, const bool repl
         position.x < 0 || position.y < 0 || position.z < 0)
         return {};
 
-    const size_t coarseIndex = Flatten(position / 8, m_Dimensions);
+    const size_t coarseIndex = GetCellIndex(position / 8);
 
     InsertResult insertResult(coarseIndex, false);
 
     if (m_Grid[coarseIndex] == EMPTY_BRICK) {
         m_Grid[coarseIndex] = m_Bricks.size();
-        Brick &brick = m_Bricks.emplace_back();
-        brick.parent = coarseIndex;
+        m_Bricks.emplace_back();
+        m_Parents.push_back(coarseIndex);
 
-        brick.colorPointer = m_Textures.size();
+        m_ColorPointers.push_back(m_Textures.size());
         BrickTexture &texture = m_Textures.emplace_back();
         texture.referenceCount++;
+        m_Lods.emplace_back();
+        m_Infos.emplace_back();
+        if (m_HasAttributes)
+            m_Attributes.emplace_back();
 
         insertResult.isNew = true;
     }
@@ -215,14 +449,22 @@ BrickMap::Insert(const ivec3 &position, const math::Color color, const bool repl
     const size_t fineIndex = Flatten(position % 8, ivec3(8));
 
     Brick &brick = m_Bricks[m_Grid[coarseIndex]];
-    BrickTexture &texture = m_Textures[brick.colorPointer];
-
-    if (replace || !brick.VoxelAt(fineIndex)) {
-        brick.Set(fineIndex, true);
-        texture.voxels[fineIndex] = color;
-        return insertResult;
+    BrickTexture &texture = m_Textures[m_ColorPointers[m_Grid[coarseIndex]]];
+    BrickInfo &info = m_Infos[m_Grid[coarseIndex]];
+
+    if (!brick.VoxelAt(fineIndex)) {
+        info.Add(position % 8, color);
+        m_VoxelCount++;
+    } else if (replace) {
+        info.Recolor(texture.voxels[fineIndex], color);
+    } else {
+        return {};
     }
-    return {};
+
+    brick.Set(fineIndex, true);
+    texture.voxels[fineIndex] = color;
+    UpdateLod(m_Grid[coarseIndex], position % 8);
+    return insertResult;
 }
 
 std::optional<BrickMap::InsertResult>
@@ -231,22 +473,26 @@ BrickMap::Insert(const ivec3 &position, const uint32 textureIndex) {
         position.x < 0 || position.y < 0 || position.z < 0)
         return {};
 
-    const size_t coarseIndex = Flatten(position / 8, m_Dimensions);
+    const size_t coarseIndex = GetCellIndex(position / 8);
 
     InsertResult insertResult(coarseIndex, false);
 
     if (m_Grid[coarseIndex] == EMPTY_BRICK) {
-        m_Grid[coarseIndex] = m_Bricks.size();
-        Brick &brick = m_Bricks.emplace_back();
-        brick.parent = coarseIndex;
-
         if (textureIndex >= m_Textures.size()) {
             std::cerr << "Texture index " << textureIndex << " is invalid.\n";
             return {};
         }
 
-        brick.colorPointer = textureIndex;
+        m_Grid[coarseIndex] = m_Bricks.size();
+        m_Bricks.emplace_back();
+        m_Parents.push_back(coarseIndex);
+
+        m_ColorPointers.push_back(textureIndex);
         m_Textures[textureIndex].referenceCount++;
+        m_Lods.emplace_back();
+        m_Infos.emplace_back();
+        if (m_HasAttributes)
+            m_Attributes.emplace_back();
 
         insertResult.isNew = true;
     }
@@ -255,7 +501,14 @@ BrickMap::Insert(const ivec3 &position, const uint32 textureIndex) {
 
     Brick &brick = m_Bricks[m_Grid[coarseIndex]];
 
+    if (!brick.VoxelAt(fineIndex)) {
+        m_Infos[m_Grid[coarseIndex]].Add(position % 8,
+                                         m_Textures[m_ColorPointers[m_Grid[coarseIndex]]].voxels[fineIndex]);
+        m_VoxelCount++;
+    }
+
     brick.Set(fineIndex, true);
+    UpdateLod(m_Grid[coarseIndex], position % 8);
     return insertResult;
 }
 
@@ -265,7 +518,7 @@ BrickMap::Delete(const ivec3 &position) {
         position.x < 0 || position.y < 0 || position.z < 0)
         return {};
 
-    const size_t coarseIndex = Flatten(position / 8, m_Dimensions);
+    const size_t coarseIndex = GetCellIndex(position / 8);
 
 
     if (m_Grid[coarseIndex] == EMPTY_BRICK) {
@@ -275,19 +528,322 @@ BrickMap::Delete(const ivec3 &position) {
     const size_t fineIndex = Flatten(position % 8, ivec3(8));
 
     Brick &brick = m_Bricks[m_Grid[coarseIndex]];
-    //BrickTexture &texture = m_Textures[brick.colorPointer];
+    BrickInfo &info = m_Infos[m_Grid[coarseIndex]];
+
+    if (!brick.VoxelAt(fineIndex)) {
+        return {};
+    }
+
+    info.Remove(position % 8, m_Textures[m_ColorPointers[m_Grid[coarseIndex]]].voxels[fineIndex]);
+    m_VoxelCount--;
 
     brick.Set(fineIndex, false);
+    UpdateLod(m_Grid[coarseIndex], position % 8);
 
-    bool isEmpty = true;
-    for (int i = 0; i < BRICK_SIZE / 32; ++i) {
-        if (brick.bitmask[i] != 0) {
-            isEmpty = false;
-            break;
+    return DeleteResult(coarseIndex, info.voxelCount == 0);
+}
+
+std::optional<BrickMap::RemoveResult>
+BrickMap::RemoveBrick(const uint32 cellIndex) {
+    const uint32 brickIndex = m_Grid[cellIndex];
+    if (brickIndex == EMPTY_BRICK)
+        return {};
+
+    RemoveResult result(brickIndex, EMPTY_BRICK);
+    m_Grid[cellIndex] = EMPTY_BRICK;
+    m_VoxelCount -= static_cast<int>(m_Infos[brickIndex].voxelCount);
+    const uint32 textureIndex = m_ColorPointers[brickIndex];
+
+    if (brickIndex != m_Bricks.size() - 1) {
+        result.movedCellIndex = m_Parents.back();
+        m_Grid[result.movedCellIndex] = brickIndex;
+
+        m_Bricks[brickIndex] = m_Bricks.back();
+        m_ColorPointers[brickIndex] = m_ColorPointers.back();
+        m_Parents[brickIndex] = m_Parents.back();
+        m_Lods[brickIndex] = m_Lods.back();
+        m_Infos[brickIndex] = m_Infos.back();
+        if (m_HasAttributes)
+            m_Attributes[brickIndex] = m_Attributes.back();
+    }
+
+    m_Bricks.pop_back();
+    m_ColorPointers.pop_back();
+    m_Parents.pop_back();
+    m_Lods.pop_back();
+    m_Infos.pop_back();
+    if (m_HasAttributes)
+        m_Attributes.pop_back();
+
+    // Shared textures stay until their last brick is gone.
+    BrickTexture &texture = m_Textures[textureIndex];
+    if (texture.referenceCount > 0 && --texture.referenceCount > 0)
+        return result;
+
+    result.textureIndex = textureIndex;
+    const uint32 lastTexture = m_Textures.size() - 1;
+    if (textureIndex != lastTexture) {
+        texture = m_Textures.back();
+        // Bricks with their own texture usually store it at the same index as the brick, so the brick that was moved
+        // into brickIndex is checked first and the search goes from the back.
+        uint32 remaining = texture.referenceCount;
+        if (brickIndex < m_ColorPointers.size() && m_ColorPointers[brickIndex] == lastTexture) {
+            m_ColorPointers[brickIndex] = textureIndex;
+            result.remappedBricks.push_back(brickIndex);
+            remaining--;
         }
+        for (uint32 i = m_ColorPointers.size(); i-- > 0 && remaining > 0;) {
+            if (m_ColorPointers[i] == lastTexture) {
+                m_ColorPointers[i] = textureIndex;
+                result.remappedBricks.push_back(i);
+                remaining--;
+            }
+        }
+    }
+    m_Textures.pop_back();
+
+    return result;
+}
+
+uint32
+BrickMap::AllocateBricks(const uint32 count) {
+    const uint32 first = m_Bricks.size();
+    m_Bricks.resize(first + count);
+    m_ColorPointers.resize(first + count);
+    m_Parents.resize(first + count);
+    m_Textures.resize(first + count);
+    m_Lods.resize(first + count);
+    m_Infos.resize(first + count);
+    if (m_HasAttributes)
+        m_Attributes.resize(first + count);
+    return first;
+}
+
+void
+BrickMap::PlaceBrick(const uint32 brickIndex, const ivec3 &brickPosition) {
+    const uint32 cellIndex = GetCellIndex(brickPosition);
+    m_Grid[cellIndex] = brickIndex;
+
+    m_Parents[brickIndex] = cellIndex;
+    m_ColorPointers[brickIndex] = brickIndex;
+    m_Textures[brickIndex].referenceCount = 1;
+}
+
+void
+BrickMap::FinalizeBrick(const uint32 brickIndex) {
+    m_Infos[brickIndex] = ComputeBrickInfo(brickIndex);
+    BuildLod(brickIndex);
+}
+
+void
+BrickMap::RecountVoxels() {
+    m_VoxelCount = 0;
+    for (const BrickInfo &info: m_Infos) {
+        m_VoxelCount += info.voxelCount;
+    }
+}
+
+ivec3
+BrickMap::GetCellPosition(const uint32 cellIndex) const {
+    if (m_Layout == GridLayout::Linear) {
+        return {
+            cellIndex % m_Dimensions.x,
+            cellIndex / m_Dimensions.x % m_Dimensions.y,
+            cellIndex / (m_Dimensions.x * m_Dimensions.y)
+        };
+    }
+
+    constexpr uint32 tileCells = GRID_TILE_SIZE * GRID_TILE_SIZE * GRID_TILE_SIZE;
+    const uint32 tile = cellIndex / tileCells;
+    const uint32 code = cellIndex % tileCells;
+    const ivec3 tilePosition(tile % m_TileCounts.x, tile / m_TileCounts.x % m_TileCounts.y,
+                             tile / (m_TileCounts.x * m_TileCounts.y));
+    // Every third bit of the Z-order code belongs to the same axis.
+    const ivec3 local((code & 1) | (code >> 2 & 2), (code >> 1 & 1) | (code >> 3 & 2), (code >> 2 & 1) | (code >> 4 & 2));
+    return tilePosition * GRID_TILE_SIZE + local;
+}
+
+void
+BrickMap::SetGridLayout(const GridLayout layout) {
+    if (layout == m_Layout)
+        return;
+
+    std::vector<ivec3> positions(m_Bricks.size());
+    for (uint32 brickIndex = 0; brickIndex < m_Bricks.size(); ++brickIndex)
+        positions[brickIndex] = GetCellPosition(m_Parents[brickIndex]);
+
+    m_Layout = layout;
+    size_t cellCount = m_Dimensions.x * m_Dimensions.y * m_Dimensions.z;
+    if (layout == GridLayout::Tiled) {
+        m_TileCounts = (m_Dimensions + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+        cellCount = m_TileCounts.x * m_TileCounts.y * m_TileCounts.z * GRID_TILE_SIZE * GRID_TILE_SIZE * GRID_TILE_SIZE;
     }
+    m_Grid.assign(cellCount, EMPTY_BRICK);
 
-    return DeleteResult(coarseIndex, isEmpty);
+    for (uint32 brickIndex = 0; brickIndex < m_Bricks.size(); ++brickIndex) {
+        const uint32 cellIndex = GetCellIndex(positions[brickIndex]);
+        m_Grid[cellIndex] = brickIndex;
+        m_Parents[brickIndex] = cellIndex;
+    }
+}
+
+void
+BrickMap::SortBricks() {
+    PROFILE_SCOPE("BrickMap::SortBricks");
+    std::vector<uint32> order;
+    order.reserve(m_Bricks.size());
+    for (const uint32 brickIndex: m_Grid) {
+        if (brickIndex != EMPTY_BRICK)
+            order.push_back(brickIndex);
+    }
+
+    // Textures follow the first brick that uses them, shared textures stay shared and unused ones are dropped.
+    std::vector<uint32> textureIndices(m_Textures.size(), EMPTY_BRICK);
+    std::vector<uint32> textureOrder;
+    std::vector<uint32> colorPointers(order.size());
+    for (uint32 i = 0; i < order.size(); ++i) {
+        uint32 &textureIndex = textureIndices[m_ColorPointers[order[i]]];
+        if (textureIndex == EMPTY_BRICK) {
+            textureIndex = textureOrder.size();
+            textureOrder.push_back(m_ColorPointers[order[i]]);
+        }
+        colorPointers[i] = textureIndex;
+    }
+
+    std::vector<BrickTexture> textures(textureOrder.size());
+    parallel::For(textureOrder.size(), [&](const uint32 i, uint32) {
+        textures[i] = m_Textures[textureOrder[i]];
+        textures[i].referenceCount = 0;
+    });
+    for (const uint32 colorPointer: colorPointers)
+        textures[colorPointer].referenceCount++;
+
+    std::vector<Brick> bricks(order.size());
+    std::vector<uint32> parents(order.size());
+    std::vector<BrickLod> lods(order.size());
+    std::vector<BrickInfo> infos(order.size());
+    std::vector<BrickAttributes> attributes(m_HasAttributes ? order.size() : 0);
+    parallel::For(order.size(), [&](const uint32 i, uint32) {
+        bricks[i] = m_Bricks[order[i]];
+        parents[i] = m_Parents[order[i]];
+        lods[i] = m_Lods[order[i]];
+        infos[i] = m_Infos[order[i]];
+        if (m_HasAttributes)
+            attributes[i] = m_Attributes[order[i]];
+        m_Grid[parents[i]] = i;
+    });
+
+    m_Bricks = std::move(bricks);
+    m_ColorPointers = std::move(colorPointers);
+    m_Parents = std::move(parents);
+    m_Textures = std::move(textures);
+    m_Lods = std::move(lods);
+    m_Infos = std::move(infos);
+    m_Attributes = std::move(attributes);
+}
+
+void
+BrickMap::EnableAttributes() {
+    if (m_HasAttributes)
+        return;
+
+    m_HasAttributes = true;
+    m_Attributes.resize(m_Bricks.size());
+    EstimateNormals(ivec3(0), m_Dimensions * BRICK_DIMENSIONS - 1);
+}
+
+void
+BrickMap::SetAttributes(const ivec3 &position, const uint16 normal, const uint8 material) {
+    assert(m_HasAttributes);
+    const uint32 brickIndex = m_Grid[GetCellIndex(position / BRICK_DIMENSIONS)];
+    if (brickIndex == EMPTY_BRICK)
+        return;
+
+    const uint32 voxelIndex = Flatten(position % BRICK_DIMENSIONS, ivec3(BRICK_DIMENSIONS));
+    m_Attributes[brickIndex].normals[voxelIndex] = normal;
+    m_Attributes[brickIndex].materials[voxelIndex] = material;
+}
+
+bool
+BrickMap::IsSolid(const ivec3 &position) const {
+    if (any(lessThan(position, ivec3(0))) || any(greaterThanEqual(position, m_Dimensions * BRICK_DIMENSIONS)))
+        return false;
+
+    const uint32 brickIndex = m_Grid[GetCellIndex(position / BRICK_DIMENSIONS)];
+    return brickIndex != EMPTY_BRICK &&
+           m_Bricks[brickIndex].VoxelAt(Flatten(position % BRICK_DIMENSIONS, ivec3(BRICK_DIMENSIONS)));
+}
+
+vec3
+BrickMap::EstimateNormal(const ivec3 &position) const {
+    // Sum of the directions to the empty neighbours, diagonal ones weigh less.
+    vec3 normal(0.0f);
+    for (int z = -1; z <= 1; ++z) {
+        for (int y = -1; y <= 1; ++y) {
+            for (int x = -1; x <= 1; ++x) {
+                const ivec3 offset(x, y, z);
+                if (offset != ivec3(0) && !IsSolid(position + offset))
+                    normal += vec3(offset) / std::sqrt(static_cast<float>(x * x + y * y + z * z));
+            }
+        }
+    }
+
+    // Voxels that are enclosed or symmetric have no gradient, they are rarely visible.
+    if (dot(normal, normal) < 1e-6f)
+        return {0.0f, 1.0f, 0.0f};
+    return normalize(normal);
+}
+
+std::vector<uint32>
+BrickMap::GetBricksInRegion(const ivec3 &min, const ivec3 &max) const {
+    std::vector<uint32> bricks;
+    const ivec3 voxelMin = glm::max(min, ivec3(0));
+    const ivec3 voxelMax = glm::min(max, m_Dimensions * BRICK_DIMENSIONS - 1);
+    if (any(lessThan(voxelMax, voxelMin)))
+        return bricks;
+
+    const ivec3 brickMin = voxelMin / BRICK_DIMENSIONS, brickMax = voxelMax / BRICK_DIMENSIONS;
+    for (int z = brickMin.z; z <= brickMax.z; ++z) {
+        for (int y = brickMin.y; y <= brickMax.y; ++y) {
+            for (int x = brickMin.x; x <= brickMax.x; ++x) {
+                const uint32 brickIndex = m_Grid[GetCellIndex({x, y, z})];
+                if (brickIndex != EMPTY_BRICK)
+                    bricks.push_back(brickIndex);
+            }
+        }
+    }
+    return bricks;
+}
+
+std::vector<uint32>
+BrickMap::EstimateNormals(const ivec3 &min, const ivec3 &max) {
+    PROFILE_SCOPE("BrickMap::EstimateNormals");
+    if (!m_HasAttributes)
+        return {};
+
+    const ivec3 voxelMin = glm::max(min, ivec3(0));
+    const ivec3 voxelMax = glm::min(max, m_Dimensions * BRICK_DIMENSIONS - 1);
+    const std::vector<uint32> bricks = GetBricksInRegion(voxelMin, voxelMax);
+
+    parallel::For(bricks.size(), [&](const uint32 i, uint32) {
+        const uint32 brickIndex = bricks[i];
+        const ivec3 origin = GetCellPosition(m_Parents[brickIndex]) * BRICK_DIMENSIONS;
+        const ivec3 localMin = glm::max(voxelMin - origin, ivec3(0));
+        const ivec3 localMax = glm::min(voxelMax - origin, ivec3(BRICK_DIMENSIONS - 1));
+
+        for (int z = localMin.z; z <= localMax.z; ++z) {
+            for (int y = localMin.y; y <= localMax.y; ++y) {
+                for (int x = localMin.x; x <= localMax.x; ++x) {
+                    const uint32 voxelIndex = Flatten({x, y, z}, ivec3(BRICK_DIMENSIONS));
+                    if (m_Bricks[brickIndex].VoxelAt(voxelIndex)) {
+                        m_Attributes[brickIndex].normals[voxelIndex] =
+                                math::EncodeNormal(EstimateNormal(origin + ivec3(x, y, z)));
+                    }
+                }
+            }
+        }
+    });
+    return bricks;
 }
 
 void
@@ -318,28 +874,140 @@ BrickMap::GenerateSphere() {
     std::cout << "Added " << m_VoxelCount << " voxels in " << m_Grid.size() << " bricks\n";
 }
 
+constexpr float fillScale = 48.0f;
+constexpr float fillThreshold = 0.3f;
+
+// Largest difference between the noise at the center of a cube of voxels and at any voxel inside it. Voxels are at
+// most (size - 1) / 2 from the center along each axis, the margin covers the float evaluation.
+static float
+FillBound(const int size) {
+    return 3.0f * static_cast<float>(size - 1) / 2.0f / fillScale * math::PerlinNoiseBatch::maxDerivative + 1e-4f;
+}
+
+// Samples the noise at the centers of the 8 children of a cube, childSize is the side of a child. Children of size 1
+// are single voxels.
+static void
+SampleChildren(const math::PerlinNoiseBatch &noise, const ivec3 &min, const int childSize, float *values) {
+    const float offset = static_cast<float>(childSize - 1) / 2.0f;
+    float x[8], y[8], z[8];
+    for (uint32 i = 0; i < 8; ++i) {
+        const ivec3 child = min + ChildOffset(i) * childSize;
+        x[i] = (static_cast<float>(child.x) + offset) / fillScale;
+        y[i] = (static_cast<float>(child.y) + offset) / fillScale;
+        z[i] = (static_cast<float>(child.z) + offset) / fillScale;
+    }
+    noise.Noise3D(x, y, z, values);
+}
+
+// Fills the voxels above the threshold in a cube of a brick, children that can not reach the threshold are skipped.
+static void
+FillCube(const math::PerlinNoiseBatch &noise, const ivec3 &origin, const ivec3 &min, const int size,
+         BrickMap::Brick &brick, BrickMap::BrickTexture &texture) {
+    const int childSize = size / 2;
+    // Single voxels are compared against the threshold exactly.
+    const float bound = childSize > 1 ? FillBound(childSize) : 0.0f;
+    float values[8];
+    SampleChildren(noise, origin + min, childSize, values);
+
+    for (uint32 i = 0; i < 8; ++i) {
+        if (values[i] + bound <= fillThreshold)
+            continue;
+
+        const ivec3 childMin = min + ChildOffset(i) * childSize;
+        if (childSize > 1) {
+            FillCube(noise, origin, childMin, childSize, brick, texture);
+            continue;
+        }
+
+        const uint32 voxelIndex = childMin.x + BRICK_DIMENSIONS * (childMin.y + BRICK_DIMENSIONS * childMin.z);
+        const uint8 u = static_cast<uint8>(values[i] * 255.0f);
+        brick.Set(voxelIndex, true);
+        texture.voxels[voxelIndex] = {u, u, u, 255};
+    }
+}
+
 void
 BrickMap::Fill() {
-    const ivec3 totalDimensions = m_Dimensions * 8;
-    const vec3 invDimensions = vec3(1.0f) / vec3(totalDimensions);
+    PROFILE_SCOPE("BrickMap::Fill");
+    const math::PerlinNoiseBatch noise;
+    const ivec3 totalDimensions = m_Dimensions * BRICK_DIMENSIONS;
+    // Cells are enumerated row-major here, PlaceBrick maps them to the grid layout.
+    const uint32 cellCount = m_Dimensions.x * m_Dimensions.y * m_Dimensions.z;
+    const auto cellPosition = [this](const uint32 cellIndex) {
+        return ivec3(cellIndex % m_Dimensions.x,
+                     cellIndex / m_Dimensions.x % m_Dimensions.y,
+                     cellIndex / (m_Dimensions.x * m_Dimensions.y));
+    };
+
+    // Cells where the first level of the hierarchy can not rule out voxels.
+    std::vector<uint8> candidates(cellCount);
+    parallel::For(cellCount, [&](const uint32 cellIndex, uint32) {
+        constexpr int blockSize = BRICK_DIMENSIONS / 2;
+        float values[8];
+        SampleChildren(noise, cellPosition(cellIndex) * BRICK_DIMENSIONS, blockSize, values);
+        candidates[cellIndex] = *std::max_element(values, values + 8) + FillBound(blockSize) > fillThreshold;
+    });
+
+    std::vector<uint32> cells;
+    for (uint32 cellIndex = 0; cellIndex < cellCount; ++cellIndex) {
+        if (candidates[cellIndex])
+            cells.push_back(cellIndex);
+    }
 
-    siv::PerlinNoise noise;
-    for (int z = 0; z < totalDimensions.z; ++z) {
-        for (int y = 0; y < totalDimensions.y; ++y) {
-            for (int x = 0; x < totalDimensions.z; ++x) {
-                //uint8 r = ((float) x * invDimensions.x * 255.0f);
-                //uint8 g = ((float) y * invDimensions.y * 255.0f);
-                //uint8 b = ((float) z * invDimensions.z * 255.0f);
-                constexpr float scale = 48.0f;
-                const float f = noise.noise3D(
-                    static_cast<float>(x) / scale,
-                    static_cast<float>(y) / scale,
-                    static_cast<float>(z) / scale
-                );
-                const uint8 u = static_cast<uint8>(f * 255.0f);
-                if (f > 0.3f)
-                    Insert({x, y, z}, {u, u, u, 255});
+    // Candidates are filled into temporary bricks, along with the scan order index of their first voxel with z
+    // outermost and x innermost.
+    std::vector<Brick> bricks(cells.size());
+    std::vector<BrickTexture> textures(cells.size());
+    std::vector<uint64> firstVoxels(cells.size(), UINT64_MAX);
+    parallel::For(cells.size(), [&](const uint32 i, uint32) {
+        const ivec3 origin = cellPosition(cells[i]) * BRICK_DIMENSIONS;
+        const Brick &brick = bricks[i];
+        FillCube(noise, origin, ivec3(0), BRICK_DIMENSIONS, bricks[i], textures[i]);
+
+        for (uint32 word = 0; word < BRICK_SIZE / 32; ++word) {
+            if (brick.bitmask[word] == 0)
+                continue;
+            const uint32 bit = word * 32 + std::countr_zero(brick.bitmask[word]);
+            const ivec3 voxel = origin + ivec3(bit % 8, bit / 8 % 8, bit / 64);
+            firstVoxels[i] = (static_cast<uint64>(voxel.z) * totalDimensions.y + voxel.y) * totalDimensions.x +
+                             voxel.x;
+            break;
+        }
+    });
+
+    // Keep the brick order that inserting voxel by voxel in scan order would give.
+    std::vector<uint32> order;
+    for (uint32 i = 0; i < cells.size(); ++i) {
+        if (firstVoxels[i] != UINT64_MAX)
+            order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](const uint32 a, const uint32 b) {
+        return firstVoxels[a] < firstVoxels[b];
+    });
+
+    // Bricks that are already there are merged voxel by voxel.
+    if (!m_Bricks.empty()) {
+        for (const uint32 i: order) {
+            const ivec3 origin = cellPosition(cells[i]) * BRICK_DIMENSIONS;
+            for (uint32 bit = 0; bit < BRICK_SIZE; ++bit) {
+                if (bricks[i].VoxelAt(bit))
+                    Insert(origin + ivec3(bit % 8, bit / 8 % 8, bit / 64), textures[i].voxels[bit]);
             }
         }
+        return;
     }
+
+    // An empty map gets the bricks written directly instead of through Insert.
+    const uint32 firstBrick = AllocateBricks(order.size());
+    parallel::For(order.size(), [&](const uint32 i, uint32) {
+        const uint32 brickIndex = firstBrick + i;
+        PlaceBrick(brickIndex, cellPosition(cells[order[i]]));
+
+        Brick &brick = m_Bricks[brickIndex];
+        BrickTexture &texture = m_Textures[brickIndex];
+        std::copy(std::begin(bricks[order[i]].bitmask), std::end(bricks[order[i]].bitmask), brick.bitmask);
+        std::copy(std::begin(textures[order[i]].voxels), std::end(textures[order[i]].voxels), texture.voxels);
+        FinalizeBrick(brickIndex);
+    });
+    RecountVoxels();
 }
@@ -2,13 +2,18 @@
 
 #include "Math/BoundingBox.hpp"
 #include "Math/Color.hpp"
+#include <cfloat>
 #include <cstddef>
 
 #include "Math/Ray.hpp"
+#include "TraversalStatistics.hpp"
 
 #define EMPTY_BRICK 0xFFFFFFFF
 #define BRICK_DIMENSIONS 8
 #define BRICK_SIZE 512
+#define BRICK_LOD_LEVELS 4
+// Cells per side of a tile in the tiled grid layout, GetCellIndex assumes 4.
+#define GRID_TILE_SIZE 4
 
 struct Model;
 
@@ -19,10 +24,18 @@ struct VoxelHitResult {
 
 class BrickMap {
 public:
-  struct Brick {
+  // Order of the cells in the coarse grid. Linear is row-major, a DDA step along y or z jumps a whole row or slice.
+  // Tiled stores blocks of 4^3 cells in Z-order, 256 bytes each, with the blocks row-major. Steps along any axis then
+  // mostly stay within a few cache lines. The tiled grid is padded to whole tiles.
+  enum class GridLayout : uint32 {
+    Linear,
+    Tiled
+  };
+
+  // Occupancy of a brick, bit i is set if voxel i is solid. Traversal only reads these, so they are kept apart from
+  // the color pointers and parents and each mask fills exactly one cache line.
+  struct alignas(64) Brick {
     uint32 bitmask[BRICK_SIZE / 32] = {};
-    uint32 colorPointer = 0;
-    uint32 parent = 0;
 
     void Set(const uint32 bit, const bool value) {
       assert(bit < BRICK_SIZE);
@@ -47,6 +60,81 @@ public:
     uint32 referenceCount = 0;
   };
 
+  // Bookkeeping for a brick that is kept up to date by every edit.
+  struct BrickInfo {
+    uint32 voxelCount = 0;
+    // Sum of every channel over all voxels in the brick.
+    uint32 colorSum[3] = {};
+    // Inclusive bounds of the voxels in local coordinates. After a delete on the boundary they may be larger than
+    // the voxels until resolved, but never smaller.
+    ivec3 min = ivec3(BRICK_DIMENSIONS);
+    ivec3 max = ivec3(-1);
+    bool boundsDirty = false;
+
+    void Add(const ivec3 &position, const math::Color color) {
+      voxelCount++;
+      colorSum[0] += color.r, colorSum[1] += color.g, colorSum[2] += color.b;
+      min = glm::min(min, position);
+      max = glm::max(max, position);
+    }
+
+    void Recolor(const math::Color oldColor, const math::Color newColor) {
+      colorSum[0] += newColor.r - oldColor.r;
+      colorSum[1] += newColor.g - oldColor.g;
+      colorSum[2] += newColor.b - oldColor.b;
+    }
+
+    void Remove(const ivec3 &position, const math::Color color) {
+      voxelCount--;
+      colorSum[0] -= color.r, colorSum[1] -= color.g, colorSum[2] -= color.b;
+      boundsDirty = boundsDirty || any(equal(position, min)) || any(equal(position, max));
+    }
+
+    math::Color GetAverageColor() const {
+      if (voxelCount == 0)
+        return {};
+      return {
+        static_cast<uint8>(colorSum[0] / voxelCount),
+        static_cast<uint8>(colorSum[1] / voxelCount),
+        static_cast<uint8>(colorSum[2] / voxelCount),
+        255
+      };
+    }
+  };
+
+  // Downsampled copies of a brick's occupancy and colors.
+  // Level 0 is the brick itself, level 1 has 4^3 cells, level 2 has 2^3 cells and level 3 is the whole brick.
+  struct BrickLod {
+    // Bit i is set if cell i on level 1 contains at least one voxel.
+    uint32 occupancy4[2] = {};
+    // Bit i is set if cell i on level 2 contains at least one voxel.
+    uint32 occupancy2 = 0;
+    // Average color of all voxels in the brick.
+    math::Color color = {};
+    math::Color colors4[64] = {};
+    math::Color colors2[8] = {};
+
+    bool OccupiedAt(const uint32 level, const uint32 cell) const {
+      switch (level) {
+        case 1: return occupancy4[cell / 32] >> (cell % 32) & 1;
+        case 2: return occupancy2 >> cell & 1;
+        default: return color.data != 0;
+      }
+    }
+  };
+
+  // Shading attributes of every voxel in a brick, stored at the brick's index when enabled.
+  struct BrickAttributes {
+    // Packed with math::EncodeNormal. Shading flips them towards the face that was hit, so the sign does not matter.
+    uint16 normals[BRICK_SIZE] = {};
+    // Index into the materials of the voxelized model, 0 for voxels that did not come from a mesh.
+    uint8 materials[BRICK_SIZE] = {};
+    // Baked ambient occlusion, 0 is fully open and 255 fully occluded. Voxels that have not been baked are open.
+    uint8 occlusion[BRICK_SIZE] = {};
+    // Voxels reached by the sun, written by SunShadowBaker.
+    uint32 sunMask[BRICK_SIZE / 32] = {};
+  };
+
   struct InsertResult {
     uint32 cellIndex = 0;
     bool isNew = false;
@@ -57,6 +145,18 @@ public:
     bool isEmpty = false;
   };
 
+  struct RemoveResult {
+    // Index the removed brick occupied, now holds the brick that was previously last.
+    uint32 brickIndex = 0;
+    // Grid cell of the brick that was moved into brickIndex, EMPTY_BRICK if no brick was moved.
+    uint32 movedCellIndex = EMPTY_BRICK;
+    // Texture slot that was freed, now holds the texture that was previously last unless the freed texture was last.
+    // EMPTY_BRICK if other bricks still share the texture of the removed brick.
+    uint32 textureIndex = EMPTY_BRICK;
+    // Bricks whose color pointer changed because their texture moved into textureIndex.
+    std::vector<uint32> remappedBricks;
+  };
+
   BrickMap() = default;
 
   BrickMap(vec3 position, ivec3 dimensions, float voxelSize);
@@ -67,6 +167,8 @@ public:
 
   void GenerateSphere();
 
+  // Inserts a noise volume, replacing the colors of voxels that are already solid. Bricks of an empty map are built
+  // directly, a map with bricks is edited through Insert.
   void Fill();
 
   std::optional<InsertResult> Insert(const ivec3 &position, math::Color color, bool replace = true);
@@ -75,6 +177,48 @@ public:
 
   std::optional<DeleteResult> Delete(const ivec3 &position);
 
+  // Removes the brick in a grid cell by swapping it with the last brick. Its texture is released, and freed by swapping
+  // it with the last texture once no brick references it any more.
+  std::optional<RemoveResult> RemoveBrick(uint32 cellIndex);
+
+  // Bulk construction for generators that write bricks directly, possibly from several threads.
+  // Appends count empty bricks with their own textures and returns the index of the first one.
+  uint32 AllocateBricks(uint32 count);
+
+  // Links an allocated brick to a grid cell.
+  void PlaceBrick(uint32 brickIndex, const ivec3 &brickPosition);
+
+  // Rebuilds the info and LOD of a brick after its bitmask and texture have been written.
+  // Safe to call concurrently for different bricks, RecountVoxels must be called once all are finalized.
+  void FinalizeBrick(uint32 brickIndex);
+
+  void RecountVoxels();
+
+  // Index of the grid cell of a brick position in the current layout.
+  uint32 GetCellIndex(const ivec3 &brickPosition) const {
+    if (m_Layout == GridLayout::Linear)
+      return Flatten(brickPosition, m_Dimensions);
+
+    // Positions are never negative, so tiles and local positions are shifts and masks.
+    const uint32 x = brickPosition.x, y = brickPosition.y, z = brickPosition.z;
+    const uint32 tile = (x >> 2) + m_TileCounts.x * ((y >> 2) + m_TileCounts.y * (z >> 2));
+    // Interleaves the two bits of every axis within the tile, x lowest.
+    const uint32 code = (x & 1) | (y & 1) << 1 | (z & 1) << 2 | (x & 2) << 2 | (y & 2) << 3 | (z & 2) << 4;
+    return tile << 6 | code;
+  }
+
+  ivec3 GetCellPosition(uint32 cellIndex) const;
+
+  // Rebuilds the grid in another layout. Cell indices and brick parents change, brick indices do not.
+  void SetGridLayout(GridLayout layout);
+
+  GridLayout GetGridLayout() const { return m_Layout; }
+
+  // Reorders the bricks to follow the grid, so bricks that are close in space are close in memory and a ray reads
+  // neighbouring bricks from neighbouring cache lines. Textures are reordered the same way, shared ones stay shared and
+  // textures no brick uses are dropped. Brick and texture indices change, the whole map has to be uploaded again.
+  void SortBricks();
+
   const std::vector<uint32> &GetGrid() const { return m_Grid; }
 
   std::vector<uint32> &GetGrid() { return m_Grid; }
@@ -83,31 +227,107 @@ public:
 
   std::vector<Brick> &GetBricks() { return m_Bricks; }
 
+  // Index into the textures for every brick.
+  const std::vector<uint32> &GetColorPointers() const { return m_ColorPointers; }
+
+  // Grid cell of every brick.
+  const std::vector<uint32> &GetParents() const { return m_Parents; }
+
   const std::vector<BrickTexture> &GetBrickTextures() const { return m_Textures; }
 
   std::vector<BrickTexture> &GetBrickTextures() { return m_Textures; }
 
+  const std::vector<BrickLod> &GetBrickLods() const { return m_Lods; }
+
+  // Allocates attributes for every brick and estimates the normals of the existing voxels. Edits keep a block per
+  // brick afterwards, but normals are only updated by EstimateNormals.
+  void EnableAttributes();
+
+  bool HasAttributes() const { return m_HasAttributes; }
+
+  const std::vector<BrickAttributes> &GetBrickAttributes() const { return m_Attributes; }
+
+  // Sets the attributes of a voxel in an existing brick.
+  void SetAttributes(const ivec3 &position, uint16 normal, uint8 material);
+
+  // Estimates the normals of the voxels in the inclusive region from the occupancy of their neighbours. Returns the
+  // bricks that were updated, voxels next to an edit should be included since their neighbourhood changed.
+  std::vector<uint32> EstimateNormals(const ivec3 &min, const ivec3 &max);
+
+  BrickAttributes &GetBrickAttributes(const uint32 brickIndex) { return m_Attributes[brickIndex]; }
+
+  // Indices of the bricks overlapping an inclusive voxel region, clamped to the map.
+  std::vector<uint32> GetBricksInRegion(const ivec3 &min, const ivec3 &max) const;
+
+  // Positions outside the map are empty.
+  bool IsSolid(const ivec3 &position) const;
+
+  // Resolves the bounds of the brick if a delete has left them loose.
+  const BrickInfo &GetBrickInfo(uint32 brickIndex);
+
+  // Computes the info of a brick from scratch, used to validate the incrementally maintained one.
+  BrickInfo ComputeBrickInfo(uint32 brickIndex) const;
+
+  int GetVoxelCount() const { return m_VoxelCount; }
+
+  // Rebuilds every LOD level of a brick from its voxels and info.
+  void BuildLod(uint32 brickIndex);
+
   const math::BoundingBox &GetBoundingBox() const { return m_BoundingBox; }
   float GetVoxelSize() const { return m_VoxelSize; }
   const ivec3 &GetDimensions() const { return m_Dimensions; }
 
   void PrintByteSize() const;
 
-  std::optional<VoxelHitResult> RayCast(const math::Ray &ray);
+  // footprint is the world size of a pixel at unit distance, bricks are traversed at the LOD level
+  // where a cell covers about one pixel. A footprint of 0 always traverses the full resolution.
+  // If a recorder is given the steps taken and bricks entered by the ray are added to it.
+  // Traversal starts minDistance along the ray, voxels in front of it are skipped. It stops at maxDistance, only
+  // voxels entered before it are hit.
+  std::optional<VoxelHitResult> RayCast(const math::Ray &ray, float footprint = 0.0f,
+                                        TraversalRecorder *recorder = nullptr, float minDistance = 0.0f,
+                                        float maxDistance = FLT_MAX);
+
+  uint32 SelectLod(float distance, float footprint) const;
 
   std::tuple<uint32 &, Brick &, BrickTexture &> GetHierarchy(const ivec3 &position);
 
   std::optional<math::Color> GetVoxel(const ivec3 &position) const;
 
 private:
+  struct RayCounters {
+    uint32 coarseSteps = 0;
+    uint32 fineSteps = 0;
+    uint32 bricksEntered = 0;
+  };
+
+  std::optional<VoxelHitResult> TraverseCoarse(const math::Ray &ray, float footprint, float minDistance,
+                                               float maxDistance, RayCounters &counters, TraversalRecorder *recorder);
+
   std::optional<VoxelHitResult> TraverseFine(const ivec3 &brickPosition, const math::Ray &ray,
-                                             const math::BoundingBox &brickBounds);
+                                             const math::BoundingBox &brickBounds, uint32 level, float minDistance,
+                                             float maxDistance, uint32 &steps);
+
+  // Points away from the solid neighbours of a voxel.
+  vec3 EstimateNormal(const ivec3 &position) const;
+
+  // Updates the LOD cells containing a voxel after it has been edited.
+  void UpdateLod(uint32 brickIndex, const ivec3 &localPosition);
 
   std::vector<uint32> m_Grid;
   std::vector<Brick> m_Bricks;
+  std::vector<uint32> m_ColorPointers;
+  std::vector<uint32> m_Parents;
   std::vector<BrickTexture> m_Textures;
+  std::vector<BrickLod> m_Lods;
+  std::vector<BrickInfo> m_Infos;
+  std::vector<BrickAttributes> m_Attributes;
+  bool m_HasAttributes = false;
   math::BoundingBox m_BoundingBox;
   ivec3 m_Dimensions = ivec3();
+  GridLayout m_Layout = GridLayout::Linear;
+  // Tiles per axis in the tiled layout.
+  ivec3 m_TileCounts = ivec3();
   float m_VoxelSize = 1.0f;
   int m_VoxelCount = 0;
 };
@@ -0,0 +1,124 @@
+#include "BrickMapFile.hpp"
+#include "Utility/MappedFile.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <filesystem>
+
+constexpr char fileMagic[4] = {'V', 'X', 'B', 'M'};
+constexpr uint32 fileVersion = 1;
+
+struct FileHeader {
+    char magic[4];
+    uint32 version;
+    vec3 position;
+    ivec3 dimensions;
+    float voxelSize;
+    uint32 brickCount;
+};
+
+// Every brick is stored as its grid position, bitmask and voxel colors.
+constexpr size_t bitmaskSize = sizeof(BrickMap::Brick::bitmask);
+constexpr size_t voxelsSize = sizeof(BrickMap::BrickTexture::voxels);
+constexpr size_t recordSize = sizeof(ivec3) + bitmaskSize + voxelsSize;
+
+BrickMapWriter::BrickMapWriter(const std::string &path, const vec3 &position, const ivec3 &dimensions,
+                               const float voxelSize)
+    : m_Path(path),
+      m_Dimensions(dimensions) {
+    m_File.open(path + ".tmp", std::ios::binary);
+    if (!m_File) {
+        std::cerr << "Failed to open brick map file \"" << path << "\"\n";
+        return;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.position = position;
+    header.dimensions = dimensions;
+    header.voxelSize = voxelSize;
+    m_File.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+BrickMapWriter::~BrickMapWriter() {
+    if (IsOpen())
+        Close();
+}
+
+void
+BrickMapWriter::Write(const ivec3 &brickPosition, const BrickMap::Brick &brick,
+                      const BrickMap::BrickTexture &texture) {
+    assert(all(greaterThanEqual(brickPosition, ivec3(0))) && all(lessThan(brickPosition, m_Dimensions)));
+
+    m_File.write(reinterpret_cast<const char *>(&brickPosition), sizeof(brickPosition));
+    m_File.write(reinterpret_cast<const char *>(brick.bitmask), bitmaskSize);
+    m_File.write(reinterpret_cast<const char *>(texture.voxels), voxelsSize);
+    m_BrickCount++;
+}
+
+void
+BrickMapWriter::Write(const BrickMap &brickMap, const ivec3 &offset) {
+    PROFILE_SCOPE("BrickMapWriter::Write");
+    for (uint32 brickIndex = 0; brickIndex < brickMap.GetBricks().size(); ++brickIndex) {
+        Write(offset + brickMap.GetCellPosition(brickMap.GetParents()[brickIndex]), brickMap.GetBricks()[brickIndex],
+              brickMap.GetBrickTextures()[brickMap.GetColorPointers()[brickIndex]]);
+    }
+}
+
+bool
+BrickMapWriter::Close() {
+    // The header is written last so a file with a brick count is always complete.
+    m_File.seekp(offsetof(FileHeader, brickCount));
+    m_File.write(reinterpret_cast<const char *>(&m_BrickCount), sizeof(m_BrickCount));
+    m_File.close();
+
+    std::error_code error;
+    if (!m_File) {
+        std::cerr << "Failed to write brick map file \"" << m_Path << "\"\n";
+        std::filesystem::remove(m_Path + ".tmp", error);
+        return false;
+    }
+
+    std::filesystem::rename(m_Path + ".tmp", m_Path, error);
+    return !error;
+}
+
+std::optional<BrickMap>
+LoadBrickMap(const std::string &path) {
+    PROFILE_SCOPE("LoadBrickMap");
+    const MappedFile file(path);
+    if (!file.IsOpen() || file.GetSize() < sizeof(FileHeader)) {
+        std::cerr << "Failed to open brick map file \"" << path << "\"\n";
+        return std::nullopt;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 || header.version != fileVersion ||
+        file.GetSize() < sizeof(FileHeader) + static_cast<size_t>(header.brickCount) * recordSize) {
+        std::cerr << "Invalid brick map file \"" << path << "\"\n";
+        return std::nullopt;
+    }
+
+    BrickMap brickMap(header.position, header.dimensions * BRICK_DIMENSIONS, header.voxelSize);
+    const uint32 firstBrick = brickMap.AllocateBricks(header.brickCount);
+    const uint8 *records = file.GetData() + sizeof(FileHeader);
+
+    parallel::For(header.brickCount, [&](const uint32 i, uint32) {
+        const uint8 *record = records + i * recordSize;
+        ivec3 brickPosition;
+        std::memcpy(&brickPosition, record, sizeof(brickPosition));
+
+        const uint32 brickIndex = firstBrick + i;
+        brickMap.PlaceBrick(brickIndex, brickPosition);
+        BrickMap::Brick &brick = brickMap.GetBricks()[brickIndex];
+        BrickMap::BrickTexture &texture = brickMap.GetBrickTextures()[brickIndex];
+        std::memcpy(brick.bitmask, record + sizeof(brickPosition), bitmaskSize);
+        std::memcpy(static_cast<void *>(texture.voxels), record + sizeof(brickPosition) + bitmaskSize, voxelsSize);
+        brickMap.FinalizeBrick(brickIndex);
+    });
+    brickMap.RecountVoxels();
+
+    return brickMap;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "BrickMap.hpp"
+#include <fstream>
+
+// Writes a brick map file: a header followed by one record per brick. Bricks are appended one at a time, so a map
+// never has to be in memory as a whole.
+class BrickMapWriter {
+public:
+    // Dimensions are in bricks. The file is written next to path and only replaces it once closed successfully.
+    BrickMapWriter(const std::string &path, const vec3 &position, const ivec3 &dimensions, float voxelSize);
+
+    ~BrickMapWriter();
+
+    bool IsOpen() const { return m_File.is_open(); }
+
+    void Write(const ivec3 &brickPosition, const BrickMap::Brick &brick, const BrickMap::BrickTexture &texture);
+
+    // Writes every brick of a map, offset is added to the brick positions.
+    void Write(const BrickMap &brickMap, const ivec3 &offset = ivec3(0));
+
+    // Finishes the header and moves the file into place, returns false if anything failed to write.
+    bool Close();
+
+    uint32 GetBrickCount() const { return m_BrickCount; }
+
+private:
+    std::ofstream m_File;
+    std::string m_Path;
+    ivec3 m_Dimensions;
+    uint32 m_BrickCount = 0;
+};
+
+// Reads a file written by BrickMapWriter.
+std::optional<BrickMap> LoadBrickMap(const std::string &path);
@@ -0,0 +1,97 @@
+#include "TraversalStatistics.hpp"
+
+void
+TraversalStatistics::Add(const TraversalStatistics &other) {
+    rayCount += other.rayCount;
+    hitCount += other.hitCount;
+    uniqueBricks += other.uniqueBricks;
+    coarseStepTotal += other.coarseStepTotal;
+    fineStepTotal += other.fineStepTotal;
+    bricksEnteredTotal += other.bricksEnteredTotal;
+    for (uint32 i = 0; i < histogramBins; ++i) {
+        coarseSteps[i] += other.coarseSteps[i];
+        fineSteps[i] += other.fineSteps[i];
+        bricksEntered[i] += other.bricksEntered[i];
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+static void
+PrintHistogram(std::ostream &stream, const char *name, const uint32 (&histogram)[TraversalStatistics::histogramBins]) {
+    stream << "  " << name << ':';
+    for (uint32 i = 0; i < TraversalStatistics::histogramBins; ++i) {
+        if (histogram[i] == 0)
+            continue;
+        // Upper bound of the bin, exclusive.
+        stream << " <" << (i == 0 ? 1ull : 1ull << i) << '=' << histogram[i];
+    }
+    stream << '\n';
+}
+
+void
+TraversalStatistics::Print(std::ostream &stream) const {
+    const float rays = static_cast<float>(std::max(rayCount, 1u));
+    stream << "Rays: " << rayCount
+            << ", hits: " << hitCount
+            << ", coarse steps/ray: " << static_cast<float>(coarseStepTotal) / rays
+            << ", fine steps/ray: " << static_cast<float>(fineStepTotal) / rays
+            << ", bricks/ray: " << static_cast<float>(bricksEnteredTotal) / rays
+            << ", unique bricks: " << uniqueBricks << '\n';
+    PrintHistogram(stream, "Coarse steps", coarseSteps);
+    PrintHistogram(stream, "Fine steps", fineSteps);
+    PrintHistogram(stream, "Bricks entered", bricksEntered);
+}
+
+//------------------------------------------------------------------------------------------
+
+TraversalRecorder::TraversalRecorder(const uint32 brickCount)
+    : m_VisitedBricks((brickCount + 31) / 32) {
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+TraversalRecorder::RecordRay(const uint32 coarseSteps, const uint32 fineSteps, const uint32 bricksEntered,
+                             const bool hit) {
+    m_Statistics.rayCount++;
+    m_Statistics.hitCount += hit;
+    m_Statistics.coarseStepTotal += coarseSteps;
+    m_Statistics.fineStepTotal += fineSteps;
+    m_Statistics.bricksEnteredTotal += bricksEntered;
+    m_Statistics.coarseSteps[TraversalStatistics::GetBin(coarseSteps)]++;
+    m_Statistics.fineSteps[TraversalStatistics::GetBin(fineSteps)]++;
+    m_Statistics.bricksEntered[TraversalStatistics::GetBin(bricksEntered)]++;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+TraversalRecorder::VisitBrick(const uint32 brickIndex) {
+    if (brickIndex / 32 >= m_VisitedBricks.size())
+        m_VisitedBricks.resize(brickIndex / 32 + 1);
+
+    const uint32 bit = 1u << brickIndex % 32;
+    uint32 &word = m_VisitedBricks[brickIndex / 32];
+    if ((word & bit) == 0) {
+        word |= bit;
+        m_Statistics.uniqueBricks++;
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+TraversalRecorder::Merge(const TraversalRecorder &other) {
+    const uint32 uniqueBricks = m_Statistics.uniqueBricks;
+    m_Statistics.Add(other.m_Statistics);
+
+    if (m_VisitedBricks.size() < other.m_VisitedBricks.size())
+        m_VisitedBricks.resize(other.m_VisitedBricks.size());
+
+    m_Statistics.uniqueBricks = uniqueBricks;
+    for (size_t i = 0; i < other.m_VisitedBricks.size(); ++i) {
+        m_Statistics.uniqueBricks += std::popcount(other.m_VisitedBricks[i] & ~m_VisitedBricks[i]);
+        m_VisitedBricks[i] |= other.m_VisitedBricks[i];
+    }
+}
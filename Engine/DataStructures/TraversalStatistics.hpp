@@ -0,0 +1,53 @@
+#pragma once
+
+#include <bit>
+#include <iosfwd>
+
+// Counters of a batch of rays traversing a brick map, filled by BrickMap::RayCast and by rtBrickmap.comp.
+// The layout matches the TraversalStats buffer in the shader, so the GPU results can be copied straight into it.
+struct TraversalStatistics {
+    // Bin 0 counts rays with no steps, bin i > 0 counts rays with [2^(i-1), 2^i) steps.
+    static constexpr uint32 histogramBins = 32;
+
+    uint32 rayCount = 0;
+    uint32 hitCount = 0;
+    // Distinct bricks entered by any ray.
+    uint32 uniqueBricks = 0;
+    // Totals over all rays, the GPU counters wrap after 2^32.
+    uint32 coarseStepTotal = 0;
+    uint32 fineStepTotal = 0;
+    uint32 bricksEnteredTotal = 0;
+
+    uint32 coarseSteps[histogramBins] = {};
+    uint32 fineSteps[histogramBins] = {};
+    uint32 bricksEntered[histogramBins] = {};
+
+    static uint32 GetBin(const uint32 count) {
+        return std::min(static_cast<uint32>(std::bit_width(count)), histogramBins - 1);
+    }
+
+    // Adds the counters of another batch, unique bricks are only exact if the batches touched disjoint bricks.
+    void Add(const TraversalStatistics &other);
+
+    // One line of totals per ray followed by the non-empty histogram bins.
+    void Print(std::ostream &stream) const;
+};
+
+// Accumulates statistics on the CPU and keeps track of which bricks have been entered.
+class TraversalRecorder {
+public:
+    explicit TraversalRecorder(uint32 brickCount = 0);
+
+    void RecordRay(uint32 coarseSteps, uint32 fineSteps, uint32 bricksEntered, bool hit);
+
+    void VisitBrick(uint32 brickIndex);
+
+    // Combines the recorder of another thread, bricks entered by both are counted once.
+    void Merge(const TraversalRecorder &other);
+
+    const TraversalStatistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    TraversalStatistics m_Statistics;
+    std::vector<uint32> m_VisitedBricks;
+};
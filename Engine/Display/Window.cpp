@@ -319,22 +319,32 @@ namespace Display {
         glfwPollEvents();
     }
 
+    //------------------------------------------------------------------------------
+    /**
+     */
+    void
+    Window::RenderUi() {
+        if (m_Window && nullptr != m_UiFunc && !m_UiRendered) {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            m_UiFunc();
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        m_UiRendered = true;
+    }
+
     //------------------------------------------------------------------------------
     /**
      */
     void
     Window::SwapBuffers() {
         if (m_Window) {
-            if (nullptr != m_UiFunc) {
-                ImGui_ImplOpenGL3_NewFrame();
-                ImGui_ImplGlfw_NewFrame();
-                ImGui::NewFrame();
-                m_UiFunc();
-                ImGui::Render();
-                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-            }
+            RenderUi();
             glfwSwapBuffers(m_Window);
         }
+        m_UiRendered = false;
     }
 
     //------------------------------------------------------------------------------
@@ -30,6 +30,9 @@ public:
   void MakeCurrent();
 
   void Update();
+  /// draws the ui set by SetUiRender, SwapBuffers draws it if this was not
+  /// called during the frame
+  void RenderUi();
   void SwapBuffers();
 
   void SetKeyPressFunction(
@@ -75,6 +78,7 @@ private:
   std::function<void(bool)> m_MouseLeaveEnterCallback;
   std::function<void(float64, float64)> m_MouseScrollCallback;
   std::function<void()> m_UiFunc;
+  bool m_UiRendered = false;
   std::function<void(int32, int32)> m_ResizeCallback;
 
   int32 m_Width;
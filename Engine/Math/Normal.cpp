@@ -0,0 +1,27 @@
+#include "Normal.hpp"
+
+static vec2
+SignNotZero(const vec2 &v) {
+    return {v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f};
+}
+
+uint16
+math::EncodeNormal(const vec3 &normal) {
+    // Project onto the octahedron and fold the lower half over the upper one.
+    vec2 p = vec2(normal) / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+    if (normal.z < 0.0f)
+        p = (1.0f - abs(vec2(p.y, p.x))) * SignNotZero(p);
+
+    const vec2 quantized = round(clamp(p * 0.5f + 0.5f, 0.0f, 1.0f) * 255.0f);
+    return static_cast<uint16>(quantized.x) | static_cast<uint16>(quantized.y) << 8;
+}
+
+vec3
+math::DecodeNormal(const uint16 packed) {
+    const vec2 p = vec2(packed & 0xFF, packed >> 8) / 255.0f * 2.0f - 1.0f;
+    vec3 normal(p, 1.0f - std::abs(p.x) - std::abs(p.y));
+    const float t = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -t : t;
+    normal.y += normal.y >= 0.0f ? -t : t;
+    return normalize(normal);
+}
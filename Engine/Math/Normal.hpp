@@ -0,0 +1,9 @@
+#pragma once
+
+namespace math {
+    // Unit vectors packed into 16 bits with an octahedral mapping, 8 bits per coordinate. The largest angular error
+    // is below a degree. DecodeNormal in rtBrickmap.comp uses the same layout.
+    uint16 EncodeNormal(const vec3 &normal);
+
+    vec3 DecodeNormal(uint16 packed);
+}
@@ -0,0 +1,272 @@
+#include "PerlinNoiseBatch.hpp"
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace math {
+    namespace {
+        // Per lane data gathered from the permutation table, hash[corner][lane].
+        struct Corners {
+            alignas(32) float fx[PerlinNoiseBatch::batchSize];
+            alignas(32) float fy[PerlinNoiseBatch::batchSize];
+            alignas(32) float fz[PerlinNoiseBatch::batchSize];
+            alignas(32) int32 hash[8][PerlinNoiseBatch::batchSize];
+        };
+
+#if defined(__AVX2__)
+        struct Lanes {
+            using F = __m256;
+            using I = __m256i;
+            static constexpr uint32 width = 8;
+            static constexpr const char *name = "AVX2";
+
+            static F Load(const float *p) { return _mm256_load_ps(p); }
+            static I Load(const int32 *p) { return _mm256_load_si256(reinterpret_cast<const I *>(p)); }
+            static void Store(float *p, const F v) { _mm256_store_ps(p, v); }
+            static F Set(const float v) { return _mm256_set1_ps(v); }
+            static I Set(const int32 v) { return _mm256_set1_epi32(v); }
+            static F Add(const F a, const F b) { return _mm256_add_ps(a, b); }
+            static F Sub(const F a, const F b) { return _mm256_sub_ps(a, b); }
+            static F Mul(const F a, const F b) { return _mm256_mul_ps(a, b); }
+            static I And(const I a, const I b) { return _mm256_and_si256(a, b); }
+            static I Or(const I a, const I b) { return _mm256_or_si256(a, b); }
+            static I Equal(const I a, const I b) { return _mm256_cmpeq_epi32(a, b); }
+            static I Less(const I a, const I b) { return _mm256_cmpgt_epi32(b, a); }
+            static I ShiftLeft(const I a, const int n) { return _mm256_slli_epi32(a, n); }
+            static F FlipSign(const F a, const I bits) { return _mm256_xor_ps(a, _mm256_castsi256_ps(bits)); }
+            static F Select(const I mask, const F a, const F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+        };
+#elif defined(__SSE2__) || defined(_M_X64)
+        struct Lanes {
+            using F = __m128;
+            using I = __m128i;
+            static constexpr uint32 width = 4;
+            static constexpr const char *name = "SSE2";
+
+            static F Load(const float *p) { return _mm_load_ps(p); }
+            static I Load(const int32 *p) { return _mm_load_si128(reinterpret_cast<const I *>(p)); }
+            static void Store(float *p, const F v) { _mm_store_ps(p, v); }
+            static F Set(const float v) { return _mm_set1_ps(v); }
+            static I Set(const int32 v) { return _mm_set1_epi32(v); }
+            static F Add(const F a, const F b) { return _mm_add_ps(a, b); }
+            static F Sub(const F a, const F b) { return _mm_sub_ps(a, b); }
+            static F Mul(const F a, const F b) { return _mm_mul_ps(a, b); }
+            static I And(const I a, const I b) { return _mm_and_si128(a, b); }
+            static I Or(const I a, const I b) { return _mm_or_si128(a, b); }
+            static I Equal(const I a, const I b) { return _mm_cmpeq_epi32(a, b); }
+            static I Less(const I a, const I b) { return _mm_cmplt_epi32(a, b); }
+            static I ShiftLeft(const I a, const int n) { return _mm_slli_epi32(a, n); }
+            static F FlipSign(const F a, const I bits) { return _mm_xor_ps(a, _mm_castsi128_ps(bits)); }
+
+            static F Select(const I mask, const F a, const F b) {
+                const F m = _mm_castsi128_ps(mask);
+                return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+            }
+        };
+#else
+        struct Lanes {
+            using F = float;
+            using I = int32;
+            static constexpr uint32 width = 1;
+            static constexpr const char *name = "Scalar";
+
+            static F Load(const float *p) { return *p; }
+            static I Load(const int32 *p) { return *p; }
+            static void Store(float *p, const F v) { *p = v; }
+            static F Set(const float v) { return v; }
+            static I Set(const int32 v) { return v; }
+            static F Add(const F a, const F b) { return a + b; }
+            static F Sub(const F a, const F b) { return a - b; }
+            static F Mul(const F a, const F b) { return a * b; }
+            static I And(const I a, const I b) { return a & b; }
+            static I Or(const I a, const I b) { return a | b; }
+            static I Equal(const I a, const I b) { return a == b ? -1 : 0; }
+            static I Less(const I a, const I b) { return a < b ? -1 : 0; }
+            static I ShiftLeft(const I a, const int n) { return static_cast<I>(static_cast<uint32>(a) << n); }
+            static F FlipSign(const F a, const I bits) { return std::bit_cast<F>(std::bit_cast<I>(a) ^ bits); }
+            static F Select(const I mask, const F a, const F b) { return mask ? a : b; }
+        };
+#endif
+
+        using F = Lanes::F;
+        using I = Lanes::I;
+
+        F
+        Fade(const F t) {
+            // t * t * t * (t * (t * 6 - 15) + 10)
+            const F inner = Lanes::Add(Lanes::Mul(t, Lanes::Sub(Lanes::Mul(t, Lanes::Set(6.0f)), Lanes::Set(15.0f))),
+                                       Lanes::Set(10.0f));
+            return Lanes::Mul(Lanes::Mul(Lanes::Mul(t, t), t), inner);
+        }
+
+        F
+        Lerp(const F a, const F b, const F t) {
+            return Lanes::Add(a, Lanes::Mul(Lanes::Sub(b, a), t));
+        }
+
+        // Branch free version of siv::perlin_detail::Grad.
+        F
+        Grad(const I hash, const F x, const F y, const F z) {
+            const I h = Lanes::And(hash, Lanes::Set(15));
+            const F u = Lanes::Select(Lanes::Less(h, Lanes::Set(8)), x, y);
+            const I useX = Lanes::Or(Lanes::Equal(h, Lanes::Set(12)), Lanes::Equal(h, Lanes::Set(14)));
+            const F v = Lanes::Select(Lanes::Less(h, Lanes::Set(4)), y, Lanes::Select(useX, x, z));
+
+            // Bit 0 and 1 of the hash flip the sign of u and v.
+            const F signedU = Lanes::FlipSign(u, Lanes::ShiftLeft(h, 31));
+            const F signedV = Lanes::FlipSign(v, Lanes::ShiftLeft(Lanes::And(h, Lanes::Set(2)), 30));
+            return Lanes::Add(signedU, signedV);
+        }
+
+        void
+        GatherCorners(const siv::PerlinNoise::state_type &p, const float *x, const float *y, const float *z,
+                      Corners &corners) {
+            for (uint32 i = 0; i < PerlinNoiseBatch::batchSize; ++i) {
+                const float floorX = std::floor(x[i]);
+                const float floorY = std::floor(y[i]);
+                const float floorZ = std::floor(z[i]);
+
+                const int32 ix = static_cast<int32>(floorX) & 255;
+                const int32 iy = static_cast<int32>(floorY) & 255;
+                const int32 iz = static_cast<int32>(floorZ) & 255;
+
+                corners.fx[i] = x[i] - floorX;
+                corners.fy[i] = y[i] - floorY;
+                corners.fz[i] = z[i] - floorZ;
+
+                const uint8 A = (p[ix] + iy) & 255;
+                const uint8 B = (p[(ix + 1) & 255] + iy) & 255;
+
+                const uint8 AA = (p[A] + iz) & 255;
+                const uint8 AB = (p[(A + 1) & 255] + iz) & 255;
+
+                const uint8 BA = (p[B] + iz) & 255;
+                const uint8 BB = (p[(B + 1) & 255] + iz) & 255;
+
+                corners.hash[0][i] = p[AA];
+                corners.hash[1][i] = p[BA];
+                corners.hash[2][i] = p[AB];
+                corners.hash[3][i] = p[BB];
+                corners.hash[4][i] = p[(AA + 1) & 255];
+                corners.hash[5][i] = p[(BA + 1) & 255];
+                corners.hash[6][i] = p[(AB + 1) & 255];
+                corners.hash[7][i] = p[(BB + 1) & 255];
+            }
+        }
+
+        void
+        Evaluate(const Corners &corners, float *result) {
+            const F one = Lanes::Set(1.0f);
+
+            for (uint32 i = 0; i < PerlinNoiseBatch::batchSize; i += Lanes::width) {
+                const F fx = Lanes::Load(corners.fx + i);
+                const F fy = Lanes::Load(corners.fy + i);
+                const F fz = Lanes::Load(corners.fz + i);
+                const F fx1 = Lanes::Sub(fx, one);
+                const F fy1 = Lanes::Sub(fy, one);
+                const F fz1 = Lanes::Sub(fz, one);
+
+                const F u = Fade(fx);
+                const F v = Fade(fy);
+                const F w = Fade(fz);
+
+                const F p0 = Grad(Lanes::Load(corners.hash[0] + i), fx, fy, fz);
+                const F p1 = Grad(Lanes::Load(corners.hash[1] + i), fx1, fy, fz);
+                const F p2 = Grad(Lanes::Load(corners.hash[2] + i), fx, fy1, fz);
+                const F p3 = Grad(Lanes::Load(corners.hash[3] + i), fx1, fy1, fz);
+                const F p4 = Grad(Lanes::Load(corners.hash[4] + i), fx, fy, fz1);
+                const F p5 = Grad(Lanes::Load(corners.hash[5] + i), fx1, fy, fz1);
+                const F p6 = Grad(Lanes::Load(corners.hash[6] + i), fx, fy1, fz1);
+                const F p7 = Grad(Lanes::Load(corners.hash[7] + i), fx1, fy1, fz1);
+
+                const F q0 = Lerp(p0, p1, u);
+                const F q1 = Lerp(p2, p3, u);
+                const F q2 = Lerp(p4, p5, u);
+                const F q3 = Lerp(p6, p7, u);
+
+                const F r0 = Lerp(q0, q1, v);
+                const F r1 = Lerp(q2, q3, v);
+
+                Lanes::Store(result + i, Lerp(r0, r1, w));
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    PerlinNoiseBatch::PerlinNoiseBatch(const siv::PerlinNoise &noise)
+        : m_Permutation(noise.serialize()) {
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    PerlinNoiseBatch::Noise3D(const float *x, const float *y, const float *z, float *result) const {
+        Corners corners;
+        alignas(32) float noise[batchSize];
+        GatherCorners(m_Permutation, x, y, z, corners);
+        Evaluate(corners, noise);
+        std::copy_n(noise, batchSize, result);
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    PerlinNoiseBatch::Noise3D(const float *x, const float *y, const float *z, float *result, const size_t count) const {
+        size_t i = 0;
+        for (; i + batchSize <= count; i += batchSize) {
+            Noise3D(x + i, y + i, z + i, result + i);
+        }
+
+        if (i == count)
+            return;
+
+        // Pad the last batch.
+        float tailX[batchSize] = {}, tailY[batchSize] = {}, tailZ[batchSize] = {}, tail[batchSize];
+        std::copy(x + i, x + count, tailX);
+        std::copy(y + i, y + count, tailY);
+        std::copy(z + i, z + count, tailZ);
+        Noise3D(tailX, tailY, tailZ, tail);
+        std::copy_n(tail, count - i, result + i);
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    PerlinNoiseBatch::Octave2D01(const float *x, const float *y, const int32 octaves, float *result,
+                                 const float persistence) const {
+        float sampleX[batchSize], sampleY[batchSize], sampleZ[batchSize], noise[batchSize];
+        float sum[batchSize] = {};
+        std::copy_n(x, batchSize, sampleX);
+        std::copy_n(y, batchSize, sampleY);
+        std::fill_n(sampleZ, batchSize, static_cast<float>(SIVPERLIN_DEFAULT_Z));
+
+        float amplitude = 1.0f;
+        for (int32 octave = 0; octave < octaves; ++octave) {
+            Noise3D(sampleX, sampleY, sampleZ, noise);
+            for (uint32 i = 0; i < batchSize; ++i) {
+                sum[i] += noise[i] * amplitude;
+                sampleX[i] *= 2.0f;
+                sampleY[i] *= 2.0f;
+            }
+            amplitude *= persistence;
+        }
+
+        for (uint32 i = 0; i < batchSize; ++i) {
+            result[i] = siv::perlin_detail::RemapClamp_01(sum[i]);
+        }
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    const char *
+    PerlinNoiseBatch::GetInstructionSet() {
+        return Lanes::name;
+    }
+
+    //------------------------------------------------------------------------------------------
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PerlinNoise.hpp"
+
+namespace math {
+    // Evaluates siv::PerlinNoise for several points per call. Results match the scalar double version within
+    // float precision. Permutation lookups are done per lane, the gradient math uses AVX2 when built with
+    // VOX_ENABLE_AVX2, SSE2 on other x86-64 builds and plain loops elsewhere.
+    class PerlinNoiseBatch {
+    public:
+        static constexpr uint32 batchSize = 8;
+
+        // Upper bound of the partial derivatives of Noise3D along any axis. The sharp bound is 1.875 (the peak slope
+        // of the fade curve) times 2 (the largest dot product difference), reached in the middle of a lattice cell.
+        static constexpr float maxDerivative = 3.75f;
+
+        PerlinNoiseBatch() = default;
+
+        explicit PerlinNoiseBatch(const siv::PerlinNoise &noise);
+
+        // Evaluates batchSize points, results are in the range [-1, 1].
+        void Noise3D(const float *x, const float *y, const float *z, float *result) const;
+
+        // Evaluates any number of points.
+        void Noise3D(const float *x, const float *y, const float *z, float *result, size_t count) const;
+
+        // Same as siv::PerlinNoise::octave2D_01 for batchSize points.
+        void Octave2D01(const float *x, const float *y, int32 octaves, float *result, float persistence = 0.5f) const;
+
+        // Name of the instruction set the batch was compiled for.
+        static const char *GetInstructionSet();
+
+    private:
+        siv::PerlinNoise::state_type m_Permutation = siv::PerlinNoise().serialize();
+    };
+}
@@ -11,7 +11,7 @@ namespace math {
         const vec3 t1 = min(tMin, tMax);
         const vec3 t2 = max(tMin, tMax);
         const float tNear = std::max(std::max(t1.x, t1.y), t1.z);
-        const float tFar = std::max(std::max(t2.x, t2.y), t2.z);
+        const float tFar = std::min(std::min(t2.x, t2.y), t2.z);
         return tNear < tFar && tFar > 0.0f;
     }
 
@@ -24,7 +24,7 @@ namespace math {
         const vec3 t1 = min(tMin, tMax);
         const vec3 t2 = max(tMin, tMax);
         tNear = std::max(std::max(t1.x, t1.y), t1.z);
-        tFar = std::max(std::max(t2.x, t2.y), t2.z);
+        tFar = std::min(std::min(t2.x, t2.y), t2.z);
         return tNear < tFar && tFar > 0.0f;
     }
 
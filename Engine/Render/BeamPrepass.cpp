@@ -0,0 +1,208 @@
+#include "BeamPrepass.hpp"
+#include "Camera.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <atomic>
+#include <cfloat>
+
+uint32
+BeamPrepass::GetLevelCount(const ivec3 &gridSize) {
+    uint32 count = 1;
+    for (ivec3 size = gridSize; std::max(size.x, std::max(size.y, size.z)) > 1; size = (size + 1) / 2)
+        count++;
+    return count;
+}
+
+BeamPrepass::BeamPrepass(const Settings &settings)
+    : m_Settings(settings) {
+    m_Settings.tileSize = std::max(m_Settings.tileSize, 1);
+}
+
+void
+BeamPrepass::Build(const BrickMap &bm) {
+    PROFILE_SCOPE("BeamPrepass::Build");
+    m_Levels.clear();
+    ivec3 size = bm.GetDimensions();
+    uint32 wordCount = 0;
+    for (uint32 level = 0; level < GetLevelCount(bm.GetDimensions()); ++level) {
+        m_Levels.push_back({size, wordCount});
+        const ivec3 padded = size + 2;
+        wordCount += (padded.x * padded.y * padded.z + 31) / 32;
+        size = (size + 1) / 2;
+    }
+    m_Occupancy.assign(wordCount, 0);
+    m_Pyramid.assign(wordCount, 0);
+    Refresh(bm, ivec3(0), bm.GetDimensions() - 1);
+}
+
+void
+BeamPrepass::Update(const BrickMap &bm, const ivec3 &editMin, const ivec3 &editMax) {
+    PROFILE_SCOPE("BeamPrepass::Update");
+    const ivec3 brickMin = max(editMin / BRICK_DIMENSIONS, ivec3(0));
+    const ivec3 brickMax = min(editMax / BRICK_DIMENSIONS, bm.GetDimensions() - 1);
+    if (all(lessThanEqual(brickMin, brickMax)))
+        Refresh(bm, brickMin, brickMax);
+}
+
+uint32
+BeamPrepass::GetBit(const uint32 level, const ivec3 &cell) const {
+    const Level &info = m_Levels[level];
+    const ivec3 padded = info.size + 2;
+    return info.offset * 32 + (cell.x + 1) + padded.x * ((cell.y + 1) + padded.y * (cell.z + 1));
+}
+
+bool
+BeamPrepass::IsMarked(const uint32 level, const ivec3 &cell) const {
+    if (any(lessThan(cell, ivec3(-1))) || any(greaterThan(cell, m_Levels[level].size)))
+        return false;
+    const uint32 bit = GetBit(level, cell);
+    return m_Pyramid[bit / 32] >> bit % 32 & 1;
+}
+
+void
+BeamPrepass::Refresh(const BrickMap &bm, const ivec3 &brickMin, const ivec3 &brickMax) {
+    const auto set = [](std::vector<uint32> &bits, const uint32 bit, const bool value) {
+        if (value)
+            bits[bit / 32] |= 1u << bit % 32;
+        else
+            bits[bit / 32] &= ~(1u << bit % 32);
+    };
+
+    for (uint32 level = 0; level < m_Levels.size(); ++level) {
+        const ivec3 &size = m_Levels[level].size;
+        const ivec3 min = brickMin / (1 << level);
+        const ivec3 max = brickMax / (1 << level);
+
+        // A cell is occupied if it holds a brick, or one of its children on the level below is occupied.
+        ivec3 cell;
+        for (cell.z = min.z; cell.z <= max.z; ++cell.z) {
+            for (cell.y = min.y; cell.y <= max.y; ++cell.y) {
+                for (cell.x = min.x; cell.x <= max.x; ++cell.x) {
+                    bool occupied = false;
+                    if (level == 0) {
+                        occupied = bm.GetGrid()[bm.GetCellIndex(cell)] != EMPTY_BRICK;
+                    } else {
+                        const ivec3 &childSize = m_Levels[level - 1].size;
+                        const ivec3 childMax = glm::min(cell * 2 + 1, childSize - 1);
+                        ivec3 child;
+                        for (child.z = cell.z * 2; child.z <= childMax.z && !occupied; ++child.z)
+                            for (child.y = cell.y * 2; child.y <= childMax.y && !occupied; ++child.y)
+                                for (child.x = cell.x * 2; child.x <= childMax.x && !occupied; ++child.x) {
+                                    const uint32 bit = GetBit(level - 1, child);
+                                    occupied = m_Occupancy[bit / 32] >> bit % 32 & 1;
+                                }
+                    }
+                    set(m_Occupancy, GetBit(level, cell), occupied);
+                }
+            }
+        }
+
+        // Marks change one cell around the occupancy that changed, including the padding.
+        const ivec3 markMin = glm::max(min - 1, ivec3(-1));
+        const ivec3 markMax = glm::min(max + 1, size);
+        for (cell.z = markMin.z; cell.z <= markMax.z; ++cell.z) {
+            for (cell.y = markMin.y; cell.y <= markMax.y; ++cell.y) {
+                for (cell.x = markMin.x; cell.x <= markMax.x; ++cell.x) {
+                    const ivec3 neighbourMin = glm::max(cell - 1, ivec3(0));
+                    const ivec3 neighbourMax = glm::min(cell + 1, size - 1);
+                    bool marked = false;
+                    ivec3 neighbour;
+                    for (neighbour.z = neighbourMin.z; neighbour.z <= neighbourMax.z && !marked; ++neighbour.z)
+                        for (neighbour.y = neighbourMin.y; neighbour.y <= neighbourMax.y && !marked; ++neighbour.y)
+                            for (neighbour.x = neighbourMin.x; neighbour.x <= neighbourMax.x && !marked;
+                                 ++neighbour.x) {
+                                const uint32 bit = GetBit(level, neighbour);
+                                marked = m_Occupancy[bit / 32] >> bit % 32 & 1;
+                            }
+                    set(m_Pyramid, GetBit(level, cell), marked);
+                }
+            }
+        }
+    }
+}
+
+float
+BeamPrepass::TraceCone(const BrickMap &bm, const math::Ray &axis, const float tanAngle, uint64 &steps) const {
+    const math::BoundingBox &bounds = bm.GetBoundingBox();
+    const float brickSize = bm.GetVoxelSize() * BRICK_DIMENSIONS;
+    const float epsilon = bm.GetVoxelSize() * 1e-3f;
+
+    // Every point of the cone is at least as far from the apex as along the axis, so past the farthest corner of the
+    // map the cone cannot reach it.
+    float farthest = 0.0f;
+    for (uint32 corner = 0; corner < 8; ++corner) {
+        const vec3 point(corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y,
+                         corner & 4 ? bounds.max.z : bounds.min.z);
+        farthest = std::max(farthest, distance(point, axis.origin));
+    }
+
+    float t = 0.0f;
+    while (t < farthest) {
+        const vec3 position = axis.origin + axis.direction * t - bounds.min;
+        bool advanced = false;
+        for (int32 level = static_cast<int32>(m_Levels.size()) - 1; level >= 0; --level) {
+            const float cellSize = brickSize * static_cast<float>(1 << level);
+            const ivec3 cell(floor(position / cellSize));
+
+            float exitDistance = FLT_MAX;
+            for (int32 i = 0; i < 3; ++i) {
+                if (axis.direction[i] != 0.0f) {
+                    const float boundary = static_cast<float>(cell[i] + (axis.direction[i] > 0.0f)) * cellSize;
+                    exitDistance = std::min(exitDistance, (boundary - position[i]) / axis.direction[i]);
+                }
+            }
+            const float tExit = t + exitDistance + epsilon;
+
+            // The cone has to stay within one cell of the axis until it leaves, cells on lower levels are smaller.
+            if (tExit * tanAngle + epsilon > cellSize)
+                break;
+            if (!IsMarked(level, cell)) {
+                t = tExit;
+                advanced = true;
+                steps++;
+                break;
+            }
+        }
+        if (!advanced)
+            return t;
+    }
+    return farthest;
+}
+
+void
+BeamPrepass::Trace(const BrickMap &bm, const Camera &camera, const int32 width, const int32 height) {
+    PROFILE_SCOPE("BeamPrepass::Trace");
+    const int32 tileSize = m_Settings.tileSize;
+    const ivec2 tiles((width + tileSize - 1) / tileSize, (height + tileSize - 1) / tileSize);
+    const vec2 resolution(width, height);
+    m_StartDistances.resize(tiles.x * tiles.y);
+    m_Statistics = {};
+    m_Statistics.tileCount = m_StartDistances.size();
+
+    std::atomic<uint64> stepCount = 0;
+    parallel::For(m_StartDistances.size(), [&](const uint32 tile, uint32) {
+        // Rays of the corner pixels bound the rays of the tile.
+        const ivec2 first = ivec2(tile % tiles.x, tile / tiles.x) * tileSize;
+        const ivec2 last = glm::min(first + tileSize, ivec2(width, height)) - 1;
+        vec3 directions[4];
+        vec3 axis(0.0f);
+        for (uint32 corner = 0; corner < 4; ++corner) {
+            const ivec2 pixel(corner & 1 ? last.x : first.x, corner & 2 ? last.y : first.y);
+            directions[corner] = camera.GetPixelRay(vec2(pixel) / resolution * 2.0f - 1.0f).direction;
+            axis += directions[corner];
+        }
+        axis = normalize(axis);
+
+        float cosAngle = 1.0f;
+        for (const vec3 &direction: directions)
+            cosAngle = std::min(cosAngle, dot(axis, direction));
+        const float tanAngle = std::sqrt(std::max(1.0f - cosAngle * cosAngle, 0.0f)) / cosAngle;
+
+        uint64 steps = 0;
+        m_StartDistances[tile] = TraceCone(bm, {camera.GetPosition(), axis}, tanAngle, steps);
+        stepCount += steps;
+    });
+    m_Statistics.stepCount = stepCount;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Math/Ray.hpp"
+
+class BrickMap;
+class Camera;
+
+// Finds how far every primary ray of a screen tile can skip before it may reach a brick, done by beam.comp on the GPU.
+// One cone per tile, containing the rays of all its pixels, is traced through an occupancy pyramid of the coarse grid.
+// A cell on level L covers 2^L bricks per side and is marked if any brick within one cell of it is occupied. Where the
+// cone's radius fits in a cell whose mark is clear, the cone cannot touch a brick until it leaves that cell, so the
+// trace jumps to the exit of the highest such level and stops where none is left.
+class BeamPrepass {
+public:
+    struct Settings {
+        // Pixels per side of a tile, beam.comp and rtBrickmap.comp use BEAM_TILE_SIZE.
+        int32 tileSize = 8;
+    };
+
+    struct Statistics {
+        uint32 tileCount = 0;
+        // Pyramid cells the cones stepped over.
+        uint64 stepCount = 0;
+    };
+
+    // Levels of the pyramid for a grid, the last one is a single cell.
+    static uint32 GetLevelCount(const ivec3 &gridSize);
+
+    explicit BeamPrepass(const Settings &settings);
+
+    void Build(const BrickMap &bm);
+
+    // Refreshes the pyramid over an edited inclusive voxel region, the map has to keep its dimensions.
+    void Update(const BrickMap &bm, const ivec3 &editMin, const ivec3 &editMax);
+
+    // Start distance of every tile for the primary rays of a camera, see Camera::GetPixelRay.
+    void Trace(const BrickMap &bm, const Camera &camera, int32 width, int32 height);
+
+    // Distance along a cone's axis before which it cannot reach a brick. tanAngle is the tangent of its half angle.
+    float TraceCone(const BrickMap &bm, const math::Ray &axis, float tanAngle, uint64 &steps) const;
+
+    // One distance per tile, rows of tiles from the bottom of the screen.
+    const std::vector<float> &GetStartDistances() const { return m_StartDistances; }
+
+    // Marked cells of every level as bits. Each level is padded by one cell on every side and starts on a new word.
+    const std::vector<uint32> &GetPyramid() const { return m_Pyramid; }
+
+    const Settings &GetSettings() const { return m_Settings; }
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    struct Level {
+        ivec3 size{};
+        // First word of the level in m_Pyramid and m_Occupancy.
+        uint32 offset = 0;
+    };
+
+    // Recomputes occupancy and marks of the cells over an inclusive range of bricks.
+    void Refresh(const BrickMap &bm, const ivec3 &brickMin, const ivec3 &brickMax);
+
+    // Bit of a cell in its padded level, cells may be one outside the level.
+    uint32 GetBit(uint32 level, const ivec3 &cell) const;
+
+    bool IsMarked(uint32 level, const ivec3 &cell) const;
+
+    Settings m_Settings;
+    Statistics m_Statistics;
+
+    std::vector<Level> m_Levels;
+    // Cells containing a brick, laid out like the pyramid.
+    std::vector<uint32> m_Occupancy;
+    std::vector<uint32> m_Pyramid;
+
+    std::vector<float> m_StartDistances;
+};
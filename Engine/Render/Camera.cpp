@@ -55,3 +55,11 @@ Camera::LookAt(const vec3 &eye, const vec3 &target, const vec3 &up) {
   m_InvView = inverse(m_View);
   m_InvProjView = m_InvProjection * m_InvView;
 }
+
+//------------------------------------------------------------------------------------------
+
+math::Ray
+Camera::GetPixelRay(const vec2 &uv) const {
+  const vec4 target = m_InvProjection * vec4(uv.x, uv.y, 1.0f, 1.0f);
+  return {m_Position, vec3(m_InvView * vec4(normalize(vec3(target) / target.w), 0.0f))};
+}
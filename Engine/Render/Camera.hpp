@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Math/Ray.hpp"
+
 class Camera {
 public:
   Camera();
@@ -24,6 +26,9 @@ public:
   const mat4 &GetInvView() const { return m_InvView; }
   const mat4 &GetInvProjView() const { return m_InvProjView; }
 
+  // Ray through a point of the image in [-1, 1], the same ray as CastRay in rt.glsl.
+  math::Ray GetPixelRay(const vec2 &uv) const;
+
   static Camera *GetMainCamera() { return s_MainCamera; }
   static void SetMainCamera(Camera *camera) { s_MainCamera = camera; }
 
@@ -0,0 +1,170 @@
+#include "GpuTimer.hpp"
+#include "GL/glew.h"
+
+#include <algorithm>
+
+uint32
+GlQueryBackend::Create() {
+    uint32 query = 0;
+    glGenQueries(1, &query);
+    return query;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GlQueryBackend::Destroy(const uint32 query) {
+    glDeleteQueries(1, &query);
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GlQueryBackend::Begin(const uint32 query) {
+    glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GlQueryBackend::End(uint32) {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+//------------------------------------------------------------------------------------------
+
+bool
+GlQueryBackend::TryGetResult(const uint32 query, uint64 &nanoseconds) {
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+        return false;
+
+    GLuint64 result = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+    nanoseconds = result;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------
+
+GpuTimerPool::GpuTimerPool(std::unique_ptr<GpuQueryBackend> backend, const uint32 frameCount)
+    : m_Backend(std::move(backend)), m_Frames(std::max(frameCount, 1u)) {
+}
+
+//------------------------------------------------------------------------------------------
+
+GpuTimerPool::~GpuTimerPool() {
+    for (const Frame &frame: m_Frames) {
+        for (const Query &query: frame.queries)
+            m_Backend->Destroy(query.id);
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GpuTimerPool::BeginFrame() {
+    assert(!m_InPass && "GpuTimerPool::BeginFrame called inside a pass");
+    const uint32 frameCount = m_Frames.size();
+    if (m_Recording) {
+        m_Frames[m_FrameIndex].pending = m_Frames[m_FrameIndex].usedCount > 0;
+        m_FrameIndex = (m_FrameIndex + 1) % frameCount;
+    }
+
+    // Frames finish in order, oldest first starting with the one that is about to be reused.
+    bool collected = false;
+    for (uint32 i = 0; i < frameCount; ++i) {
+        Frame &frame = m_Frames[(m_FrameIndex + i) % frameCount];
+        if (!frame.pending)
+            continue;
+        if (!TryCollect(frame))
+            break;
+        collected = true;
+    }
+    if (collected)
+        UpdateStatistics();
+
+    Frame &frame = m_Frames[m_FrameIndex];
+    if (frame.pending) {
+        frame.pending = false;
+        m_DroppedFrameCount++;
+    }
+    frame.usedCount = 0;
+    m_Recording = true;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GpuTimerPool::Begin(const char *name) {
+    assert(!m_InPass && "GPU timer passes can not be nested");
+    if (!m_Recording)
+        BeginFrame();
+
+    Frame &frame = m_Frames[m_FrameIndex];
+    if (frame.usedCount == frame.queries.size())
+        frame.queries.push_back({m_Backend->Create(), nullptr});
+
+    Query &query = frame.queries[frame.usedCount++];
+    query.name = name;
+    m_Backend->Begin(query.id);
+    m_InPass = true;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GpuTimerPool::End() {
+    assert(m_InPass && "GpuTimerPool::End called without Begin");
+    const Frame &frame = m_Frames[m_FrameIndex];
+    m_Backend->End(frame.queries[frame.usedCount - 1].id);
+    m_InPass = false;
+}
+
+//------------------------------------------------------------------------------------------
+
+bool
+GpuTimerPool::TryCollect(Frame &frame) {
+    // Queries complete in order, so the last one decides whether the frame is done.
+    uint64 nanoseconds = 0;
+    if (!m_Backend->TryGetResult(frame.queries[frame.usedCount - 1].id, nanoseconds))
+        return false;
+
+    const uint32 slot = m_CollectedCount++ % historySize;
+    for (auto &[name, history]: m_Histories)
+        history.ms[slot] = 0.0f;
+
+    for (uint32 i = 0; i < frame.usedCount; ++i) {
+        const Query &query = frame.queries[i];
+        if (!m_Backend->TryGetResult(query.id, nanoseconds))
+            nanoseconds = 0;
+        m_Histories[query.name].ms[slot] += static_cast<float>(nanoseconds) * 1e-6f;
+    }
+
+    frame.pending = false;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+GpuTimerPool::UpdateStatistics() {
+    const uint32 slot = (m_CollectedCount - 1) % historySize;
+    const uint32 frameCount = std::min(m_CollectedCount, historySize);
+
+    m_Statistics.clear();
+    for (const auto &[name, history]: m_Histories) {
+        PassStatistics &statistics = m_Statistics.emplace_back();
+        statistics.name = name;
+        statistics.lastMs = history.ms[slot];
+        for (uint32 i = 0; i < frameCount; ++i) {
+            statistics.averageMs += history.ms[i];
+            statistics.maxMs = std::max(statistics.maxMs, history.ms[i]);
+        }
+        statistics.averageMs /= static_cast<float>(frameCount);
+    }
+    std::sort(m_Statistics.begin(), m_Statistics.end(), [](const PassStatistics &a, const PassStatistics &b) {
+        return a.name < b.name;
+    });
+}
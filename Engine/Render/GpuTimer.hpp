@@ -0,0 +1,105 @@
+#pragma once
+
+// Issues and reads back GPU timer queries. GlQueryBackend is the real one, anything that completes queries in order
+// can stand in for it, which keeps GpuTimerPool testable without a GL context.
+class GpuQueryBackend {
+public:
+    virtual ~GpuQueryBackend() = default;
+
+    virtual uint32 Create() = 0;
+
+    virtual void Destroy(uint32 query) = 0;
+
+    virtual void Begin(uint32 query) = 0;
+
+    virtual void End(uint32 query) = 0;
+
+    // Returns false while the result is not available yet, must never block.
+    virtual bool TryGetResult(uint32 query, uint64 &nanoseconds) = 0;
+};
+
+// GL_TIME_ELAPSED queries.
+class GlQueryBackend final : public GpuQueryBackend {
+public:
+    uint32 Create() override;
+
+    void Destroy(uint32 query) override;
+
+    void Begin(uint32 query) override;
+
+    void End(uint32 query) override;
+
+    bool TryGetResult(uint32 query, uint64 &nanoseconds) override;
+};
+
+// Times render passes on the GPU. Every frame gets its own set of queries from a ring of frameCount sets, results are
+// read back once the GPU has finished a frame, so reading never stalls. A set whose results are still pending when its
+// turn comes again is dropped.
+class GpuTimerPool {
+public:
+    struct PassStatistics {
+        string name;
+        float lastMs = 0.0f;
+        float averageMs = 0.0f;
+        float maxMs = 0.0f;
+    };
+
+    static constexpr uint32 historySize = 120;
+
+    explicit GpuTimerPool(std::unique_ptr<GpuQueryBackend> backend = std::make_unique<GlQueryBackend>(),
+                          uint32 frameCount = 2);
+
+    ~GpuTimerPool();
+
+    NON_COPYABLE(GpuTimerPool)
+
+    // Collects finished frames and starts recording a new one.
+    void BeginFrame();
+
+    // Passes can not be nested, GL only allows one active time elapsed query. name must outlive the pool.
+    void Begin(const char *name);
+
+    void End();
+
+    // Sorted by name.
+    const std::vector<PassStatistics> &GetStatistics() const { return m_Statistics; }
+
+    // Frames whose results were not available in time.
+    uint32 GetDroppedFrameCount() const { return m_DroppedFrameCount; }
+
+    // Frames whose results were read back, lastMs is from the latest of them.
+    uint32 GetCollectedFrameCount() const { return m_CollectedCount; }
+
+private:
+    struct Query {
+        uint32 id = 0;
+        const char *name = nullptr;
+    };
+
+    struct Frame {
+        std::vector<Query> queries;
+        uint32 usedCount = 0;
+        bool pending = false;
+    };
+
+    struct PassHistory {
+        float ms[historySize] = {};
+    };
+
+    // Reads the results of a frame if all of them are available.
+    bool TryCollect(Frame &frame);
+
+    void UpdateStatistics();
+
+    std::unique_ptr<GpuQueryBackend> m_Backend;
+    std::vector<Frame> m_Frames;
+    uint32 m_FrameIndex = 0;
+    bool m_Recording = false;
+    bool m_InPass = false;
+
+    // History slot of the next collected frame.
+    uint32 m_CollectedCount = 0;
+    std::unordered_map<string, PassHistory> m_Histories;
+    std::vector<PassStatistics> m_Statistics;
+    uint32 m_DroppedFrameCount = 0;
+};
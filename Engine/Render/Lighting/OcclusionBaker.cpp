@@ -0,0 +1,148 @@
+#include "OcclusionBaker.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Math/Normal.hpp"
+#include "Math/Random.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <atomic>
+#include <numbers>
+
+constexpr ivec3 faceOffsets[] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+};
+
+// Orthonormal basis around a unit vector, Duff et al. 2017.
+static void
+BuildBasis(const vec3 &n, vec3 &tangent, vec3 &bitangent) {
+    const float sign = std::copysign(1.0f, n.z);
+    const float a = -1.0f / (sign + n.z);
+    const float b = n.x * n.y * a;
+    tangent = {1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x};
+    bitangent = {b, sign + n.y * n.y * a, -n.y};
+}
+
+std::vector<uint32>
+OcclusionBaker::Bake(BrickMap &bm, const ivec3 &min, const ivec3 &max) {
+    PROFILE_SCOPE("OcclusionBaker::Bake");
+    bm.EnableAttributes();
+
+    const ivec3 voxelMin = glm::max(min, ivec3(0));
+    const ivec3 voxelMax = glm::min(max, bm.GetDimensions() * BRICK_DIMENSIONS - 1);
+    const std::vector<uint32> bricks = bm.GetBricksInRegion(voxelMin, voxelMax);
+
+    const float voxelSize = bm.GetVoxelSize();
+    const vec3 origin = bm.GetBoundingBox().min;
+    const float maxDistanceSq = m_Settings.maxDistance * m_Settings.maxDistance;
+    // Rays start a voxel from the center and enter a voxel at most half its diagonal before its center, anything
+    // further away cannot be within maxDistance.
+    const float maxRayDistance = (m_Settings.maxDistance + 2.0f) * voxelSize;
+    const uint32 rayCount = std::max(m_Settings.rayCount, 1u);
+    std::atomic<uint64> exposedVoxels = 0;
+
+    parallel::For(bricks.size(), [&](const uint32 i, uint32) {
+        const uint32 brickIndex = bricks[i];
+        const uint32 cellIndex = bm.GetParents()[brickIndex];
+        const ivec3 brickOrigin = bm.GetCellPosition(cellIndex) * BRICK_DIMENSIONS;
+        const ivec3 localMin = glm::max(voxelMin - brickOrigin, ivec3(0));
+        const ivec3 localMax = glm::min(voxelMax - brickOrigin, ivec3(BRICK_DIMENSIONS - 1));
+        const BrickMap::Brick &brick = bm.GetBricks()[brickIndex];
+        BrickMap::BrickAttributes &attributes = bm.GetBrickAttributes(brickIndex);
+        uint64 exposed = 0;
+
+        for (int z = localMin.z; z <= localMax.z; ++z) {
+            for (int y = localMin.y; y <= localMax.y; ++y) {
+                for (int x = localMin.x; x <= localMax.x; ++x) {
+                    const uint32 voxelIndex = Flatten({x, y, z}, ivec3(BRICK_DIMENSIONS));
+                    if (!brick.VoxelAt(voxelIndex))
+                        continue;
+
+                    const ivec3 position = brickOrigin + ivec3(x, y, z);
+                    ivec3 open(0);
+                    uint32 openFaces = 0;
+                    bool openFace[6]{};
+                    for (uint32 face = 0; face < 6; ++face) {
+                        if (!bm.IsSolid(position + faceOffsets[face])) {
+                            open += faceOffsets[face];
+                            openFaces++;
+                            openFace[face] = true;
+                        }
+                    }
+                    // Hidden voxels are never shaded.
+                    if (openFaces == 0) {
+                        attributes.occlusion[voxelIndex] = UINT8_MAX;
+                        continue;
+                    }
+                    exposed++;
+
+                    // Stored normals have no reliable sign, face the open side.
+                    vec3 normal = math::DecodeNormal(attributes.normals[voxelIndex]);
+                    if (dot(normal, vec3(open)) < 0.0f)
+                        normal = -normal;
+                    vec3 tangent, bitangent;
+                    BuildBasis(normal, tangent, bitangent);
+
+                    // Rays start in the center of the open neighbour closest to the normal, which is known to be
+                    // empty. A point a voxel out along the normal could lie in a solid diagonal neighbour.
+                    ivec3 startOffset(0);
+                    float bestAlignment = -FLT_MAX;
+                    for (uint32 face = 0; face < 6; ++face) {
+                        const float alignment = dot(vec3(faceOffsets[face]), normal);
+                        if (openFace[face] && alignment > bestAlignment) {
+                            startOffset = faceOffsets[face];
+                            bestAlignment = alignment;
+                        }
+                    }
+                    const vec3 center = vec3(position) + 0.5f;
+                    const vec3 rayOrigin = origin + (center + vec3(startOffset)) * voxelSize;
+
+                    // Every voxel has its own random stream, so partial bakes match full ones.
+                    const uint32 hash = (position.x * 73856093u) ^ (position.y * 19349663u) ^ (position.z * 83492791u);
+                    math::random::SetSeed(math::random::FastRandom(m_Settings.seed ^ hash));
+                    const float rotation = math::random::RandomFloat();
+                    uint32 occluded = 0;
+
+                    for (uint32 ray = 0; ray < rayCount; ++ray) {
+                        // Stratified in the radius, rotated per voxel to trade banding for noise.
+                        const float u = (static_cast<float>(ray) + math::random::RandomFloat()) /
+                                        static_cast<float>(rayCount);
+                        const float phi = 2.0f * std::numbers::pi_v<float> *
+                                          (static_cast<float>(ray) * std::numbers::phi_v<float> + rotation);
+                        const float radius = std::sqrt(u);
+                        const vec3 direction = tangent * (radius * std::cos(phi)) +
+                                               bitangent * (radius * std::sin(phi)) +
+                                               normal * std::sqrt(1.0f - u);
+
+                        const auto hit = bm.RayCast({rayOrigin, direction}, 0.0f, nullptr, 0.0f, maxRayDistance);
+                        // Rays leaving the start cell sideways can come back through the voxel itself.
+                        if (!hit || hit->position == position)
+                            continue;
+                        const vec3 toHit = vec3(hit->position) + 0.5f - center;
+                        occluded += dot(toHit, toHit) < maxDistanceSq;
+                    }
+
+                    attributes.occlusion[voxelIndex] = static_cast<uint8>(
+                        (occluded * UINT8_MAX + rayCount / 2) / rayCount);
+                }
+            }
+        }
+        exposedVoxels += exposed;
+    });
+
+    m_Statistics.brickCount = bricks.size();
+    m_Statistics.exposedVoxels = exposedVoxels;
+    m_Statistics.rayCount = exposedVoxels * rayCount;
+    return bricks;
+}
+
+std::vector<uint32>
+OcclusionBaker::BakeAround(BrickMap &bm, const ivec3 &editMin, const ivec3 &editMax) {
+    // Rays only count hits within maxDistance, and the voxels next to the edit see a different exposure.
+    const int reach = static_cast<int>(std::ceil(m_Settings.maxDistance)) + 1;
+    return Bake(bm, editMin - reach, editMax + reach);
+}
+
+std::vector<uint32>
+OcclusionBaker::BakeAll(BrickMap &bm) {
+    return Bake(bm, ivec3(0), bm.GetDimensions() * BRICK_DIMENSIONS - 1);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+class BrickMap;
+
+// Bakes ambient occlusion into the attributes of a brick map on the CPU. Every exposed voxel casts rays over the
+// hemisphere around its normal with BrickMap::RayCast, and the fraction that hits something nearby is stored in
+// BrickAttributes::occlusion. Bricks are baked in parallel.
+class OcclusionBaker {
+public:
+    struct Settings {
+        // Cosine-weighted rays per voxel.
+        uint32 rayCount = 32;
+        // Hits further away in voxels do not occlude.
+        float maxDistance = 16.0f;
+        // Directions are jittered per voxel from this seed, the result does not depend on the thread count.
+        uint32 seed = 0;
+    };
+
+    struct Statistics {
+        uint32 brickCount = 0;
+        uint64 exposedVoxels = 0;
+        uint64 rayCount = 0;
+    };
+
+    explicit OcclusionBaker(const Settings &settings) : m_Settings(settings) {}
+
+    // Bakes the voxels in the inclusive region and returns the bricks that were written. Attributes are enabled if
+    // the brick map does not have them yet.
+    std::vector<uint32> Bake(BrickMap &bm, const ivec3 &min, const ivec3 &max);
+
+    // Bakes the voxels whose rays can reach an edited region, use after the edit and EstimateNormals.
+    std::vector<uint32> BakeAround(BrickMap &bm, const ivec3 &editMin, const ivec3 &editMax);
+
+    // Bakes the whole brick map.
+    std::vector<uint32> BakeAll(BrickMap &bm);
+
+    // Counters of the last bake.
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    Settings m_Settings;
+    Statistics m_Statistics;
+};
@@ -0,0 +1,241 @@
+#include "RadianceCache.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Math/Random.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <numbers>
+
+constexpr ivec3 faceDirections[] = {
+    {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+};
+
+RadianceCache::RadianceCache(const Settings &settings)
+    : m_Settings(settings), m_SunDirection(normalize(settings.sunDirection)) {
+    m_Settings.raysPerUpdate = std::max(m_Settings.raysPerUpdate, 1u);
+}
+
+bool
+RadianceCache::NeedsProbe(const BrickMap &bm, const ivec3 &cell) const {
+    const ivec3 &dimensions = bm.GetDimensions();
+    const auto isOccupied = [&](const ivec3 &position) {
+        return all(greaterThanEqual(position, ivec3(0))) && all(lessThan(position, dimensions)) &&
+               bm.GetGrid()[bm.GetCellIndex(position)] != EMPTY_BRICK;
+    };
+
+    if (isOccupied(cell))
+        return false;
+    for (const ivec3 &direction: faceDirections) {
+        if (isOccupied(cell + direction))
+            return true;
+    }
+    return false;
+}
+
+void
+RadianceCache::PlaceProbe(const BrickMap &bm, const ivec3 &cell) {
+    uint32 probeIndex;
+    if (m_FreeProbes.empty()) {
+        probeIndex = m_Probes.size();
+        m_Probes.emplace_back();
+    } else {
+        probeIndex = m_FreeProbes.back();
+        m_FreeProbes.pop_back();
+        m_Probes[probeIndex] = {};
+    }
+
+    const float cellSize = bm.GetVoxelSize() * BRICK_DIMENSIONS;
+    Probe &probe = m_Probes[probeIndex];
+    probe.position = bm.GetBoundingBox().min + (vec3(cell) + 0.5f) * cellSize;
+    probe.cellIndex = bm.GetCellIndex(cell);
+    m_ProbeCells[probe.cellIndex] = probeIndex;
+    m_Pending.push_back(probeIndex);
+}
+
+void
+RadianceCache::RemoveProbe(const uint32 cellIndex) {
+    const uint32 probeIndex = m_ProbeCells[cellIndex];
+    m_ProbeCells[cellIndex] = noProbe;
+    m_Probes[probeIndex] = {};
+    m_FreeProbes.push_back(probeIndex);
+}
+
+void
+RadianceCache::ResetProbe(const uint32 probeIndex) {
+    Probe &probe = m_Probes[probeIndex];
+    // Probes without samples are already waiting.
+    if (probe.sampleCount == 0)
+        return;
+
+    probe.sampleCount = 0;
+    std::fill(std::begin(probe.sums), std::end(probe.sums), vec3(0.0f));
+    m_Pending.push_back(probeIndex);
+}
+
+void
+RadianceCache::Build(const BrickMap &bm) {
+    PROFILE_SCOPE("RadianceCache::Build");
+    m_Probes.clear();
+    m_FreeProbes.clear();
+    m_Pending.clear();
+    m_NextProbe = 0;
+    m_ProbeCells.assign(bm.GetGrid().size(), noProbe);
+
+    const ivec3 &dimensions = bm.GetDimensions();
+    for (int z = 0; z < dimensions.z; ++z) {
+        for (int y = 0; y < dimensions.y; ++y) {
+            for (int x = 0; x < dimensions.x; ++x) {
+                if (NeedsProbe(bm, {x, y, z}))
+                    PlaceProbe(bm, {x, y, z});
+            }
+        }
+    }
+}
+
+std::vector<uint32>
+RadianceCache::Invalidate(const BrickMap &bm, const ivec3 &min, const ivec3 &max) {
+    PROFILE_SCOPE("RadianceCache::Invalidate");
+    const ivec3 &dimensions = bm.GetDimensions();
+    const ivec3 editMin = glm::max(min, ivec3(0)) / BRICK_DIMENSIONS;
+    const ivec3 editMax = glm::min(max, dimensions * BRICK_DIMENSIONS - 1) / BRICK_DIMENSIONS;
+    if (any(lessThan(editMax, editMin)))
+        return {};
+
+    std::vector<uint32> changed;
+
+    // Bricks appear and disappear in the edited cells, which changes the probes of the cells around them.
+    const ivec3 placeMin = glm::max(editMin - 1, ivec3(0));
+    const ivec3 placeMax = glm::min(editMax + 1, dimensions - 1);
+    for (int z = placeMin.z; z <= placeMax.z; ++z) {
+        for (int y = placeMin.y; y <= placeMax.y; ++y) {
+            for (int x = placeMin.x; x <= placeMax.x; ++x) {
+                const uint32 cellIndex = bm.GetCellIndex({x, y, z});
+                const bool hasProbe = m_ProbeCells[cellIndex] != noProbe;
+                if (NeedsProbe(bm, {x, y, z}) == hasProbe)
+                    continue;
+
+                if (hasProbe) {
+                    RemoveProbe(cellIndex);
+                } else {
+                    PlaceProbe(bm, {x, y, z});
+                    changed.push_back(m_ProbeCells[cellIndex]);
+                }
+            }
+        }
+    }
+
+    // Nearby probes see the edit directly, probes further away only through their bounces.
+    const int radius = static_cast<int>(m_Settings.invalidationRadius);
+    const ivec3 resetMin = glm::max(editMin - radius, ivec3(0));
+    const ivec3 resetMax = glm::min(editMax + radius, dimensions - 1);
+    for (int z = resetMin.z; z <= resetMax.z; ++z) {
+        for (int y = resetMin.y; y <= resetMax.y; ++y) {
+            for (int x = resetMin.x; x <= resetMax.x; ++x) {
+                const uint32 probeIndex = m_ProbeCells[bm.GetCellIndex({x, y, z})];
+                if (probeIndex == noProbe)
+                    continue;
+                ResetProbe(probeIndex);
+                changed.push_back(probeIndex);
+            }
+        }
+    }
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
+
+std::vector<uint32>
+RadianceCache::Update(BrickMap &bm, const uint32 rayBudget) {
+    PROFILE_SCOPE("RadianceCache::Update");
+    const uint32 probeBudget = rayBudget / m_Settings.raysPerUpdate;
+    std::vector<uint32> selected;
+
+    while (selected.size() < probeBudget && !m_Pending.empty()) {
+        const uint32 probeIndex = m_Pending.front();
+        m_Pending.pop_front();
+        if (m_Probes[probeIndex].cellIndex != noProbe)
+            selected.push_back(probeIndex);
+    }
+    // Then every probe in turn, each at most once per update.
+    for (uint32 visited = 0; selected.size() < probeBudget && visited < m_Probes.size(); ++visited) {
+        const uint32 probeIndex = m_NextProbe;
+        m_NextProbe = (m_NextProbe + 1) % m_Probes.size();
+        if (m_Probes[probeIndex].cellIndex != noProbe)
+            selected.push_back(probeIndex);
+    }
+    std::sort(selected.begin(), selected.end());
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+    parallel::For(selected.size(), [&](const uint32 i, uint32) {
+        Probe &probe = m_Probes[selected[i]];
+        for (uint32 ray = 0; ray < m_Settings.raysPerUpdate; ++ray) {
+            // Every sample of a probe has its own random stream, the result does not depend on the thread count.
+            math::random::SetSeed(math::random::FastRandom(
+                m_Settings.seed ^ probe.cellIndex * 2654435761u ^ probe.sampleCount * 40503u));
+
+            // Uniform over the sphere.
+            const float cosTheta = 1.0f - 2.0f * math::random::RandomFloat();
+            const float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+            const float phi = 2.0f * std::numbers::pi_v<float> * math::random::RandomFloat();
+            const vec3 direction(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+
+            // Irradiance of each face divided by the probability density of the direction.
+            const vec3 radiance = TraceRadiance(bm, probe.position, direction) * (4.0f * std::numbers::pi_v<float>);
+            for (uint32 face = 0; face < 6; ++face)
+                probe.sums[face] += radiance * std::max(dot(direction, vec3(faceDirections[face])), 0.0f);
+            probe.sampleCount++;
+        }
+    });
+
+    return selected;
+}
+
+vec3
+RadianceCache::TraceRadiance(BrickMap &bm, const vec3 &origin, const vec3 &direction) const {
+    const auto hit = bm.RayCast({origin, direction});
+    if (!hit)
+        return m_Settings.skyColor;
+
+    const float lambert = dot(vec3(hit->normal), m_SunDirection);
+    if (lambert <= 0.0f)
+        return vec3(0.0f);
+
+    // Just outside the face that was hit.
+    const vec3 faceCenter = vec3(hit->position) + 0.5f + vec3(hit->normal) * 0.51f;
+    if (bm.RayCast({bm.GetBoundingBox().min + faceCenter * bm.GetVoxelSize(), m_SunDirection}))
+        return vec3(0.0f);
+
+    const math::Color color = bm.GetVoxel(hit->position).value_or(math::Color());
+    const vec3 albedo = vec3(color.r, color.g, color.b) / 255.0f;
+    return albedo * m_Settings.sunColor * lambert;
+}
+
+vec3
+RadianceCache::GetIrradiance(const uint32 probeIndex, const vec3 &normal) const {
+    const ProbeIrradiance irradiance = GetProbeIrradiance(probeIndex);
+    const vec3 weights = normal * normal;
+    return vec3(irradiance.faces[normal.x >= 0.0f ? 0 : 1]) * weights.x +
+           vec3(irradiance.faces[normal.y >= 0.0f ? 2 : 3]) * weights.y +
+           vec3(irradiance.faces[normal.z >= 0.0f ? 4 : 5]) * weights.z;
+}
+
+RadianceCache::ProbeIrradiance
+RadianceCache::GetProbeIrradiance(const uint32 probeIndex) const {
+    const Probe &probe = m_Probes[probeIndex];
+    ProbeIrradiance irradiance{};
+    if (probe.sampleCount == 0)
+        return irradiance;
+
+    for (uint32 face = 0; face < 6; ++face)
+        irradiance.faces[face] = vec4(probe.sums[face] / static_cast<float>(probe.sampleCount), 1.0f);
+    return irradiance;
+}
+
+std::vector<RadianceCache::ProbeIrradiance>
+RadianceCache::GetProbeIrradiance() const {
+    std::vector<ProbeIrradiance> irradiance(m_Probes.size());
+    for (uint32 i = 0; i < m_Probes.size(); ++i)
+        irradiance[i] = GetProbeIrradiance(i);
+    return irradiance;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <deque>
+
+class BrickMap;
+
+// Sparse irradiance cache for indirect light. Probes sit at the centers of empty coarse cells that share a face with
+// an occupied brick. Every probe stores an ambient cube: the irradiance arriving at the six axis-aligned faces.
+// Update refines the probes progressively under a fixed ray budget. Each sample traces one bounce with
+// BrickMap::RayCast: sky on a miss, sunlit voxel color on a hit. Probes are refined in parallel.
+class RadianceCache {
+public:
+    static constexpr uint32 noProbe = UINT32_MAX;
+
+    struct Settings {
+        // Primary rays given to a probe at a time. Hits also cast a shadow ray towards the sun.
+        uint32 raysPerUpdate = 16;
+        // Points towards the sun, matches sun in rtBrickmap.comp.
+        vec3 sunDirection = {0.3f, 1.0f, 0.3f};
+        vec3 sunColor = vec3(1.0f);
+        vec3 skyColor = {0.3f, 0.4f, 0.6f};
+        // Probes within this many coarse cells of an edit are reset.
+        uint32 invalidationRadius = 2;
+        uint32 seed = 0;
+    };
+
+    struct Probe {
+        vec3 position{};
+        // Cell in the coarse grid, noProbe once the slot has been freed.
+        uint32 cellIndex = noProbe;
+        uint32 sampleCount = 0;
+        // Sums of the irradiance estimates of the +x, -x, +y, -y, +z and -z faces.
+        vec3 sums[6] = {};
+    };
+
+    // Layout of a probe on the GPU, the irradiance of the six faces in the same order as Probe::sums.
+    struct ProbeIrradiance {
+        vec4 faces[6];
+    };
+
+    explicit RadianceCache(const Settings &settings);
+
+    // Places the probes of the whole map and queues them for updates.
+    void Build(const BrickMap &bm);
+
+    // Refines probes with at most rayBudget primary rays, the probes invalidated longest ago first and then the rest in
+    // turn. Returns the probes that were refined.
+    std::vector<uint32> Update(BrickMap &bm, uint32 rayBudget);
+
+    // Places and removes probes around an edited inclusive voxel region and resets the probes near it. Returns the
+    // probes that were created or reset. Probe slots are reused, so the probe count only grows.
+    std::vector<uint32> Invalidate(const BrickMap &bm, const ivec3 &min, const ivec3 &max);
+
+    // Radiance arriving at a point from a direction, in world space.
+    vec3 TraceRadiance(BrickMap &bm, const vec3 &origin, const vec3 &direction) const;
+
+    // Irradiance of a probe for a surface normal, blended from the faces of the ambient cube.
+    vec3 GetIrradiance(uint32 probeIndex, const vec3 &normal) const;
+
+    ProbeIrradiance GetProbeIrradiance(uint32 probeIndex) const;
+
+    std::vector<ProbeIrradiance> GetProbeIrradiance() const;
+
+    const std::vector<Probe> &GetProbes() const { return m_Probes; }
+
+    // Probe index of every coarse cell in the grid layout of the brick map, noProbe for cells without one.
+    const std::vector<uint32> &GetProbeCells() const { return m_ProbeCells; }
+
+private:
+    bool NeedsProbe(const BrickMap &bm, const ivec3 &cell) const;
+
+    void PlaceProbe(const BrickMap &bm, const ivec3 &cell);
+
+    void RemoveProbe(uint32 cellIndex);
+
+    void ResetProbe(uint32 probeIndex);
+
+    Settings m_Settings;
+    vec3 m_SunDirection{};
+
+    std::vector<Probe> m_Probes;
+    std::vector<uint32> m_ProbeCells;
+    std::vector<uint32> m_FreeProbes;
+
+    // Probes waiting for their first update after being placed or reset.
+    std::deque<uint32> m_Pending;
+    uint32 m_NextProbe = 0;
+};
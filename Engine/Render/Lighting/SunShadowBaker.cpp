@@ -0,0 +1,169 @@
+#include "SunShadowBaker.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <atomic>
+
+SunShadowBaker::SunShadowBaker(const Settings &settings)
+    : m_Settings(settings) {
+    m_Settings.direction.y = std::max(m_Settings.direction.y, 1e-3f);
+    m_Settings.lineSpacing = std::clamp(m_Settings.lineSpacing, 0.05f, 0.5f);
+    m_Direction = normalize(m_Settings.direction);
+    m_Shear = vec2(m_Direction.x, m_Direction.z) / m_Direction.y;
+}
+
+vec2
+SunShadowBaker::Project(const vec3 &point) const {
+    return vec2(point.x, point.z) + (m_Top - point.y) * m_Shear;
+}
+
+void
+SunShadowBaker::Bake(BrickMap &bm) {
+    PROFILE_SCOPE("SunShadowBaker::Bake");
+    bm.EnableAttributes();
+    m_Statistics = {};
+
+    // The lattice covers the shadow of the whole map on its top plane.
+    const vec3 size = bm.GetDimensions() * BRICK_DIMENSIONS;
+    m_Top = size.y;
+    const vec2 bottomMin = Project({0.0f, 0.0f, 0.0f});
+    const vec2 bottomMax = Project({size.x, 0.0f, size.z});
+    m_LatticeMin = glm::min(bottomMin, vec2(0.0f));
+    const vec2 latticeMax = glm::max(bottomMax, vec2(size.x, size.z));
+    m_LatticeSize = ivec2(ceil((latticeMax - m_LatticeMin) / m_Settings.lineSpacing));
+
+    const uint32 brickCount = bm.GetBricks().size();
+    parallel::For(brickCount, [&](const uint32 i, uint32) {
+        BrickMap::BrickAttributes &attributes = bm.GetBrickAttributes(i);
+        std::fill(std::begin(attributes.sunMask), std::end(attributes.sunMask), 0);
+    });
+
+    Sweep(bm, ivec2(0), m_LatticeSize - 1);
+    m_Statistics.brickCount = brickCount;
+}
+
+std::vector<uint32>
+SunShadowBaker::Update(BrickMap &bm, const ivec3 &editMin, const ivec3 &editMax) {
+    PROFILE_SCOPE("SunShadowBaker::Update");
+    m_Statistics = {};
+    const ivec3 size = bm.GetDimensions() * BRICK_DIMENSIONS;
+    const ivec3 min = glm::max(editMin, ivec3(0));
+    const ivec3 max = glm::min(editMax, size - 1);
+    if (any(lessThan(max, min)))
+        return {};
+
+    // Shadow of the edit on the top plane. Voxels whose shadow overlaps it are further from the sun and may have been
+    // lit or shadowed through the edit.
+    vec2 editShadowMin(FLT_MAX), editShadowMax(-FLT_MAX);
+    for (uint32 corner = 0; corner < 8; ++corner) {
+        const vec3 point(corner & 1 ? max.x + 1 : min.x, corner & 2 ? max.y + 1 : min.y, corner & 4 ? max.z + 1 : min.z);
+        editShadowMin = glm::min(editShadowMin, Project(point));
+        editShadowMax = glm::max(editShadowMax, Project(point));
+    }
+
+    // A voxel's shadow spans its own width plus the shear of one voxel of height. The range of cleared voxels is
+    // rounded out by up to a voxel, so the lines cover one more.
+    const vec2 voxelShadow = vec2(2.0f) + abs(m_Shear);
+    std::vector<uint32> bricks;
+    for (int y = max.y; y >= 0; --y) {
+        // Horizontal offsets of the voxel's bottom and top on the top plane.
+        const vec2 bottomOffset = Project({0.0f, static_cast<float>(y), 0.0f});
+        const vec2 topOffset = Project({0.0f, static_cast<float>(y + 1), 0.0f});
+        const vec2 offsetMin = glm::min(bottomOffset, topOffset), offsetMax = glm::max(bottomOffset, topOffset);
+        const ivec2 voxelMin = glm::max(ivec2(floor(editShadowMin - 1.0f - offsetMax)), ivec2(0));
+        const ivec2 voxelMax = glm::min(ivec2(ceil(editShadowMax - offsetMin)), ivec2(size.x, size.z) - 1);
+
+        for (int z = voxelMin.y; z <= voxelMax.y; ++z) {
+            for (int x = voxelMin.x; x <= voxelMax.x; ++x) {
+                const ivec3 position(x, y, z);
+                const uint32 brickIndex = bm.GetGrid()[bm.GetCellIndex(position / BRICK_DIMENSIONS)];
+                if (brickIndex == EMPTY_BRICK)
+                    continue;
+
+                const uint32 voxelIndex = Flatten(position % BRICK_DIMENSIONS, ivec3(BRICK_DIMENSIONS));
+                uint32 &word = bm.GetBrickAttributes(brickIndex).sunMask[voxelIndex / 32];
+                word &= ~(1u << voxelIndex % 32);
+                if (bricks.empty() || bricks.back() != brickIndex)
+                    bricks.push_back(brickIndex);
+            }
+        }
+    }
+    std::sort(bricks.begin(), bricks.end());
+    bricks.erase(std::unique(bricks.begin(), bricks.end()), bricks.end());
+
+    // Every line that can enter a cleared voxel, lines that enter other voxels only set bits that are already set.
+    const ivec2 lineMin = ivec2(floor((editShadowMin - voxelShadow - m_LatticeMin) / m_Settings.lineSpacing));
+    const ivec2 lineMax = ivec2(ceil((editShadowMax + voxelShadow - m_LatticeMin) / m_Settings.lineSpacing));
+    Sweep(bm, glm::max(lineMin, ivec2(0)), glm::min(lineMax, m_LatticeSize - 1));
+    m_Statistics.brickCount = bricks.size();
+    return bricks;
+}
+
+void
+SunShadowBaker::Sweep(BrickMap &bm, const ivec2 &min, const ivec2 &max) {
+    if (any(lessThan(max, min)))
+        return;
+
+    const ivec3 size = bm.GetDimensions() * BRICK_DIMENSIONS;
+    const vec3 direction = -m_Direction;
+    const ivec3 step(sign(direction));
+    const vec3 tDelta = abs(1.0f / direction);
+    std::atomic<uint64> stepCount = 0;
+
+    parallel::For(max.y - min.y + 1, [&](const uint32 row, uint32) {
+        uint64 steps = 0;
+        for (int column = min.x; column <= max.x; ++column) {
+            const vec2 lattice = m_LatticeMin + (vec2(column, min.y + row) + 0.5f) * m_Settings.lineSpacing;
+            const vec3 start(lattice.x, m_Top, lattice.y);
+
+            // Clip the line to the map.
+            float tEnter = 0.0f, tExit = FLT_MAX;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (direction[axis] == 0.0f) {
+                    if (start[axis] < 0.0f || start[axis] >= static_cast<float>(size[axis]))
+                        tExit = -1.0f;
+                    continue;
+                }
+                float t0 = -start[axis] / direction[axis];
+                float t1 = (static_cast<float>(size[axis]) - start[axis]) / direction[axis];
+                if (t0 > t1)
+                    std::swap(t0, t1);
+                tEnter = std::max(tEnter, t0);
+                tExit = std::min(tExit, t1);
+            }
+            if (tEnter >= tExit)
+                continue;
+
+            const vec3 entry = start + direction * tEnter;
+            ivec3 voxel = clamp(ivec3(floor(entry)), ivec3(0), size - 1);
+            vec3 tMax;
+            for (int axis = 0; axis < 3; ++axis) {
+                const float boundary = static_cast<float>(voxel[axis] + (step[axis] > 0));
+                tMax[axis] = step[axis] == 0 ? FLT_MAX : (boundary - entry[axis]) / direction[axis];
+            }
+
+            while (all(greaterThanEqual(voxel, ivec3(0))) && all(lessThan(voxel, size))) {
+                steps++;
+                const uint32 brickIndex = bm.GetGrid()[bm.GetCellIndex(voxel / BRICK_DIMENSIONS)];
+                if (brickIndex != EMPTY_BRICK) {
+                    const uint32 voxelIndex = Flatten(voxel % BRICK_DIMENSIONS, ivec3(BRICK_DIMENSIONS));
+                    if (bm.GetBricks()[brickIndex].VoxelAt(voxelIndex)) {
+                        // Neighbouring lines can enter the same voxel from other threads.
+                        std::atomic_ref word(bm.GetBrickAttributes(brickIndex).sunMask[voxelIndex / 32]);
+                        word.fetch_or(1u << voxelIndex % 32, std::memory_order_relaxed);
+                        break;
+                    }
+                }
+
+                const int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+                voxel[axis] += step[axis];
+                tMax[axis] += tDelta[axis];
+            }
+        }
+        stepCount += steps;
+    });
+
+    m_Statistics.lineCount += static_cast<uint64>(max.x - min.x + 1) * (max.y - min.y + 1);
+    m_Statistics.stepCount += stepCount;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+class BrickMap;
+
+// Precomputes which voxels are reached by a directional sun into BrickAttributes::sunMask. Parallel lines are swept
+// from the top of the map against the light, and the first solid voxel every line enters is marked. Lines start on a
+// half voxel lattice in the top plane of the map, so every voxel that is not fully shadowed is entered by at least one
+// of them. Line rows are swept in parallel.
+class SunShadowBaker {
+public:
+    struct Settings {
+        // Points towards the sun, which has to be above the horizon. Matches sun in rtBrickmap.comp.
+        vec3 direction = {0.3f, 1.0f, 0.3f};
+        // Distance between lines in voxels, at most 0.5 to reach every lit voxel.
+        float lineSpacing = 0.5f;
+    };
+
+    struct Statistics {
+        uint64 lineCount = 0;
+        uint64 stepCount = 0;
+        uint32 brickCount = 0;
+    };
+
+    explicit SunShadowBaker(const Settings &settings);
+
+    // Sweeps the whole brick map. Attributes are enabled if the brick map does not have them yet.
+    void Bake(BrickMap &bm);
+
+    // Re-sweeps the lines that pass through an edited inclusive region and returns the bricks that were written. The
+    // map has to be baked first and keep its dimensions.
+    std::vector<uint32> Update(BrickMap &bm, const ivec3 &editMin, const ivec3 &editMax);
+
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    // Light space position of a point, the top plane of the map where it is crossed by the line through the point.
+    vec2 Project(const vec3 &point) const;
+
+    // Sweeps the lines in an inclusive range of lattice cells.
+    void Sweep(BrickMap &bm, const ivec2 &min, const ivec2 &max);
+
+    Settings m_Settings;
+    Statistics m_Statistics;
+    vec3 m_Direction{};
+    // Horizontal shift of a line per voxel it rises.
+    vec2 m_Shear{};
+    float m_Top = 0.0f;
+    vec2 m_LatticeMin{};
+    ivec2 m_LatticeSize{};
+};
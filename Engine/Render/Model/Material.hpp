@@ -5,4 +5,6 @@
 struct Material {
     vec3 baseColor = {};
     std::shared_ptr<Texture> texture;
+    // Pixels of the texture, also loaded when uploads are disabled.
+    std::shared_ptr<Image> image;
 };
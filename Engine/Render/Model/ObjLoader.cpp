@@ -4,13 +4,102 @@
 #include "assimp/postprocess.h"
 
 #include "Material.hpp"
+#include "Utility/MappedFile.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
 
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
 
-Mesh
-ObjLoader::ProcessMesh(const aiMesh *mesh, const aiScene *scene) {
+// Bump when the layout of the cache or the processing of meshes changes.
+constexpr char cacheMagic[4] = {'V', 'X', 'M', 'C'};
+constexpr uint32 cacheVersion = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32 version;
+    uint64 sourceHash;
+    uint32 meshCount;
+    uint32 padding;
+};
+
+struct CacheMeshHeader {
+    uint32 vertexCount;
+    uint32 indexCount;
+    uint32 texturePathLength;
+    vec3 baseColor;
+};
+
+// 64 bit FNV-1a, hash continues an earlier hash.
+static uint64
+HashBytes(const uint8 *data, const size_t size, uint64 hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64
+HashString(const std::string &text, const uint64 hash) {
+    // The terminator separates consecutive strings.
+    return HashBytes(reinterpret_cast<const uint8 *>(text.c_str()), text.size() + 1, hash);
+}
+
+// Hash of everything on disk the cache is built from: the model, the material libraries it references, which give the
+// base colors and texture paths, and the directory the texture paths are resolved against.
+static uint64
+HashModel(const MappedFile &source, const std::string &directory) {
+    std::error_code error;
+    uint64 hash = HashBytes(source.GetData(), source.GetSize());
+    hash = HashString(std::filesystem::weakly_canonical(directory, error).string(), hash);
+
+    const auto isSpace = [](const char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    const std::string_view contents(reinterpret_cast<const char *>(source.GetData()), source.GetSize());
+    for (size_t lineStart = 0; lineStart < contents.size();) {
+        const size_t lineEnd = std::min(contents.find('\n', lineStart), contents.size());
+        std::string_view line = contents.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        constexpr std::string_view keyword = "mtllib";
+        if (!line.starts_with(keyword) || line.size() == keyword.size() || !isSpace(line[keyword.size()]))
+            continue;
+        line.remove_prefix(keyword.size());
+        while (!line.empty() && isSpace(line.front()))
+            line.remove_prefix(1);
+        while (!line.empty() && isSpace(line.back()))
+            line.remove_suffix(1);
+
+        // A missing library still changes the key, so the cache is rebuilt once it appears.
+        const std::string name(line);
+        hash = HashString(name, hash);
+        const MappedFile library(directory + name);
+        if (library.IsOpen())
+            hash = HashBytes(library.GetData(), library.GetSize(), hash);
+    }
+    return hash;
+}
+
+// Copies count values of T from the cursor, fails if the file is too short.
+template<typename T>
+static bool
+ReadValues(const uint8 *&cursor, const uint8 *end, T *values, const size_t count) {
+    const size_t byteSize = count * sizeof(T);
+    if (static_cast<size_t>(end - cursor) < byteSize)
+        return false;
+    std::memcpy(values, cursor, byteSize);
+    cursor += byteSize;
+    return true;
+}
+
+ObjLoader::MeshData
+ObjLoader::ProcessMesh(const aiMesh *mesh, const aiScene *scene) const {
     std::vector<Vertex> vertices(mesh->mNumVertices);
     std::vector<uint32> indices;
-    indices.reserve(mesh->mNumFaces * mesh->mFaces[0].mNumIndices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
         const vec2 uv = mesh->mTextureCoords[0]
@@ -31,71 +120,194 @@ ObjLoader::ProcessMesh(const aiMesh *mesh, const aiScene *scene) {
         }
     }
 
-    for (size_t i = 0; i < indices.size(); i += 3) {
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
         Vertex &a = vertices[indices[i]];
         Vertex &b = vertices[indices[i + 1]];
         Vertex &c = vertices[indices[i + 2]];
-        const vec3 edge0 = b.position - a.position;
-        const vec3 edge1 = c.position - a.position;
-        a.normal = normalize(cross(edge0, edge1));
-        b.normal = normalize(cross(edge0, edge1));
-        c.normal = normalize(cross(edge0, edge1));
+        const vec3 normal = normalize(cross(b.position - a.position, c.position - a.position));
+        a.normal = normal;
+        b.normal = normal;
+        c.normal = normal;
     }
 
-    Material material;
+    MeshData data;
+    data.mesh.vertices = std::move(vertices);
+    data.mesh.indices = std::move(indices);
 
-    aiMaterial *mat = scene->mMaterials[mesh->mMaterialIndex];
+    const aiMaterial *mat = scene->mMaterials[mesh->mMaterialIndex];
 
     aiColor3D color;
     mat->Get(AI_MATKEY_COLOR_DIFFUSE, color);
-    material.baseColor = *(vec3 *) &color;
+    data.mesh.material.baseColor = *(vec3 *) &color;
 
     aiString path;
     mat->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-    if (path.length > 0) {
-        const std::string fullPath = m_Directory + path.C_Str();
-        material.texture = TextureManager::Get().Load(fullPath);
-    }
+    data.texturePath = path.C_Str();
 
-    return {
-        vertices,
-        indices,
-        material
-    };
+    return data;
 }
 
 void
-ObjLoader::ProcessNode(Model &model, const aiNode *node, const aiScene *scene) {
-    model.meshes.reserve(node->mNumMeshes);
+ObjLoader::CollectMeshes(const aiNode *node, const aiScene *scene, std::vector<const aiMesh *> &meshes) const {
     for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-        const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        model.meshes.push_back(ProcessMesh(mesh, scene));
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
     for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        ProcessNode(model, node->mChildren[i], scene);
+        CollectMeshes(node->mChildren[i], scene, meshes);
     }
 }
 
+bool
+ObjLoader::ReadCache(const std::string &cachePath, const uint64 sourceHash, std::vector<MeshData> &meshes) const {
+    const MappedFile file(cachePath);
+    if (!file.IsOpen())
+        return false;
+
+    const uint8 *cursor = file.GetData();
+    const uint8 *end = cursor + file.GetSize();
+
+    CacheHeader header{};
+    if (!ReadValues(cursor, end, &header, 1) ||
+        std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        header.version != cacheVersion ||
+        header.sourceHash != sourceHash) {
+        return false;
+    }
+
+    meshes.resize(header.meshCount);
+    for (MeshData &data: meshes) {
+        CacheMeshHeader meshHeader{};
+        if (!ReadValues(cursor, end, &meshHeader, 1))
+            return false;
+
+        data.mesh.vertices.resize(meshHeader.vertexCount);
+        data.mesh.indices.resize(meshHeader.indexCount);
+        data.texturePath.resize(meshHeader.texturePathLength);
+        data.mesh.material.baseColor = meshHeader.baseColor;
+
+        if (!ReadValues(cursor, end, data.mesh.vertices.data(), meshHeader.vertexCount) ||
+            !ReadValues(cursor, end, data.mesh.indices.data(), meshHeader.indexCount) ||
+            !ReadValues(cursor, end, data.texturePath.data(), meshHeader.texturePathLength)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+ObjLoader::WriteCache(const std::string &cachePath, const uint64 sourceHash,
+                      const std::vector<MeshData> &meshes) const {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+    // Written to a temporary file first so an interrupted write never leaves a truncated cache behind.
+    const std::string temporaryPath = cachePath + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to write mesh cache \"" << cachePath << "\"\n";
+        return;
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.sourceHash = sourceHash;
+    header.meshCount = meshes.size();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const MeshData &data: meshes) {
+        const CacheMeshHeader meshHeader = {
+            static_cast<uint32>(data.mesh.vertices.size()),
+            static_cast<uint32>(data.mesh.indices.size()),
+            static_cast<uint32>(data.texturePath.size()),
+            data.mesh.material.baseColor
+        };
+        file.write(reinterpret_cast<const char *>(&meshHeader), sizeof(meshHeader));
+        file.write(reinterpret_cast<const char *>(data.mesh.vertices.data()),
+                   data.mesh.vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char *>(data.mesh.indices.data()),
+                   data.mesh.indices.size() * sizeof(uint32));
+        file.write(data.texturePath.data(), data.texturePath.size());
+    }
+    file.close();
+
+    if (!file) {
+        std::cerr << "Failed to write mesh cache \"" << cachePath << "\"\n";
+        std::filesystem::remove(temporaryPath, error);
+        return;
+    }
+    std::filesystem::rename(temporaryPath, cachePath, error);
+}
+
 const Model &
 ObjLoader::Load(const std::string &path, const bool reload) {
+    PROFILE_SCOPE("ObjLoader::Load");
     if (m_LoadedModels.contains(path) && !reload) {
         return m_LoadedModels[path];
     }
 
-    Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs);
-
     m_LoadedModels[path] = {};
+    Model &model = m_LoadedModels[path];
+    m_Directory = path.substr(0, path.find_last_of('/')) + "/";
 
-    if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cerr << "Error loading model \"" << path << "\"\n" << importer.GetErrorString() << std::endl;
+    std::string cachePath;
+    uint64 sourceHash = 0;
+    if (!m_CacheDirectory.empty()) {
+        const MappedFile source(path);
+        if (source.IsOpen()) {
+            sourceHash = HashModel(source, m_Directory);
+            std::ostringstream name;
+            name << std::hex << std::setw(16) << std::setfill('0') << sourceHash;
+            cachePath = m_CacheDirectory + "/" + name.str() + ".mesh";
+        }
+    }
+
+    std::vector<MeshData> meshes;
+    if (!reload && !cachePath.empty() && ReadCache(cachePath, sourceHash, meshes)) {
+        std::cout << "Loaded model \"" << path << "\" from cache\n";
     } else {
-        m_Directory = path.substr(0, path.find_last_of('/')) + "/";
-        ProcessNode(m_LoadedModels[path], scene->mRootNode, scene);
+        meshes.clear();
+
+        Assimp::Importer importer;
+        const aiScene *scene = importer.ReadFile(path.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs);
+
+        if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cerr << "Error loading model \"" << path << "\"\n" << importer.GetErrorString() << std::endl;
+            return model;
+        }
+
+        std::vector<const aiMesh *> sceneMeshes;
+        CollectMeshes(scene->mRootNode, scene, sceneMeshes);
+        meshes.resize(sceneMeshes.size());
+        parallel::For(sceneMeshes.size(), [&](const uint32 i, uint32) {
+            meshes[i] = ProcessMesh(sceneMeshes[i], scene);
+        });
+
+        if (!cachePath.empty())
+            WriteCache(cachePath, sourceHash, meshes);
         std::cout << "Loaded model \"" << path << "\"\n";
     }
 
-    return m_LoadedModels[path];
+    // Textures are decoded on the workers and uploaded here, since they create GL objects.
+    std::vector<std::string> texturePaths;
+    for (const MeshData &data: meshes) {
+        if (!data.texturePath.empty())
+            texturePaths.push_back(m_Directory + data.texturePath);
+    }
+    TextureManager::Get().Preload(texturePaths);
+
+    model.meshes.reserve(meshes.size());
+    for (MeshData &data: meshes) {
+        if (!data.texturePath.empty()) {
+            const std::string texturePath = m_Directory + data.texturePath;
+            data.mesh.material.texture = TextureManager::Get().Load(texturePath);
+            data.mesh.material.image = TextureManager::Get().LoadImage(texturePath);
+        }
+        model.meshes.push_back(std::move(data.mesh));
+    }
+
+    return model;
 }
 
 void
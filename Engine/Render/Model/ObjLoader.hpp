@@ -10,15 +10,31 @@ class ObjLoader {
     SINGLETON(ObjLoader);
 
 public:
+    // Meshes are read from the mesh cache when the file has not changed since it was cached, reload skips the cache.
     const Model &Load(const std::string &path, bool reload = false);
 
     void Remove(const std::string &name);
 
+    // Directory of the mesh cache, files are named by the hash of the model file, its material libraries and its
+    // directory. An empty path disables the cache.
+    void SetCacheDirectory(const std::string &directory) { m_CacheDirectory = directory; }
+
 private:
-    void ProcessNode(Model &model, const aiNode *node, const aiScene *scene);
+    // A mesh before its texture is loaded, the texture path is relative to the model.
+    struct MeshData {
+        Mesh mesh;
+        std::string texturePath;
+    };
+
+    void CollectMeshes(const aiNode *node, const aiScene *scene, std::vector<const aiMesh *> &meshes) const;
+
+    MeshData ProcessMesh(const aiMesh *mesh, const aiScene *scene) const;
+
+    bool ReadCache(const std::string &cachePath, uint64 sourceHash, std::vector<MeshData> &meshes) const;
 
-    Mesh ProcessMesh(const aiMesh *mesh, const aiScene *scene);
+    void WriteCache(const std::string &cachePath, uint64 sourceHash, const std::vector<MeshData> &meshes) const;
 
     std::string m_Directory;
+    std::string m_CacheDirectory = "cache";
     std::unordered_map<std::string, Model> m_LoadedModels;
 };
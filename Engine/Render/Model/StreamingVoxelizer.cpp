@@ -0,0 +1,252 @@
+#include "StreamingVoxelizer.hpp"
+#include "Voxelizer.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "DataStructures/BrickMapFile.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <bit>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+
+// Rough memory cost of a triangle in a bucket, the octree copies it into every node it overlaps on the way down.
+constexpr size_t bytesPerTriangle = sizeof(Triangle) * 8;
+// Rough memory cost per squared voxel of a bucket's side, for the octree nodes and bricks along a surface through it.
+constexpr size_t bytesPerArea = 800;
+
+size_t
+StreamingVoxelizer::EstimateBucketBytes(const uint64 triangleCount, const uint32 size) const {
+    return triangleCount * bytesPerTriangle + static_cast<size_t>(size) * size * bytesPerArea;
+}
+
+math::BoundingBox
+StreamingVoxelizer::GetBucketBounds(const ivec3 &origin, const uint32 size) const {
+    const vec3 min = m_Bounds.min + vec3(origin) * m_CellSize;
+    return {min, min + vec3(static_cast<float>(size) * m_CellSize)};
+}
+
+std::vector<StreamingVoxelizer::Bucket>
+StreamingVoxelizer::Bin(const std::function<uint32(StreamTriangle *, uint32)> &read, const ivec3 &regionOrigin,
+                        const uint32 regionSize, const uint32 bucketSize) {
+    PROFILE_SCOPE("StreamingVoxelizer::Bin");
+    const ivec3 bucketsPerSide(regionSize / bucketSize);
+    std::unordered_map<uint32, Bucket> buckets;
+    std::unordered_map<uint32, std::vector<StreamTriangle> > buffers;
+    size_t bufferedCount = 0;
+    const size_t maxBufferedCount = std::max<size_t>(m_Settings.memoryBudget / 4 / sizeof(StreamTriangle), m_ChunkSize);
+
+    const auto flush = [&] {
+        for (auto &[index, buffer]: buffers) {
+            Bucket &bucket = buckets[index];
+            std::ofstream file(bucket.path, std::ios::binary | std::ios::app);
+            file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(StreamTriangle));
+            bucket.triangleCount += buffer.size();
+        }
+        buffers.clear();
+        bufferedCount = 0;
+    };
+
+    std::vector<StreamTriangle> chunk(m_ChunkSize);
+    for (uint32 count = read(chunk.data(), m_ChunkSize); count > 0; count = read(chunk.data(), m_ChunkSize)) {
+        for (uint32 i = 0; i < count; ++i) {
+            const StreamTriangle &streamTriangle = chunk[i];
+            const Triangle triangle(streamTriangle.a, streamTriangle.b, streamTriangle.c, nullptr);
+
+            // Buckets overlapped by the bounds of the triangle, clamped to the region.
+            const vec3 min = glm::min(glm::min(triangle.a.position, triangle.b.position), triangle.c.position);
+            const vec3 max = glm::max(glm::max(triangle.a.position, triangle.b.position), triangle.c.position);
+            const auto toBucket = [&](const vec3 &point) {
+                const ivec3 voxel = ivec3(floor((point - m_Bounds.min) / m_CellSize)) - regionOrigin;
+                return clamp(voxel, ivec3(0), ivec3(regionSize - 1)) / static_cast<int>(bucketSize);
+            };
+            const ivec3 first = toBucket(min);
+            const ivec3 last = toBucket(max);
+
+            for (int z = first.z; z <= last.z; ++z) {
+                for (int y = first.y; y <= last.y; ++y) {
+                    for (int x = first.x; x <= last.x; ++x) {
+                        const ivec3 bucketOrigin = regionOrigin + ivec3(x, y, z) * static_cast<int>(bucketSize);
+                        if (first != last && !Intersect(GetBucketBounds(bucketOrigin, bucketSize), triangle))
+                            continue;
+
+                        const uint32 index = Flatten({x, y, z}, bucketsPerSide);
+                        if (!buckets.contains(index)) {
+                            const std::string path = m_Settings.workDirectory + "/bucket" +
+                                                     std::to_string(m_NextBucketId++) + ".triangles";
+                            buckets[index] = {path, bucketOrigin, bucketSize, 0};
+                        }
+                        buffers[index].push_back(streamTriangle);
+                        bufferedCount++;
+                    }
+                }
+            }
+        }
+
+        if (bufferedCount >= maxBufferedCount)
+            flush();
+    }
+    flush();
+
+    // Grid order, so the output does not depend on the order triangles were read in.
+    std::vector<std::pair<uint32, Bucket> > sorted(buckets.begin(), buckets.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    std::vector<Bucket> result;
+    result.reserve(sorted.size());
+    for (auto &[index, bucket]: sorted) {
+        result.push_back(std::move(bucket));
+    }
+    return result;
+}
+
+BrickMap
+StreamingVoxelizer::VoxelizeBucket(const Bucket &bucket, const std::vector<Material> &materials) const {
+    PROFILE_SCOPE("StreamingVoxelizer::VoxelizeBucket");
+    std::vector<Triangle> triangles;
+    {
+        std::vector<StreamTriangle> streamTriangles(bucket.triangleCount);
+        std::ifstream file(bucket.path, std::ios::binary);
+        file.read(reinterpret_cast<char *>(streamTriangles.data()), streamTriangles.size() * sizeof(StreamTriangle));
+
+        triangles.reserve(streamTriangles.size());
+        for (const StreamTriangle &triangle: streamTriangles) {
+            triangles.emplace_back(triangle.a, triangle.b, triangle.c, &materials[triangle.material]);
+        }
+    }
+
+    OctreeMesh octree(std::move(triangles), GetBucketBounds(bucket.origin, bucket.size),
+                      std::countr_zero(bucket.size));
+    BrickMap bm(ivec3(bucket.size), m_Settings.voxelSize);
+    octree.Fill(bm);
+    return bm;
+}
+
+bool
+StreamingVoxelizer::Voxelize(TriangleStream &stream, const std::string &outputPath) {
+    PROFILE_SCOPE("StreamingVoxelizer::Voxelize");
+    m_Statistics = {};
+    const uint32 size = 1u << m_Settings.subdivisions;
+    const uint32 threadCount = parallel::GetThreadCount();
+    m_WorkerBudget = m_Settings.memoryBudget / threadCount;
+    m_ChunkSize = std::clamp<size_t>(m_Settings.memoryBudget / 8 / sizeof(StreamTriangle), 1024, 1 << 20);
+
+    // Bounds of the model, made cubic the same way as in OctreeMesh.
+    std::vector<StreamTriangle> chunk(m_ChunkSize);
+    vec3 min(FLT_MAX), max(-FLT_MAX);
+    stream.Rewind();
+    for (uint32 count = stream.Read(chunk.data(), m_ChunkSize); count > 0;
+         count = stream.Read(chunk.data(), m_ChunkSize)) {
+        for (uint32 i = 0; i < count; ++i) {
+            for (const Vertex *vertex: {&chunk[i].a, &chunk[i].b, &chunk[i].c}) {
+                min = glm::min(min, vertex->position);
+                max = glm::max(max, vertex->position);
+            }
+        }
+        m_Statistics.triangleCount += count;
+    }
+    chunk = {};
+
+    if (m_Statistics.triangleCount == 0) {
+        std::cerr << "Nothing to voxelize\n";
+        return false;
+    }
+
+    m_Bounds = {min, max};
+    const vec3 extent = m_Bounds.GetSize();
+    m_Bounds.SetSize(vec3(std::max(std::max(extent.x, extent.y), extent.z)));
+    m_CellSize = m_Bounds.GetSize().x / static_cast<float>(size);
+
+    // Largest bucket that fits the budget if the triangles are spread evenly over a surface, buckets that turn out
+    // denser are split further when they are voxelized.
+    uint32 bucketSize = size;
+    while (bucketSize > BRICK_DIMENSIONS) {
+        const uint64 bucketsPerSide = size / bucketSize;
+        const uint64 trianglesPerBucket = m_Statistics.triangleCount / (bucketsPerSide * bucketsPerSide);
+        if (EstimateBucketBytes(trianglesPerBucket, bucketSize) <= m_WorkerBudget)
+            break;
+        bucketSize /= 2;
+    }
+
+    // Mip chains are built once up front instead of by every bucket.
+    const std::vector<Material> &materials = stream.GetMaterials();
+    std::vector<Image *> images;
+    for (const Material &material: materials) {
+        if (material.image && std::find(images.begin(), images.end(), material.image.get()) == images.end())
+            images.push_back(material.image.get());
+    }
+    parallel::For(images.size(), [&](const uint32 i, uint32) {
+        images[i]->BuildMips();
+    });
+
+    std::error_code error;
+    std::filesystem::create_directories(m_Settings.workDirectory, error);
+
+    stream.Rewind();
+    std::vector<Bucket> topBuckets = Bin([&stream](StreamTriangle *triangles, const uint32 maxCount) {
+        return stream.Read(triangles, maxCount);
+    }, ivec3(0), size, bucketSize);
+    std::deque<Bucket> queue(std::make_move_iterator(topBuckets.begin()), std::make_move_iterator(topBuckets.end()));
+
+    // Progress is measured in voxelized volume, space that splitting finds empty counts as done.
+    const auto volume = [](const uint32 bucketSize) {
+        return static_cast<double>(bucketSize) * bucketSize * bucketSize;
+    };
+    const double totalVolume = volume(bucketSize) * static_cast<double>(queue.size());
+    double finishedVolume = 0.0;
+
+    BrickMapWriter writer(outputPath, vec3(0.0f), ivec3(size / BRICK_DIMENSIONS), m_Settings.voxelSize);
+    if (!writer.IsOpen())
+        return false;
+
+    // Buckets are voxelized a batch per thread at a time and written in queue order.
+    std::vector<Bucket> batch;
+    while (!queue.empty() || !batch.empty()) {
+        if (!queue.empty() && batch.size() < threadCount) {
+            Bucket bucket = std::move(queue.front());
+            queue.pop_front();
+
+            if (bucket.size > BRICK_DIMENSIONS &&
+                EstimateBucketBytes(bucket.triangleCount, bucket.size) > m_WorkerBudget) {
+                std::ifstream file(bucket.path, std::ios::binary);
+                std::vector<Bucket> children = Bin([&file](StreamTriangle *triangles, const uint32 maxCount) {
+                    file.read(reinterpret_cast<char *>(triangles), maxCount * sizeof(StreamTriangle));
+                    return static_cast<uint32>(file.gcount() / sizeof(StreamTriangle));
+                }, bucket.origin, bucket.size, bucket.size / 2);
+                file.close();
+                std::filesystem::remove(bucket.path, error);
+
+                finishedVolume += volume(bucket.size) - volume(bucket.size / 2) * static_cast<double>(children.size());
+
+                queue.insert(queue.begin(), std::make_move_iterator(children.begin()),
+                             std::make_move_iterator(children.end()));
+                continue;
+            }
+
+            batch.push_back(std::move(bucket));
+            continue;
+        }
+
+        std::vector<BrickMap> results(batch.size());
+        parallel::For(batch.size(), [&](const uint32 i, uint32) {
+            results[i] = VoxelizeBucket(batch[i], materials);
+        });
+
+        for (uint32 i = 0; i < batch.size(); ++i) {
+            writer.Write(results[i], batch[i].origin / BRICK_DIMENSIONS);
+            m_Statistics.voxelCount += results[i].GetVoxelCount();
+            m_Statistics.bucketCount++;
+            std::filesystem::remove(batch[i].path, error);
+            finishedVolume += volume(batch[i].size);
+        }
+        batch.clear();
+
+        if (m_Settings.onProgress)
+            m_Settings.onProgress(static_cast<float>(finishedVolume / totalVolume));
+    }
+
+    m_Statistics.brickCount = writer.GetBrickCount();
+    return writer.Close();
+}
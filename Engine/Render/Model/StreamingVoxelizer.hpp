@@ -0,0 +1,67 @@
+#pragma once
+
+#include "TriangleStream.hpp"
+#include "Math/BoundingBox.hpp"
+
+#include <functional>
+
+class BrickMap;
+
+// Voxelizes triangle streams of any size in bounded memory. Triangles are binned into cubic buckets on disk, then
+// every bucket is voxelized on its own and its bricks are appended to a brick map file.
+class StreamingVoxelizer {
+public:
+    struct Settings {
+        // The voxelized model is 2^subdivisions voxels on each side.
+        uint32 subdivisions = 8;
+        float voxelSize = 0.1f;
+        // Approximate limit in bytes for triangles, octrees and bricks held in memory at once.
+        size_t memoryBudget = static_cast<size_t>(1) << 30;
+        // Bucket files are written here and removed once voxelized.
+        std::string workDirectory = "voxelize";
+        // Called with the finished fraction in [0, 1] after every batch of buckets.
+        std::function<void(float)> onProgress;
+    };
+
+    struct Statistics {
+        uint64 triangleCount = 0;
+        uint32 bucketCount = 0;
+        uint32 brickCount = 0;
+        uint64 voxelCount = 0;
+    };
+
+    explicit StreamingVoxelizer(const Settings &settings) : m_Settings(settings) {}
+
+    // Returns false if the output could not be written.
+    bool Voxelize(TriangleStream &stream, const std::string &outputPath);
+
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    struct Bucket {
+        std::string path;
+        // First voxel and side length in voxels.
+        ivec3 origin;
+        uint32 size = 0;
+        uint64 triangleCount = 0;
+    };
+
+    math::BoundingBox GetBucketBounds(const ivec3 &origin, uint32 size) const;
+
+    // Distributes triangles into buckets of the given size inside a region, flushing to disk when the buffers fill up.
+    std::vector<Bucket> Bin(const std::function<uint32(StreamTriangle *, uint32)> &read, const ivec3 &regionOrigin,
+                            uint32 regionSize, uint32 bucketSize);
+
+    BrickMap VoxelizeBucket(const Bucket &bucket, const std::vector<Material> &materials) const;
+
+    size_t EstimateBucketBytes(uint64 triangleCount, uint32 size) const;
+
+    Settings m_Settings;
+    Statistics m_Statistics;
+    math::BoundingBox m_Bounds;
+    // World size of a voxel in the model's space.
+    float m_CellSize = 0.0f;
+    uint32 m_ChunkSize = 0;
+    size_t m_WorkerBudget = 0;
+    uint32 m_NextBucketId = 0;
+};
@@ -0,0 +1,266 @@
+#include "TriangleStream.hpp"
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+
+ModelTriangleStream::ModelTriangleStream(const Model &model)
+    : m_Model(model) {
+    m_Materials.reserve(model.meshes.size());
+    for (const Mesh &mesh: model.meshes) {
+        m_Materials.push_back(mesh.material);
+    }
+}
+
+void
+ModelTriangleStream::Rewind() {
+    m_MeshIndex = 0;
+    m_IndexOffset = 0;
+}
+
+uint32
+ModelTriangleStream::Read(StreamTriangle *triangles, const uint32 maxCount) {
+    uint32 count = 0;
+    while (count < maxCount && m_MeshIndex < m_Model.meshes.size()) {
+        const Mesh &mesh = m_Model.meshes[m_MeshIndex];
+        if (m_IndexOffset + 3 > mesh.indices.size()) {
+            m_MeshIndex++;
+            m_IndexOffset = 0;
+            continue;
+        }
+
+        triangles[count++] = {
+            mesh.vertices[mesh.indices[m_IndexOffset]],
+            mesh.vertices[mesh.indices[m_IndexOffset + 1]],
+            mesh.vertices[mesh.indices[m_IndexOffset + 2]],
+            m_MeshIndex
+        };
+        m_IndexOffset += 3;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------------------
+
+// Line based tokenizer over a mapped text file.
+struct TextCursor {
+    const char *position;
+    const char *end;
+
+    bool AtEnd() const { return position >= end; }
+
+    void SkipSpaces() {
+        while (position < end && (*position == ' ' || *position == '\t' || *position == '\r'))
+            ++position;
+    }
+
+    void SkipLine() {
+        while (position < end && *position != '\n')
+            ++position;
+        if (position < end)
+            ++position;
+    }
+
+    std::string_view Token() {
+        SkipSpaces();
+        const char *start = position;
+        while (position < end && !std::isspace(static_cast<unsigned char>(*position)))
+            ++position;
+        return {start, static_cast<size_t>(position - start)};
+    }
+
+    // Rest of the line without surrounding spaces.
+    std::string_view Rest() {
+        SkipSpaces();
+        const char *start = position;
+        while (position < end && *position != '\n')
+            ++position;
+        const char *last = position;
+        while (last > start && std::isspace(static_cast<unsigned char>(last[-1])))
+            --last;
+        return {start, static_cast<size_t>(last - start)};
+    }
+
+    float Float() {
+        SkipSpaces();
+        float value = 0.0f;
+        position = std::from_chars(position, end, value).ptr;
+        return value;
+    }
+
+    int32 Int() {
+        int32 value = 0;
+        position = std::from_chars(position, end, value).ptr;
+        return value;
+    }
+};
+
+// Resolves a 1 based or negative relative OBJ index to 0 based, -1 if missing.
+static int32
+ResolveIndex(const int32 index, const int32 count) {
+    if (index > 0)
+        return index - 1;
+    if (index < 0)
+        return count + index;
+    return -1;
+}
+
+ObjTriangleStream::ObjTriangleStream(const std::string &path, const std::string &workDirectory)
+    : m_File(path) {
+    if (!m_File.IsOpen()) {
+        std::cerr << "Failed to open model \"" << path << "\"\n";
+        return;
+    }
+
+    m_Directory = path.substr(0, path.find_last_of('/')) + "/";
+    std::error_code error;
+    std::filesystem::create_directories(workDirectory, error);
+    const std::string name = std::filesystem::path(path).stem().string();
+    m_PositionsPath = workDirectory + "/" + name + ".positions";
+    m_UvsPath = workDirectory + "/" + name + ".uvs";
+
+    // Default material for faces before the first usemtl.
+    m_Materials.push_back({vec3(1.0f)});
+
+    // Spill positions and texture coordinates and count the triangles.
+    std::ofstream positions(m_PositionsPath, std::ios::binary);
+    std::ofstream uvs(m_UvsPath, std::ios::binary);
+    TextCursor cursor = {reinterpret_cast<const char *>(m_File.GetData()),
+                         reinterpret_cast<const char *>(m_File.GetData()) + m_File.GetSize()};
+    while (!cursor.AtEnd()) {
+        const std::string_view keyword = cursor.Token();
+        if (keyword == "v") {
+            const vec3 position(cursor.Float(), cursor.Float(), cursor.Float());
+            positions.write(reinterpret_cast<const char *>(&position), sizeof(position));
+        } else if (keyword == "vt") {
+            const float u = cursor.Float();
+            // Flipped like the assimp import.
+            const vec2 uv(u, 1.0f - cursor.Float());
+            uvs.write(reinterpret_cast<const char *>(&uv), sizeof(uv));
+        } else if (keyword == "f") {
+            uint32 vertexCount = 0;
+            while (!cursor.Token().empty())
+                ++vertexCount;
+            if (vertexCount >= 3)
+                m_TriangleCount += vertexCount - 2;
+            continue;
+        } else if (keyword == "mtllib") {
+            ReadMaterialLibrary(m_Directory + std::string(cursor.Rest()));
+        }
+        cursor.SkipLine();
+    }
+    positions.close();
+    uvs.close();
+
+    m_Positions = MappedFile(m_PositionsPath);
+    m_Uvs = MappedFile(m_UvsPath);
+}
+
+ObjTriangleStream::~ObjTriangleStream() {
+    m_Positions = MappedFile();
+    m_Uvs = MappedFile();
+    std::error_code error;
+    if (!m_PositionsPath.empty())
+        std::filesystem::remove(m_PositionsPath, error);
+    if (!m_UvsPath.empty())
+        std::filesystem::remove(m_UvsPath, error);
+}
+
+void
+ObjTriangleStream::ReadMaterialLibrary(const std::string &path) {
+    const MappedFile file(path);
+    if (!file.IsOpen()) {
+        std::cerr << "Failed to open material library \"" << path << "\"\n";
+        return;
+    }
+
+    TextCursor cursor = {reinterpret_cast<const char *>(file.GetData()),
+                         reinterpret_cast<const char *>(file.GetData()) + file.GetSize()};
+    Material *material = nullptr;
+    while (!cursor.AtEnd()) {
+        const std::string_view keyword = cursor.Token();
+        if (keyword == "newmtl") {
+            m_MaterialIndices[std::string(cursor.Rest())] = m_Materials.size();
+            material = &m_Materials.emplace_back();
+        } else if (material && keyword == "Kd") {
+            material->baseColor = vec3(cursor.Float(), cursor.Float(), cursor.Float());
+        } else if (material && keyword == "map_Kd") {
+            // Options come before the file name, which is the last token.
+            const std::string_view rest = cursor.Rest();
+            const std::string texture(rest.substr(rest.find_last_of(" \t") + 1));
+            material->image = TextureManager::Get().LoadImage(m_Directory + texture);
+        }
+        cursor.SkipLine();
+    }
+}
+
+Vertex
+ObjTriangleStream::GetVertex(const int32 position, const int32 uv) const {
+    Vertex vertex;
+    if (position >= 0 && (position + 1) * sizeof(vec3) <= m_Positions.GetSize())
+        std::memcpy(&vertex.position, m_Positions.GetData() + position * sizeof(vec3), sizeof(vec3));
+    if (uv >= 0 && (uv + 1) * sizeof(vec2) <= m_Uvs.GetSize())
+        std::memcpy(&vertex.uv, m_Uvs.GetData() + uv * sizeof(vec2), sizeof(vec2));
+    return vertex;
+}
+
+void
+ObjTriangleStream::Rewind() {
+    m_Cursor = 0;
+    m_PositionCount = 0;
+    m_UvCount = 0;
+    m_Material = 0;
+}
+
+uint32
+ObjTriangleStream::Read(StreamTriangle *triangles, const uint32 maxCount) {
+    const char *data = reinterpret_cast<const char *>(m_File.GetData());
+    TextCursor cursor = {data + m_Cursor, data + m_File.GetSize()};
+    std::vector<Vertex> polygon;
+    uint32 count = 0;
+
+    while (!cursor.AtEnd()) {
+        const char *lineStart = cursor.position;
+        const std::string_view keyword = cursor.Token();
+        if (keyword == "v") {
+            m_PositionCount++;
+        } else if (keyword == "vt") {
+            m_UvCount++;
+        } else if (keyword == "usemtl") {
+            const auto material = m_MaterialIndices.find(std::string(cursor.Rest()));
+            m_Material = material != m_MaterialIndices.end() ? material->second : 0;
+        } else if (keyword == "f") {
+            // Vertices are position/uv/normal, uv and normal are optional.
+            polygon.clear();
+            for (std::string_view token = cursor.Token(); !token.empty(); token = cursor.Token()) {
+                TextCursor indices = {token.data(), token.data() + token.size()};
+                const int32 position = ResolveIndex(indices.Int(), m_PositionCount);
+                int32 uv = -1;
+                if (!indices.AtEnd() && *indices.position == '/') {
+                    ++indices.position;
+                    uv = ResolveIndex(indices.Int(), m_UvCount);
+                }
+                polygon.push_back(GetVertex(position, uv));
+            }
+
+            // Faces are only read whole, stop before one that does not fit.
+            if (polygon.size() >= 3 && count + polygon.size() - 2 > maxCount) {
+                cursor.position = lineStart;
+                break;
+            }
+
+            for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                StreamTriangle &triangle = triangles[count++];
+                triangle = {polygon[0], polygon[i], polygon[i + 1], m_Material};
+                const vec3 normal = normalize(cross(triangle.b.position - triangle.a.position,
+                                                    triangle.c.position - triangle.a.position));
+                triangle.a.normal = triangle.b.normal = triangle.c.normal = normal;
+            }
+            continue;
+        }
+        cursor.SkipLine();
+    }
+
+    m_Cursor = cursor.position - data;
+    return count;
+}
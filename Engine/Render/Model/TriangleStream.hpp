@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Model.hpp"
+#include "Utility/MappedFile.hpp"
+
+// A triangle with the index of its material in the stream.
+struct StreamTriangle {
+    Vertex a, b, c;
+    uint32 material = 0;
+};
+
+// Source of triangles that is read in chunks, so a model never has to be in memory as a whole.
+class TriangleStream {
+public:
+    virtual ~TriangleStream() = default;
+
+    // Starts over from the first triangle.
+    virtual void Rewind() = 0;
+
+    // Reads up to maxCount triangles, returns 0 at the end of the stream.
+    virtual uint32 Read(StreamTriangle *triangles, uint32 maxCount) = 0;
+
+    virtual const std::vector<Material> &GetMaterials() const = 0;
+};
+
+// Streams the triangles of a model that is already loaded.
+class ModelTriangleStream final : public TriangleStream {
+public:
+    explicit ModelTriangleStream(const Model &model);
+
+    void Rewind() override;
+
+    uint32 Read(StreamTriangle *triangles, uint32 maxCount) override;
+
+    const std::vector<Material> &GetMaterials() const override { return m_Materials; }
+
+private:
+    const Model &m_Model;
+    std::vector<Material> m_Materials;
+    uint32 m_MeshIndex = 0;
+    size_t m_IndexOffset = 0;
+};
+
+// Streams the faces of a Wavefront OBJ file from disk. Positions and texture coordinates are spilled to files in the
+// work directory and memory mapped, faces are parsed straight from the mapped OBJ. Materials come from its mtllib
+// files, textures are loaded as images only.
+class ObjTriangleStream final : public TriangleStream {
+public:
+    ObjTriangleStream(const std::string &path, const std::string &workDirectory);
+
+    ~ObjTriangleStream() override;
+
+    bool IsOpen() const { return m_File.IsOpen(); }
+
+    void Rewind() override;
+
+    uint32 Read(StreamTriangle *triangles, uint32 maxCount) override;
+
+    const std::vector<Material> &GetMaterials() const override { return m_Materials; }
+
+    uint64 GetTriangleCount() const { return m_TriangleCount; }
+
+private:
+    void ReadMaterialLibrary(const std::string &path);
+
+    Vertex GetVertex(int32 position, int32 uv) const;
+
+    MappedFile m_File;
+    MappedFile m_Positions;
+    MappedFile m_Uvs;
+    std::string m_Directory;
+    std::string m_PositionsPath, m_UvsPath;
+    std::vector<Material> m_Materials;
+    std::unordered_map<std::string, uint32> m_MaterialIndices;
+    uint64 m_TriangleCount = 0;
+
+    // Read position in the OBJ and the state at that point.
+    size_t m_Cursor = 0;
+    int32 m_PositionCount = 0, m_UvCount = 0;
+    uint32 m_Material = 0;
+};
@@ -1,7 +1,10 @@
 #include "Voxelizer.hpp"
 #include "Model.hpp"
 #include "DataStructures/BrickMap.hpp"
+#include "Math/Normal.hpp"
 #include "Render/Debug.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
 #include <thread>
 
 bool
@@ -87,8 +90,138 @@ Intersect(const math::BoundingBox &box, const Triangle &tri) {
 }
 
 
+// Clips a triangle to a box, returns the area of the part inside and its centroid.
+static float
+ClipToBox(const Triangle &triangle, const math::BoundingBox &box, vec3 &centroid) {
+    // Every plane can add at most one vertex.
+    vec3 polygon[9] = {triangle.a.position, triangle.b.position, triangle.c.position};
+    vec3 clipped[9];
+    uint32 count = 3;
+
+    for (int plane = 0; plane < 6 && count > 0; ++plane) {
+        const int axis = plane / 2;
+        const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+        const float bound = plane % 2 == 0 ? box.min[axis] : box.max[axis];
+
+        uint32 clippedCount = 0;
+        for (uint32 i = 0; i < count; ++i) {
+            const vec3 &current = polygon[i];
+            const vec3 &next = polygon[(i + 1) % count];
+            const float currentDistance = (current[axis] - bound) * sign;
+            const float nextDistance = (next[axis] - bound) * sign;
+
+            if (currentDistance >= 0.0f)
+                clipped[clippedCount++] = current;
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+                clipped[clippedCount++] = mix(current, next, currentDistance / (currentDistance - nextDistance));
+        }
+
+        std::copy_n(clipped, clippedCount, polygon);
+        count = clippedCount;
+    }
+
+    // Fan from the first vertex.
+    float area = 0.0f;
+    centroid = vec3(0.0f);
+    for (uint32 i = 1; i + 1 < count; ++i) {
+        const float fanArea = length(cross(polygon[i] - polygon[0], polygon[i + 1] - polygon[0])) * 0.5f;
+        area += fanArea;
+        centroid += (polygon[0] + polygon[i] + polygon[i + 1]) * (fanArea / 3.0f);
+    }
+    if (area > 0.0f)
+        centroid /= area;
+    return area;
+}
+
+// Color of a triangle at a point on it in the range [0, 255], textures are filtered over the voxel's footprint.
+static vec4
+SampleTriangle(const Triangle &triangle, const vec3 &point, const float voxelSize) {
+    const Material *material = triangle.material;
+    if (!material->image)
+        return vec4(material->baseColor * 255.0f, 255.0f);
+
+    float b0, b1, b2;
+    triangle.PointInTriangle(point, &b0, &b1, &b2);
+    const vec2 uv = b0 * triangle.a.uv + b1 * triangle.b.uv + b2 * triangle.c.uv;
+
+    // Texels per world unit, from the area of the triangle in texels and in the world.
+    const Image &image = *material->image;
+    const vec2 imageSize(image.width, image.height);
+    const vec2 uvEdge0 = (triangle.b.uv - triangle.a.uv) * imageSize;
+    const vec2 uvEdge1 = (triangle.c.uv - triangle.a.uv) * imageSize;
+    const float texelArea = std::abs(uvEdge0.x * uvEdge1.y - uvEdge0.y * uvEdge1.x);
+    const float worldArea = length(triangle.GetNormal());
+    const float footprint = worldArea > 0.0f ? std::sqrt(texelArea / worldArea) * voxelSize : 1.0f;
+
+    return image.Sample(uv, footprint);
+}
+
+// Average color and normal of the triangles in a voxel weighted by the area of each triangle inside it, and the
+// material covering most of it.
+static void
+ShadeLeaf(Node &node, const float voxelSize) {
+    vec4 sum(0.0f);
+    vec3 normalSum(0.0f), largestNormal(0.0f, 1.0f, 0.0f);
+    float totalArea = 0.0f, largestArea = 0.0f;
+    // Leaves rarely overlap more than a handful of materials.
+    std::vector<std::pair<const Material *, float> > materialAreas;
+
+    for (const Triangle &triangle: node.triangles) {
+        vec3 centroid;
+        const float area = ClipToBox(triangle, node.boundingBox, centroid);
+        if (area <= 0.0f)
+            continue;
+        sum += SampleTriangle(triangle, centroid, voxelSize) * area;
+        totalArea += area;
+
+        const vec3 normal = normalize(triangle.GetNormal());
+        normalSum += normal * area;
+        if (area > largestArea) {
+            largestArea = area;
+            largestNormal = normal;
+        }
+
+        auto it = std::find_if(materialAreas.begin(), materialAreas.end(),
+                               [&](const auto &entry) { return entry.first == triangle.material; });
+        if (it == materialAreas.end())
+            materialAreas.emplace_back(triangle.material, area);
+        else
+            it->second += area;
+    }
+
+    if (totalArea <= 0.0f)
+        return;
+
+    const vec4 color = sum / totalArea + 0.5f;
+    node.color = {static_cast<uint8>(color.r), static_cast<uint8>(color.g), static_cast<uint8>(color.b),
+                  static_cast<uint8>(color.a)};
+    // The two sides of a thin wall cancel out, the largest triangle decides then.
+    node.normal = math::EncodeNormal(dot(normalSum, normalSum) > 1e-6f * totalArea * totalArea
+                                         ? normalize(normalSum)
+                                         : largestNormal);
+    node.material = std::max_element(materialAreas.begin(), materialAreas.end(),
+                                      [](const auto &a, const auto &b) { return a.second < b.second; })->first;
+}
+
+// Mip chains are needed to sample textures over a voxel footprint.
+static void
+BuildMips(const std::vector<Triangle> &triangles) {
+    PROFILE_SCOPE("Voxelize::BuildMips");
+    std::vector<Image *> images;
+    for (const Triangle &triangle: triangles) {
+        Image *image = triangle.material->image.get();
+        if (image && image->mips.empty() && std::find(images.begin(), images.end(), image) == images.end())
+            images.push_back(image);
+    }
+
+    parallel::For(images.size(), [&](const uint32 i, uint32) {
+        images[i]->BuildMips();
+    });
+}
+
 OctreeMesh::OctreeMesh(const Mesh &mesh, const uint32 depth)
     : m_MaxDepth(depth) {
+    PROFILE_SCOPE("Voxelize::Subdivide");
     std::vector<Triangle> triangles(mesh.indices.size() / 3);
 
     math::BoundingBox rootBounds = {vec3(FLT_MAX), vec3(-FLT_MAX)};
@@ -124,10 +257,21 @@ OctreeMesh::OctreeMesh(const Mesh &mesh, const uint32 depth)
     m_Size = std::exp2(m_MaxDepth);
 
     std::cout << "Octree dimensions: " << m_Size << '\n';
+    BuildMips(m_Nodes[0].triangles);
     std::cout << "Subdividing mesh.\n";
     Subdivide(0, 0);
 }
 
+OctreeMesh::OctreeMesh(std::vector<Triangle> triangles, const math::BoundingBox &bounds, const uint32 depth)
+    : m_MaxDepth(depth) {
+    PROFILE_SCOPE("Voxelize::Subdivide");
+    m_Nodes.emplace_back(bounds, 0, std::move(triangles), math::Color());
+    m_Size = std::exp2(m_MaxDepth);
+
+    BuildMips(m_Nodes[0].triangles);
+    Subdivide(0, 0);
+}
+
 //std::string
 //PrefixedSize(const float size) {
 //    if (size > 1e9f)
@@ -142,6 +286,7 @@ OctreeMesh::OctreeMesh(const Mesh &mesh, const uint32 depth)
 
 OctreeMesh::OctreeMesh(const Model &model, const uint32 depth)
     : m_MaxDepth(depth) {
+    PROFILE_SCOPE("Voxelize::Subdivide");
     std::vector<Triangle> triangles;
     math::BoundingBox rootBounds = {vec3(FLT_MAX), vec3(-FLT_MAX)};
 
@@ -179,6 +324,7 @@ OctreeMesh::OctreeMesh(const Model &model, const uint32 depth)
     m_Size = std::exp2(m_MaxDepth);
 
     std::cout << "Octree dimensions: " << m_Size << '\n';
+    BuildMips(m_Nodes[0].triangles);
     std::cout << "Subdividing mesh.\n";
     Subdivide(0, 0);
     std::cout << "Number of nodes: " << m_Nodes.size() << '\n';
@@ -189,27 +335,7 @@ void
 OctreeMesh::Subdivide(const uint32 nodeIndex, const uint32 depth) {
     if (depth == m_MaxDepth) {
         Node &node = m_Nodes[nodeIndex];
-        for (const auto &triangle: node.triangles) {
-            float b0, b1, b2;
-            if (triangle.PointInTriangle(node.boundingBox.GetCenter(), &b0, &b1, &b2)) {
-                if (triangle.material->texture) {
-                    const std::shared_ptr<Image> image = TextureManager::Get().GetTextureImage(
-                        triangle.material->texture->GetId());
-
-                    const vec2 uv = {
-                        b0 * triangle.a.uv.x + b1 * triangle.b.uv.x + b2 * triangle.c.uv.x,
-                        b0 * triangle.a.uv.y + b1 * triangle.b.uv.y + b2 * triangle.c.uv.y
-                    };
-
-                    const int imagex = static_cast<int>(fract(uv.x) * image->width);
-                    const int imagey = static_cast<int>(fract(uv.y) * image->height);
-                    node.color = image->pixels[imagex + imagey * image->height];
-                } else {
-                    node.color = math::Color(triangle.material->baseColor);
-                }
-                break;
-            }
-        }
+        ShadeLeaf(node, node.boundingBox.GetSize().x);
         //if (node.color.data == 0) node.color = math::Color(0xFFFFFFFF);
 
         node.triangles.clear();
@@ -300,12 +426,36 @@ BrickMap
 OctreeMesh::CreateBrickMap(const float voxelSize) {
     std::cout << "Creating brickmap.\n";
     BrickMap bm(ivec3(m_Size), voxelSize);
-    FillBrickMap(&m_Nodes[0], 0, {0, 0, 0}, bm);
+    bm.EnableAttributes();
+    Fill(bm);
     return bm;
 }
 
+void
+OctreeMesh::Fill(BrickMap &bm) {
+    PROFILE_SCOPE("Voxelize::Fill");
+    FillBrickMap(&m_Nodes[0], 0, {0, 0, 0}, bm);
+}
+
+uint8
+OctreeMesh::GetMaterialId(const Material *material) {
+    if (!material)
+        return 0;
+
+    auto it = std::find(m_Materials.begin(), m_Materials.end(), material);
+    if (it != m_Materials.end())
+        return static_cast<uint8>(it - m_Materials.begin() + 1);
+    // Later materials share the last ID.
+    if (m_Materials.size() == UINT8_MAX)
+        return UINT8_MAX;
+
+    m_Materials.push_back(material);
+    return static_cast<uint8>(m_Materials.size());
+}
+
 BrickMap
 OctreeMesh::CreateBrickMap(const float voxelSize, const math::Color color) {
+    PROFILE_SCOPE("Voxelize::Fill");
     std::cout << "Creating brickmap.\n";
 
     BrickMap bm(ivec3(m_Size), voxelSize);
@@ -334,6 +484,8 @@ OctreeMesh::FillBrickMap(const Node *node,
     if (node->color.data) {
         const uint32 voxelSize = m_Size >> level;
 
+        const uint8 material = bm.HasAttributes() ? GetMaterialId(node->material) : 0;
+
         for (uint32 z = 0; z < voxelSize; ++z) {
             for (uint32 y = 0; y < voxelSize; ++y) {
                 for (uint32 x = 0; x < voxelSize; ++x) {
@@ -341,6 +493,8 @@ OctreeMesh::FillBrickMap(const Node *node,
                         globalPosition + ivec3(x, y, z),
                         node->color
                     );
+                    if (bm.HasAttributes())
+                        bm.SetAttributes(globalPosition + ivec3(x, y, z), node->normal, material);
                 }
             }
         }
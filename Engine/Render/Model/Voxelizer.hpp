@@ -67,11 +67,17 @@ struct Triangle {
     }
 };
 
+// Separating axis test between a box and a triangle.
+bool Intersect(const math::BoundingBox &box, const Triangle &tri);
+
 struct Node {
     math::BoundingBox boundingBox;
     uint32 childIndex = 0;
     std::vector<Triangle> triangles;
     math::Color color = {};
+    // Shading attributes of leaves, see BrickMap::BrickAttributes.
+    uint16 normal = 0;
+    const Material *material = nullptr;
 };
 
 class OctreeMesh {
@@ -80,6 +86,9 @@ public:
 
     OctreeMesh(const Model &model, uint32 depth);
 
+    // Subdivides a fixed cube instead of the bounds of the triangles, used to voxelize part of a larger model.
+    OctreeMesh(std::vector<Triangle> triangles, const math::BoundingBox &bounds, uint32 depth);
+
     void Subdivide(uint32 nodeIndex, uint32 depth);
 
     void Clear();
@@ -88,14 +97,22 @@ public:
 
     std::vector<math::Color> Linearize();
 
-    // Samples textures in model to assign colors to the voxels.
+    // Samples textures in model to assign colors to the voxels, and fills the brick attributes with the
+    // triangle normals and material IDs.
     BrickMap CreateBrickMap(float voxelSize);
 
     // All voxels will share the same color.
     BrickMap CreateBrickMap(float voxelSize, math::Color color);
 
+    // Inserts the voxels into an existing brick map that is at least GetSize() voxels on each side. Attributes are
+    // only written if the brick map has them enabled.
+    void Fill(BrickMap &bm);
+
     uint32 GetSize() const;
 
+    // Materials in the order they were given IDs by Fill, material ID i is at index i - 1.
+    const std::vector<const Material *> &GetMaterials() const { return m_Materials; }
+
 private:
     void FillBrickMap(const Node *node, uint32 level, const ivec3 &globalPosition, BrickMap &bm);
 
@@ -103,7 +120,10 @@ private:
 
     void DrawNode(const Node *node, uint32 depth) const;
 
+    uint8 GetMaterialId(const Material *material);
+
     std::vector<Node> m_Nodes;
+    std::vector<const Material *> m_Materials;
     uint32 m_Size = 0;
     uint32 m_MaxDepth = 0;
 };
@@ -0,0 +1,107 @@
+#include "PostProcess.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Bytes of the RGBA8 display texture of the separate pipeline.
+constexpr uint32 displayBytes = 4;
+
+PostProcess::PostProcess(const Settings &settings)
+    : m_Settings(settings) {
+    m_Settings.exposure = std::max(m_Settings.exposure, 0.0f);
+}
+
+// rgb2luma of post.glsl.
+static float
+Luma(const vec3 &color) {
+    return std::sqrt(dot(color, vec3(0.299f, 0.587f, 0.114f)));
+}
+
+void
+PostProcess::Apply(const std::vector<vec3> &image, const int32 width, const int32 height) {
+    PROFILE_SCOPE("PostProcess::Apply");
+    assert(image.size() == static_cast<size_t>(width) * height);
+    const uint32 targetBytes = Texture::GetBytesPerPixel(m_Settings.format);
+    m_Statistics = {};
+    m_Statistics.pixelCount = width * height;
+    if (m_Settings.fused) {
+        m_Statistics.bytesWritten = targetBytes;
+        m_Statistics.bytesRead = targetBytes;
+    } else {
+        m_Statistics.bytesWritten = targetBytes + displayBytes;
+        m_Statistics.bytesRead = targetBytes + displayBytes;
+    }
+
+    // What the post process reads, tonemapped either before the store or after the load.
+    m_Target.resize(image.size());
+    parallel::For(height, [&](const uint32 y, uint32) {
+        for (int32 x = 0; x < width; ++x) {
+            const uint32 i = x + y * width;
+            if (m_Settings.fused)
+                m_Target[i] = Quantize(Tonemap(image[i], m_Settings.exposure), m_Settings.format);
+            else
+                m_Target[i] = Tonemap(Quantize(image[i], m_Settings.format), m_Settings.exposure);
+        }
+    });
+
+    m_Image.resize(image.size());
+    parallel::For(height, [&](const uint32 y, uint32) {
+        for (int32 x = 0; x < width; ++x) {
+            // Neighbours outside the screen are clamped to its edge.
+            const auto pixel = [&](const int32 px, const int32 py) {
+                return m_Target[std::clamp(px, 0, width - 1) + std::clamp(py, 0, height - 1) * width];
+            };
+            const vec3 neighbourhood[5] = {
+                pixel(x, y), pixel(x - 1, y), pixel(x + 1, y), pixel(x, y - 1), pixel(x, y + 1)
+            };
+
+            float minLuma = FLT_MAX, maxLuma = 0.0f;
+            vec3 sum(0.0f);
+            for (const vec3 &color: neighbourhood) {
+                const float luma = Luma(color);
+                minLuma = std::min(minLuma, luma), maxLuma = std::max(maxLuma, luma);
+                sum += color;
+            }
+
+            const bool edge = maxLuma - minLuma >= std::max(m_Settings.thresholdMin, maxLuma * m_Settings.thresholdMax);
+            m_Image[x + y * width] = Quantize(edge ? sum / 5.0f : neighbourhood[0], TextureFormat::Rgba8);
+        }
+    });
+}
+
+vec3
+PostProcess::Tonemap(const vec3 &color, const float exposure) {
+    const vec3 x = max(color * exposure, vec3(0.0f));
+    return clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+// Unsigned float with a 5 bit exponent, the channels of R11G11B10f. Rounds to the nearest value and clamps to the
+// largest finite one.
+static float
+QuantizeUnsignedFloat(const float value, const int32 mantissaBits) {
+    if (!(value > 0.0f))
+        return 0.0f;
+    int32 exponent;
+    std::frexp(value, &exponent);
+    // Values below 2^-14 are denormals with the step of the smallest exponent.
+    exponent = std::max(exponent, -13);
+    const float step = std::ldexp(1.0f, exponent - 1 - mantissaBits);
+    const float largest = std::ldexp(2.0f - std::ldexp(1.0f, -mantissaBits), 15);
+    return std::min(std::round(value / step) * step, largest);
+}
+
+vec3
+PostProcess::Quantize(const vec3 &color, const TextureFormat format) {
+    switch (format) {
+        case TextureFormat::Rgba8:
+            return round(clamp(color, 0.0f, 1.0f) * 255.0f) / 255.0f;
+        case TextureFormat::R11G11B10f:
+            return {
+                QuantizeUnsignedFloat(color.r, 6), QuantizeUnsignedFloat(color.g, 6), QuantizeUnsignedFloat(color.b, 5)
+            };
+        default:
+            return color;
+    }
+}
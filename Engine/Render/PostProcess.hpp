@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Texture/Texture.hpp"
+
+// CPU reference of the pixel pipeline after tracing in post.glsl: the render texture format, the tonemap and the FXAA.
+// Separate runs them like fxaa.comp, which tonemaps and antialiases the linear colors the trace stored into an RGBA8
+// display texture for the blit. Fused runs them like rtBrickmap.comp and blit.frag, the trace tonemaps before the
+// store and the blit antialiases the render texture, so no full screen pass or display texture is left in between.
+class PostProcess {
+public:
+    struct Settings {
+        TextureFormat format = TextureFormat::Rgba32f;
+        bool fused = false;
+        float exposure = 1.0f;
+        // Contrast thresholds of the FXAA edge test, absolute and relative to the brightest pixel.
+        float thresholdMin = 0.0312f;
+        float thresholdMax = 0.125f;
+    };
+
+    struct Statistics {
+        uint32 pixelCount = 0;
+        // Bytes of full screen textures written and read per pixel from the trace to the blit, counting every texel
+        // read once.
+        uint32 bytesWritten = 0;
+        uint32 bytesRead = 0;
+    };
+
+    explicit PostProcess(const Settings &settings);
+
+    // Runs the pipeline on the linear colors of a frame, rows from the bottom of the screen.
+    void Apply(const std::vector<vec3> &image, int32 width, int32 height);
+
+    // Display colors of the last frame, rounded to the 8 bits of the framebuffer.
+    const std::vector<vec3> &GetImage() const { return m_Image; }
+
+    const Settings &GetSettings() const { return m_Settings; }
+
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+    static vec3 Tonemap(const vec3 &color, float exposure);
+
+    // Rounds a color to what a texel of the format stores, negative channels are stored as 0 by the unsigned formats.
+    static vec3 Quantize(const vec3 &color, TextureFormat format);
+
+private:
+    Settings m_Settings;
+    Statistics m_Statistics;
+
+    std::vector<vec3> m_Target;
+    std::vector<vec3> m_Image;
+};
@@ -7,6 +7,7 @@
 #include "Vertex/IndexBuffer.hpp"
 
 #include "Display/Window.hpp"
+#include "Utility/Profiler.hpp"
 
 constexpr float quadVertices[] = {
     -1.0f, -1.0f, 0.0f,
@@ -14,6 +15,15 @@ constexpr float quadVertices[] = {
     1.0f, 1.0f, 0.0f,
     -1.0f, 1.0f, 0.0f
 };
+constexpr uint32 statisticsBinding = 6;
+constexpr uint32 historyBinding = 11;
+constexpr uint32 reprojectionBinding = 12;
+constexpr uint32 tileStartBinding = 14;
+constexpr uint32 sampleBinding = 15;
+constexpr uint32 refinedBlockBinding = 16;
+constexpr size_t statisticsHeaderSize = sizeof(TraversalStatistics) / sizeof(uint32);
+static_assert(sizeof(TraversalStatistics) % sizeof(uint32) == 0);
+
 constexpr uint32 quadIndices[] = {
     0, 1, 2,
     2, 3, 0
@@ -40,9 +50,18 @@ struct Quad {
 Renderer::Renderer()
     : m_BrickGridBuffer(2),
       m_SolidMaskBuffer(3),
-      m_BrickTextureBuffer(4) {
+      m_ColorPointerBuffer(7),
+      m_BrickTextureBuffer(4),
+      m_BrickLodBuffer(5),
+      m_AttributeBuffer(8),
+      m_ProbeCellBuffer(9),
+      m_ProbeBuffer(10),
+      m_OccupancyBuffer(13) {
     m_Blit = ShaderManager::Get().Load("shaders/fullscreen.vert", "shaders/blit.frag");
     m_RaytraceBrickmap = ShaderManager::Get().Load("shaders/rtBrickmap.comp");
+    m_Reproject = ShaderManager::Get().Load("shaders/reproject.comp");
+    m_Beam = ShaderManager::Get().Load("shaders/beam.comp");
+    LoadScreenShaders();
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 }
 
@@ -50,6 +69,7 @@ Renderer::Renderer()
 
 void
 Renderer::Render() {
+    PROFILE_SCOPE("Renderer::Render");
     if (m_Width <= 0 || m_Height <= 0) {
         std::cerr << "Invalid renderer dimensions.\n"
                 << "\tWidth: " << m_Width << '\n'
@@ -75,6 +95,14 @@ Renderer::Render() {
         return;
     }
 
+    if (m_BeamPrepass)
+        TraceBeams(*mainCamera);
+    // Half of the history would be left from two frames ago, variable rate frames leave out the pixels they
+    // interpolate.
+    const bool checkerboard = m_Checkerboard && !m_VariableRate;
+    const bool reproject = m_Reprojection && !checkerboard && !m_VariableRate;
+    if (reproject)
+        Reproject(*mainCamera);
 
     m_RenderTexture.BindImageTexture();
 
@@ -83,14 +111,29 @@ Renderer::Render() {
     m_BrickGridBuffer.Bind();
     m_SolidMaskBuffer.Bind();
     m_BrickTextureBuffer.Bind();
+    m_BrickLodBuffer.Bind();
+    m_ColorPointerBuffer.Bind();
+    m_AttributeBuffer.Bind();
+    m_ProbeCellBuffer.Bind();
+    m_ProbeBuffer.Bind();
 
     m_RaytraceBrickmap.SetValue("u_ShowSteps", m_ShowSteps);
     m_RaytraceBrickmap.SetValue("u_ShowNormals", m_ShowNormals);
+    m_RaytraceBrickmap.SetValue("u_ShowOcclusion", m_ShowOcclusion);
+    m_RaytraceBrickmap.SetValue("u_SunShadows", m_SunShadows && m_BrickMap->HasAttributes());
+    m_RaytraceBrickmap.SetValue("u_UseProbes", m_IndirectLight);
+    m_RaytraceBrickmap.SetValue("u_CollectStats", m_CollectStatistics);
+    if (m_CollectStatistics)
+        ResetStatistics();
 
     m_RaytraceBrickmap.SetValue("u_CameraPosition", mainCamera->GetPosition());
     m_RaytraceBrickmap.SetValue("u_InvProjection", mainCamera->GetInvProjection());
     m_RaytraceBrickmap.SetValue("u_InvView", mainCamera->GetInvView());
 
+    // Projection[1][1] is 1 / tan(fovY / 2), so this is the world size of a pixel at unit distance.
+    const float footprint = 2.0f / (mainCamera->GetProjection()[1][1] * static_cast<float>(m_Height));
+    m_RaytraceBrickmap.SetValue("u_LodFootprint", footprint * m_LodBias);
+
     const math::BoundingBox &boundingBox = m_BrickMap->GetBoundingBox();
 
     m_RaytraceBrickmap.SetValue("u_GridMinBounds", boundingBox.min);
@@ -102,29 +145,188 @@ Renderer::Render() {
     m_RaytraceBrickmap.SetValue("u_GridXSize", dimensions.x);
     m_RaytraceBrickmap.SetValue("u_GridYSize", dimensions.y);
     m_RaytraceBrickmap.SetValue("u_GridZSize", dimensions.z);
+    m_RaytraceBrickmap.SetValue("u_GridTiled", m_BrickMap->GetGridLayout() == BrickMap::GridLayout::Tiled);
+    m_RaytraceBrickmap.SetValue("u_UseAttributes", m_BrickMap->HasAttributes());
     m_RaytraceBrickmap.SetValue("u_Resolution", vec2(m_Width, m_Height));
 
+    m_RaytraceBrickmap.SetValue("u_Reproject", reproject);
+    m_RaytraceBrickmap.SetValue("u_HistoryValid", reproject && m_HistoryValid);
+    m_RaytraceBrickmap.SetValue("u_ReprojectionMargin",
+                                TemporalReprojection::Settings().margin * m_BrickMap->GetVoxelSize());
+    m_RaytraceBrickmap.SetValue("u_UseBeam", m_BeamPrepass);
+    m_RaytraceBrickmap.SetValue("u_Checkerboard", checkerboard);
+    m_RaytraceBrickmap.SetValue("u_CheckerboardParity", m_CheckerboardParity);
+    m_RaytraceBrickmap.SetValue("u_VariableRatePass", 0);
+    m_RaytraceBrickmap.SetValue("u_Tonemap", m_PostProcess && m_FusedPostProcess);
+    m_RaytraceBrickmap.SetValue("u_Exposure", m_Exposure);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (m_VariableRate) {
+        TraceVariableRate();
+    } else {
+        // A checkerboard frame has one thread per traced pixel.
+        const int32 traceWidth = checkerboard ? (m_Width + 1) / 2 : m_Width;
+        m_GpuTimers.Begin("Trace");
+        glDispatchCompute(
+            std::ceil(static_cast<float>(traceWidth) / 16.0f),
+            std::ceil(static_cast<float>(m_Height) / 16.0f),
+            1
+        );
+        m_GpuTimers.End();
+    }
 
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    if (checkerboard) {
+        const bool reusePrevious = m_CheckerboardValid && m_PreviousPosition == mainCamera->GetPosition() &&
+                                   m_PreviousInvView == mainCamera->GetInvView() &&
+                                   m_PreviousInvProjection == mainCamera->GetInvProjection();
+        m_Reconstruct.Bind();
+        m_Reconstruct.SetValue("u_Resolution", vec2(m_Width, m_Height));
+        m_Reconstruct.SetValue("u_CheckerboardParity", m_CheckerboardParity);
+        m_Reconstruct.SetValue("u_ReusePrevious", reusePrevious);
+
+        m_GpuTimers.Begin("Reconstruct");
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glDispatchCompute(
+            std::ceil(static_cast<float>(m_Width) / 16.0f),
+            std::ceil(static_cast<float>(m_Height) / 16.0f),
+            1
+        );
+        m_GpuTimers.End();
+        m_CheckerboardParity ^= 1;
+    }
+    m_CheckerboardValid = checkerboard;
 
-    glDispatchCompute(
-        std::ceil(static_cast<float>(m_Width) / 16.0f),
-        std::ceil(static_cast<float>(m_Height) / 16.0f),
-        1
-    );
+    // Toggling reprojection back on starts from a fresh history.
+    m_HistoryValid = reproject;
+    m_PreviousPosition = mainCamera->GetPosition();
+    m_PreviousInvView = mainCamera->GetInvView();
+    m_PreviousInvProjection = mainCamera->GetInvProjection();
+
+    if (m_PostProcess && !m_FusedPostProcess)
+        ApplyPostProcess();
+
+    m_GpuTimers.Begin("Blit");
     Blit();
+    m_GpuTimers.End();
+
+    if (m_CollectStatistics)
+        ReadStatistics();
 }
 
 //------------------------------------------------------------------------------------------
 
 void
 Renderer::SetDimensions(const int32 width, const int32 height) {
+    m_OutputWidth = width, m_OutputHeight = height;
+    Resize();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetResolutionScale(const float scale) {
+    m_ResolutionScale = std::clamp(scale, 0.01f, 1.0f);
+    Resize();
+}
+
+bool
+Renderer::IsScaledPass(const string &name) {
+    // The blit writes the output size, passes outside the renderer do not depend on the resolution.
+    static constexpr const char *scaledPasses[] = {
+        "Trace", "Reconstruct", "Post process", "Reproject", "Beam", "Trace corners", "Refine", "Trace refined"
+    };
+    for (const char *pass: scaledPasses) {
+        if (name == pass)
+            return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetCheckerboard(const bool value) {
+    m_Checkerboard = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::Resize() {
+    const int32 width = static_cast<int32>(std::ceil(static_cast<float>(m_OutputWidth) * m_ResolutionScale));
+    const int32 height = static_cast<int32>(std::ceil(static_cast<float>(m_OutputHeight) * m_ResolutionScale));
     if (m_Width == width && m_Height == height) {
         // No need to recreate render texture if dimensions are the same.
         return;
     }
     m_Width = width, m_Height = height;
-    m_RenderTexture = std::move(Texture(m_Width, m_Height));
+    CreateTextures();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::CreateTextures() {
+    if (m_Width <= 0 || m_Height <= 0)
+        return;
+    m_RenderTexture = Texture(m_Width, m_Height, m_RenderTargetFormat);
+    if (m_PostProcess && !m_FusedPostProcess)
+        m_DisplayTexture = Texture(m_Width, m_Height, TextureFormat::Rgba8);
+    else
+        m_DisplayTexture = Texture();
+    m_CheckerboardValid = false;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::LoadScreenShaders() {
+    const std::vector<string> defines = {string("SCREEN_FORMAT ") + Texture::GetFormatQualifier(m_RenderTargetFormat)};
+    m_Reconstruct = ShaderManager::Get().Load("shaders/checkerboard.comp", defines);
+    m_Refine = ShaderManager::Get().Load("shaders/variableRate.comp", defines);
+    m_PostProcessShader = ShaderManager::Get().Load("shaders/fxaa.comp", defines);
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetRenderTargetFormat(const TextureFormat format) {
+    if (m_RenderTargetFormat == format)
+        return;
+    m_RenderTargetFormat = format;
+    LoadScreenShaders();
+    CreateTextures();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetPostProcess(const bool value) {
+    if (m_PostProcess == value)
+        return;
+    m_PostProcess = value;
+    CreateTextures();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetFusedPostProcess(const bool value) {
+    if (m_FusedPostProcess == value)
+        return;
+    m_FusedPostProcess = value;
+    CreateTextures();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetExposure(const float value) {
+    // Tonemapped pixels kept by the checkerboard would not match.
+    if (m_Exposure != value)
+        m_CheckerboardValid = false;
+    m_Exposure = std::max(value, 0.0f);
 }
 
 //------------------------------------------------------------------------------------------
@@ -144,13 +346,105 @@ Renderer::SetShowNormals(const bool value) {
 //------------------------------------------------------------------------------------------
 
 void
-Renderer::Blit() const {
+Renderer::SetShowOcclusion(const bool value) {
+    m_ShowOcclusion = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetSunShadows(const bool value) {
+    m_SunShadows = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetIndirectLight(const bool value) {
+    m_IndirectLight = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetReprojection(const bool value) {
+    m_Reprojection = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetBeamPrepass(const bool value) {
+    m_BeamPrepass = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetVariableRate(const bool value) {
+    m_VariableRate = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetCollectStatistics(const bool value) {
+    m_CollectStatistics = value;
+    if (!value)
+        m_TraversalStatistics = {};
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::SetLodBias(const float value) {
+    m_LodBias = value;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::ApplyPostProcess() {
+    PROFILE_SCOPE("Renderer::ApplyPostProcess");
+    const PostProcess::Settings settings;
+    m_RenderTexture.BindImageTexture();
+    m_DisplayTexture.BindImageTexture(1);
+    m_PostProcessShader.Bind();
+    m_PostProcessShader.SetValue("u_Resolution", vec2(m_Width, m_Height));
+    m_PostProcessShader.SetValue("u_Exposure", m_Exposure);
+    m_PostProcessShader.SetValue("u_ThresholdMin", settings.thresholdMin);
+    m_PostProcessShader.SetValue("u_ThresholdMax", settings.thresholdMax);
+
+    m_GpuTimers.Begin("Post process");
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glDispatchCompute(
+        std::ceil(static_cast<float>(m_Width) / 16.0f),
+        std::ceil(static_cast<float>(m_Height) / 16.0f),
+        1
+    );
+    m_GpuTimers.End();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::Blit() {
+    PROFILE_SCOPE("Renderer::Blit");
     static Quad fullscreenQuad;
 
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
     m_Blit.Bind();
-
-    m_RenderTexture.BindTexture();
+    // The fused post process antialiases here, the separate one already wrote the display texture.
+    const PostProcess::Settings settings;
+    m_Blit.SetValue("u_Fxaa", m_PostProcess && m_FusedPostProcess);
+    m_Blit.SetValue("u_ThresholdMin", settings.thresholdMin);
+    m_Blit.SetValue("u_ThresholdMax", settings.thresholdMax);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    if (m_PostProcess && !m_FusedPostProcess)
+        m_DisplayTexture.BindTexture();
+    else
+        m_RenderTexture.BindTexture();
 
     fullscreenQuad.vertexBuffer.Bind();
     fullscreenQuad.vertexArray.Bind();
@@ -158,3 +452,156 @@ Renderer::Blit() const {
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
 }
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::Reproject(const Camera &camera) {
+    PROFILE_SCOPE("Renderer::Reproject");
+    const size_t size = static_cast<size_t>(m_Width) * m_Height * 2;
+    if (!m_HistoryBuffer || m_HistoryBuffer->GetSize() != size) {
+        m_HistoryBuffer = std::make_unique<StorageBuffer<uint32> >(std::vector<uint32>(size), historyBinding);
+        m_ReprojectionBuffer = std::make_unique<StorageBuffer<uint32> >(std::vector<uint32>(size), reprojectionBinding);
+        m_HistoryValid = false;
+    }
+    m_HistoryBuffer->Bind();
+    m_ReprojectionBuffer->Bind();
+    if (!m_HistoryValid)
+        return;
+
+    m_Reproject.Bind();
+    m_Reproject.SetValue("u_Resolution", vec2(m_Width, m_Height));
+    m_Reproject.SetValue("u_PreviousCameraPosition", m_PreviousPosition);
+    m_Reproject.SetValue("u_PreviousInvView", m_PreviousInvView);
+    m_Reproject.SetValue("u_PreviousInvProjection", m_PreviousInvProjection);
+    m_Reproject.SetValue("u_CameraPosition", camera.GetPosition());
+    m_Reproject.SetValue("u_ProjView", camera.GetProjView());
+
+    m_GpuTimers.Begin("Reproject");
+    // Clear, nearest depth, then the brick of the nearest depth.
+    for (int32 pass = 0; pass < 3; ++pass) {
+        m_Reproject.SetValue("u_Pass", pass);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glDispatchCompute(
+            std::ceil(static_cast<float>(m_Width) / 16.0f),
+            std::ceil(static_cast<float>(m_Height) / 16.0f),
+            1
+        );
+    }
+    m_GpuTimers.End();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::TraceBeams(const Camera &camera) {
+    PROFILE_SCOPE("Renderer::TraceBeams");
+    const int32 tileSize = BeamPrepass::Settings().tileSize;
+    const ivec2 tiles((m_Width + tileSize - 1) / tileSize, (m_Height + tileSize - 1) / tileSize);
+    const size_t size = static_cast<size_t>(tiles.x) * tiles.y;
+    if (!m_TileStartBuffer || m_TileStartBuffer->GetSize() != size)
+        m_TileStartBuffer = std::make_unique<StorageBuffer<uint32> >(std::vector<uint32>(size), tileStartBinding);
+    m_TileStartBuffer->Bind();
+    m_OccupancyBuffer.Bind();
+
+    const ivec3 &dimensions = m_BrickMap->GetDimensions();
+    m_Beam.Bind();
+    m_Beam.SetValue("u_Resolution", vec2(m_Width, m_Height));
+    m_Beam.SetValue("u_CameraPosition", camera.GetPosition());
+    m_Beam.SetValue("u_InvProjection", camera.GetInvProjection());
+    m_Beam.SetValue("u_InvView", camera.GetInvView());
+    m_Beam.SetValue("u_GridMinBounds", m_BrickMap->GetBoundingBox().min);
+    m_Beam.SetValue("u_GridMaxBounds", m_BrickMap->GetBoundingBox().max);
+    m_Beam.SetValue("u_GridXSize", dimensions.x);
+    m_Beam.SetValue("u_GridYSize", dimensions.y);
+    m_Beam.SetValue("u_GridZSize", dimensions.z);
+    m_Beam.SetValue("u_VoxelSize", m_BrickMap->GetVoxelSize());
+    m_Beam.SetValue("u_OccupancyLevels", static_cast<int32>(BeamPrepass::GetLevelCount(dimensions)));
+
+    m_GpuTimers.Begin("Beam");
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glDispatchCompute(
+        std::ceil(static_cast<float>(tiles.x) / 8.0f),
+        std::ceil(static_cast<float>(tiles.y) / 8.0f),
+        1
+    );
+    m_GpuTimers.End();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::TraceVariableRate() {
+    PROFILE_SCOPE("Renderer::TraceVariableRate");
+    const int32 spacing = VariableRateTracer::Settings().spacing;
+    const ivec2 blocks((m_Width + spacing - 1) / spacing, (m_Height + spacing - 1) / spacing);
+    const size_t sampleCount = static_cast<size_t>(blocks.x + 1) * (blocks.y + 1);
+    if (!m_SampleBuffer || m_SampleBuffer->GetSize() != sampleCount * 2) {
+        m_SampleBuffer = std::make_unique<StorageBuffer<uint32> >(std::vector<uint32>(sampleCount * 2), sampleBinding);
+        m_RefinedBlockBuffer = std::make_unique<StorageBuffer<uint32> >(std::vector<uint32>(blocks.x * blocks.y),
+                                                                          refinedBlockBinding);
+    }
+    m_SampleBuffer->Bind();
+    m_RefinedBlockBuffer->Bind();
+
+    // The trace shader is still bound with the uniforms of the frame.
+    m_RaytraceBrickmap.SetValue("u_VariableRatePass", 1);
+    m_GpuTimers.Begin("Trace corners");
+    glDispatchCompute(
+        std::ceil(static_cast<float>(blocks.x + 1) / 16.0f),
+        std::ceil(static_cast<float>(blocks.y + 1) / 16.0f),
+        1
+    );
+    m_GpuTimers.End();
+
+    const VariableRateTracer::Settings settings;
+    m_Refine.Bind();
+    m_Refine.SetValue("u_Resolution", vec2(m_Width, m_Height));
+    m_Refine.SetValue("u_ThresholdMin", settings.thresholdMin);
+    m_Refine.SetValue("u_ThresholdMax", settings.thresholdMax);
+    m_Refine.SetValue("u_DepthThreshold", settings.depthThreshold);
+    m_GpuTimers.Begin("Refine");
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glDispatchCompute(
+        std::ceil(static_cast<float>(m_Width) / 16.0f),
+        std::ceil(static_cast<float>(m_Height) / 16.0f),
+        1
+    );
+    m_GpuTimers.End();
+
+    m_RaytraceBrickmap.Bind();
+    m_RaytraceBrickmap.SetValue("u_VariableRatePass", 2);
+    m_GpuTimers.Begin("Trace refined");
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glDispatchCompute(
+        std::ceil(static_cast<float>(m_Width) / 16.0f),
+        std::ceil(static_cast<float>(m_Height) / 16.0f),
+        1
+    );
+    m_GpuTimers.End();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::ResetStatistics() {
+    const size_t size = statisticsHeaderSize + (m_BrickMap->GetBricks().size() + 31) / 32;
+    if (!m_StatisticsBuffer || m_StatisticsBuffer->GetSize() < size) {
+        // Leave room for bricks added by edits so the buffer is rarely recreated.
+        m_StatisticsBuffer = std::make_unique<StorageBuffer<uint32> >(std::vector<uint32>(size + size / 4),
+                                                                      statisticsBinding);
+    } else {
+        m_StatisticsBuffer->SetData(0, std::vector<uint32>(m_StatisticsBuffer->GetSize()));
+    }
+    m_StatisticsBuffer->Bind();
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Renderer::ReadStatistics() {
+    PROFILE_SCOPE("Renderer::ReadStatistics");
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    const std::vector<uint32> header = m_StatisticsBuffer->GetData(0, statisticsHeaderSize);
+    std::memcpy(&m_TraversalStatistics, header.data(), sizeof(TraversalStatistics));
+}
@@ -1,6 +1,12 @@
 #pragma once
 
+#include "BeamPrepass.hpp"
 #include "DataStructures/BrickMap.hpp"
+#include "GpuTimer.hpp"
+#include "Lighting/RadianceCache.hpp"
+#include "PostProcess.hpp"
+#include "TemporalReprojection.hpp"
+#include "VariableRateTracer.hpp"
 #include "Shader/Shader.hpp"
 #include "Shader/StorageBuffer.hpp"
 #include "Texture/Texture.hpp"
@@ -12,37 +18,190 @@ public:
 
     void Render();
 
+    // Size of the output, the frame is traced at this size times the resolution scale.
     void SetDimensions(int32 width, int32 height);
 
+    // Fraction of the output size traced per side, the blit scales the result up. See ResolutionController.
+    void SetResolutionScale(float scale);
+
+    // Whether a GPU timer pass runs at the traced size, only those get faster at a lower resolution scale.
+    static bool IsScaledPass(const string &name);
+
+    // Traces half of the pixels every frame in a checkerboard that flips between frames, the others are kept from the
+    // previous frame while the view is unchanged and interpolated otherwise. Disables reprojection.
+    void SetCheckerboard(bool value);
+
+    // Traces the corners of small blocks first and all pixels only in the blocks with edges or depth discontinuities
+    // between their corners, the others are interpolated, see VariableRateTracer. Disables reprojection and the
+    // checkerboard.
+    void SetVariableRate(bool value);
+
+    // Size of the render texture.
+    ivec2 GetTraceDimensions() const { return {m_Width, m_Height}; }
+
+    // Format the trace stores colors in, the packed formats take a quarter of the memory traffic of Rgba32f. Rgba8
+    // clamps linear colors to 1 unless the post process is fused.
+    void SetRenderTargetFormat(TextureFormat format);
+
+    // Tonemaps and antialiases the frame before the blit, see PostProcess.
+    void SetPostProcess(bool value);
+
+    // Tonemaps in the trace and antialiases in the blit instead of in a separate pass over the frame. The checkerboard
+    // and variable rate modes then interpolate tonemapped colors.
+    void SetFusedPostProcess(bool value);
+
+    void SetExposure(float value);
+
     const Texture &GetRenderTexture() const { return m_RenderTexture; }
 
     void SetShowSteps(bool value);
 
     void SetShowNormals(bool value);
 
-    void SetBrickMap(BrickMap *brickMap) { m_BrickMap = brickMap; }
+    // Shows the baked ambient occlusion, white where nothing has been baked.
+    void SetShowOcclusion(bool value);
+
+    // Shadows voxels that are not in the sun mask of their brick attributes, enable once they have been baked.
+    void SetSunShadows(bool value);
+
+    // Replaces the constant ambient term with the irradiance of the probes in the probe buffers.
+    void SetIndirectLight(bool value);
+
+    // Starts primary rays at the reprojected hits of the previous frame, see TemporalReprojection.
+    void SetReprojection(bool value);
+
+    // Starts primary rays at the distance a cone traced for their tile found free, see BeamPrepass. Reads the
+    // occupancy buffer.
+    void SetBeamPrepass(bool value);
+
+    // Traces the next frame from the camera, needed after the brick map is edited.
+    void InvalidateHistory() { m_HistoryValid = false, m_CheckerboardValid = false; }
+
+    // Counts the steps and bricks of every pixel's ray, reading them back stalls until the frame is traced.
+    void SetCollectStatistics(bool value);
+
+    // Counters of the last frame rendered with statistics enabled.
+    const TraversalStatistics &GetTraversalStatistics() const { return m_TraversalStatistics; }
+
+    // Scales the pixel footprint used to select brick LOD levels, 0 disables LOD.
+    void SetLodBias(float value);
+
+    void SetBrickMap(BrickMap *brickMap) { m_BrickMap = brickMap, m_HistoryValid = false, m_CheckerboardValid = false; }
 
     StorageBuffer<uint32> &GetBrickGridBuffer() { return m_BrickGridBuffer; }
     StorageBuffer<BrickMap::Brick> &GetSolidMaskBuffer() { return m_SolidMaskBuffer; }
+    StorageBuffer<uint32> &GetColorPointerBuffer() { return m_ColorPointerBuffer; }
     StorageBuffer<BrickMap::BrickTexture> &GetBrickTextureBuffer() { return m_BrickTextureBuffer; }
+    StorageBuffer<BrickMap::BrickLod> &GetBrickLodBuffer() { return m_BrickLodBuffer; }
+    // Only read when the brick map has attributes.
+    StorageBuffer<BrickMap::BrickAttributes> &GetAttributeBuffer() { return m_AttributeBuffer; }
+    // Only read when indirect light is enabled.
+    StorageBuffer<uint32> &GetProbeCellBuffer() { return m_ProbeCellBuffer; }
+    StorageBuffer<RadianceCache::ProbeIrradiance> &GetProbeBuffer() { return m_ProbeBuffer; }
+    // Pyramid of BeamPrepass, only read when the beam pre-pass is enabled.
+    StorageBuffer<uint32> &GetOccupancyBuffer() { return m_OccupancyBuffer; }
 
     Shader &GetRaytraceShader() { return m_RaytraceBrickmap; }
 
+    // GPU time of the trace and blit passes, other passes of the frame can be added by the caller.
+    GpuTimerPool &GetGpuTimers() { return m_GpuTimers; }
+
 private:
-    void Blit() const;
+    // Recreates the render texture if the traced size changed.
+    void Resize();
+
+    // Creates the render texture and, for the separate post process, the display texture.
+    void CreateTextures();
+
+    // Compiles the shaders that read the render texture for its format.
+    void LoadScreenShaders();
+
+    // Tonemaps and antialiases the render texture into the display texture.
+    void ApplyPostProcess();
 
+    void Blit();
+
+    // Scatters the hits of the previous frame into the view of the camera, growing the buffers if needed.
+    void Reproject(const Camera &camera);
+
+    // Traces the cone of every tile, growing the start distance buffer if needed.
+    void TraceBeams(const Camera &camera);
+
+    // Traces the block corners, refines and traces the refined blocks, growing the buffers if needed.
+    void TraceVariableRate();
+
+    // Zeroes the statistics buffer, growing it if bricks were added since the last frame.
+    void ResetStatistics();
+
+    void ReadStatistics();
+
+    int32 m_OutputWidth = 0, m_OutputHeight = 0;
+    float m_ResolutionScale = 1.0f;
+    // Traced size.
     int32 m_Width = 0, m_Height = 0;
     Texture m_RenderTexture;
+    TextureFormat m_RenderTargetFormat = TextureFormat::Rgba32f;
+    // Output of the separate post process.
+    Texture m_DisplayTexture;
 
     bool m_ShowSteps = false;
     bool m_ShowNormals = false;
+    bool m_ShowOcclusion = false;
+    bool m_SunShadows = false;
+    bool m_IndirectLight = false;
+    bool m_CollectStatistics = false;
+    bool m_Reprojection = false;
+    bool m_BeamPrepass = false;
+    bool m_Checkerboard = false;
+    bool m_VariableRate = false;
+    bool m_PostProcess = false;
+    bool m_FusedPostProcess = false;
+    float m_Exposure = 1.0f;
+    float m_LodBias = 1.0f;
+
+    // Camera of the frame in the history buffer.
+    bool m_HistoryValid = false;
+    vec3 m_PreviousPosition{};
+    mat4 m_PreviousInvView{};
+    mat4 m_PreviousInvProjection{};
+
+    // Parity of the pixels traced next, and whether the render texture holds the other half for the previous camera.
+    int32 m_CheckerboardParity = 0;
+    bool m_CheckerboardValid = false;
 
     BrickMap *m_BrickMap = nullptr;
 
     StorageBuffer<uint32> m_BrickGridBuffer;
     StorageBuffer<BrickMap::Brick> m_SolidMaskBuffer;
+    StorageBuffer<uint32> m_ColorPointerBuffer;
     StorageBuffer<BrickMap::BrickTexture> m_BrickTextureBuffer;
+    StorageBuffer<BrickMap::BrickLod> m_BrickLodBuffer;
+    StorageBuffer<BrickMap::BrickAttributes> m_AttributeBuffer;
+    StorageBuffer<uint32> m_ProbeCellBuffer;
+    StorageBuffer<RadianceCache::ProbeIrradiance> m_ProbeBuffer;
+    StorageBuffer<uint32> m_OccupancyBuffer;
+
+    // TraversalStatistics followed by one bit per brick. Storage is immutable, so it is recreated to grow.
+    std::unique_ptr<StorageBuffer<uint32> > m_StatisticsBuffer;
+    TraversalStatistics m_TraversalStatistics;
+
+    // Hit depth and brick of every pixel, and the previous frame's hits scattered into the current view. Both hold
+    // two values per pixel and are recreated when the dimensions change.
+    std::unique_ptr<StorageBuffer<uint32> > m_HistoryBuffer;
+    std::unique_ptr<StorageBuffer<uint32> > m_ReprojectionBuffer;
+    // Start distance of every tile as float bits, recreated when the dimensions change.
+    std::unique_ptr<StorageBuffer<uint32> > m_TileStartBuffer;
+    // Depth and bricks entered of every block corner, and a flag for every block that is traced in full.
+    std::unique_ptr<StorageBuffer<uint32> > m_SampleBuffer;
+    std::unique_ptr<StorageBuffer<uint32> > m_RefinedBlockBuffer;
 
     Shader m_RaytraceBrickmap;
+    Shader m_Reproject;
+    Shader m_Beam;
+    Shader m_Reconstruct;
+    Shader m_Refine;
+    Shader m_PostProcessShader;
     Shader m_Blit;
+
+    GpuTimerPool m_GpuTimers;
 };
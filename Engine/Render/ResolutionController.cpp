@@ -0,0 +1,53 @@
+#include "ResolutionController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController(const Settings &settings)
+    : m_Settings(settings) {
+    m_Settings.budgetMs = std::max(m_Settings.budgetMs, 0.1f);
+    m_Settings.scaleStep = std::max(m_Settings.scaleStep, 0.01f);
+    m_Settings.maxScale = std::max(m_Settings.maxScale, m_Settings.scaleStep);
+    m_Settings.minScale = std::clamp(m_Settings.minScale, m_Settings.scaleStep, m_Settings.maxScale);
+    m_Settings.windowFrames = std::max(m_Settings.windowFrames, 1u);
+    Reset();
+}
+
+float
+ResolutionController::Update(const float frameMs) {
+    m_Statistics.frameCount++;
+    if (m_SkippedFrames > 0) {
+        m_SkippedFrames--;
+        return m_Scale;
+    }
+
+    m_WindowSum += frameMs;
+    if (++m_WindowCount < m_Settings.windowFrames)
+        return m_Scale;
+
+    const float average = m_WindowSum / static_cast<float>(m_WindowCount);
+    m_WindowSum = 0.0f, m_WindowCount = 0;
+    m_Statistics.averageMs = average;
+    if (std::abs(average / m_Settings.budgetMs - 1.0f) <= m_Settings.tolerance)
+        return m_Scale;
+
+    // The small bias keeps a scale that already is on a step from falling to the one below.
+    const float desired = m_Scale * std::sqrt(m_Settings.budgetMs / std::max(average, 1e-3f));
+    const float stepped = std::floor(desired / m_Settings.scaleStep + 1e-3f) * m_Settings.scaleStep;
+    const float scale = std::clamp(stepped, m_Settings.minScale, m_Settings.maxScale);
+    if (std::abs(scale - m_Scale) < m_Settings.scaleStep * 0.5f)
+        return m_Scale;
+
+    m_Scale = scale;
+    m_Statistics.changeCount++;
+    m_SkippedFrames = m_Settings.latencyFrames;
+    return m_Scale;
+}
+
+void
+ResolutionController::Reset() {
+    m_Scale = m_Settings.maxScale;
+    m_WindowSum = 0.0f, m_WindowCount = 0;
+    m_SkippedFrames = 0;
+    m_Statistics = {};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Picks the resolution scale the renderer traces at so frames fit a time budget. Frame times are averaged over a
+// window, and when the average leaves the tolerance around the budget the scale is corrected by the square root of
+// the budget over the average, since the trace cost grows with the pixel count. Scales are kept on steps so the render
+// targets are not recreated every frame, and the frames right after a change are skipped because their timings are
+// read back a few frames late and still belong to the previous resolution.
+class ResolutionController {
+public:
+    struct Settings {
+        float budgetMs = 16.0f;
+        float minScale = 0.25f;
+        float maxScale = 1.0f;
+        // Scales are multiples of this, rounded down so the predicted time stays within the budget.
+        float scaleStep = 0.05f;
+        // Relative distance of the average from the budget that is left alone.
+        float tolerance = 0.1f;
+        // Frames averaged for every decision.
+        uint32 windowFrames = 8;
+        // Frames ignored after a change.
+        uint32 latencyFrames = 3;
+    };
+
+    struct Statistics {
+        uint32 frameCount = 0;
+        uint32 changeCount = 0;
+        // Average frame time of the last full window.
+        float averageMs = 0.0f;
+    };
+
+    explicit ResolutionController(const Settings &settings);
+
+    // Adds the time of a frame, returns the scale for the next one.
+    float Update(float frameMs);
+
+    // Starts over at the maximum scale.
+    void Reset();
+
+    float GetScale() const { return m_Scale; }
+
+    const Settings &GetSettings() const { return m_Settings; }
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    Settings m_Settings;
+    Statistics m_Statistics;
+
+    float m_Scale = 1.0f;
+    float m_WindowSum = 0.0f;
+    uint32 m_WindowCount = 0;
+    uint32 m_SkippedFrames = 0;
+};
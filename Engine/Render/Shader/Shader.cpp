@@ -181,10 +181,10 @@ ShaderManager::Load(const string &vsPath, const string &fsPath) {
 //------------------------------------------------------------------------------------------
 
 Shader &
-ShaderManager::Load(const string &csPath) {
+ShaderManager::Load(const string &csPath, const std::vector<string> &defines) {
     Shader shader;
     shader.m_Id = glCreateProgram();
-    const uint32 cs = CompileShader(csPath, GL_COMPUTE_SHADER);
+    const uint32 cs = CompileShader(csPath, GL_COMPUTE_SHADER, defines);
 
     glAttachShader(shader.m_Id, cs);
     glLinkProgram(shader.m_Id);
@@ -232,8 +232,17 @@ ShaderManager::LoadShader(const string &path) {
 //------------------------------------------------------------------------------------------
 
 uint32
-ShaderManager::CompileShader(const string &path, const uint32 type) {
-    const string source = LoadShader(path);
+ShaderManager::CompileShader(const string &path, const uint32 type, const std::vector<string> &defines) {
+    string source = LoadShader(path);
+    if (!defines.empty()) {
+        string lines;
+        for (const string &define: defines)
+            lines += "#define " + define + '\n';
+        // Nothing but comments may come before the version line.
+        const size_t version = source.find("#version");
+        const size_t end = version == string::npos ? string::npos : source.find('\n', version);
+        source.insert(end == string::npos ? 0 : end + 1, lines);
+    }
 
     const uint32 shader = glCreateShader(type);
     const char *src = source.c_str();
@@ -62,14 +62,15 @@ class ShaderManager {
 public:
     Shader &Load(const std::string &vsPath, const std::string &fsPath);
 
-    Shader &Load(const std::string &csPath);
+    // Defines are added after the version line, such as "SCREEN_FORMAT rgba8".
+    Shader &Load(const std::string &csPath, const std::vector<string> &defines = {});
 
     void Clear();
 
 private:
     static string LoadShader(const string &path);
 
-    static uint32 CompileShader(const string &path, uint32 type);
+    static uint32 CompileShader(const string &path, uint32 type, const std::vector<string> &defines = {});
 
     static string ErrorLog(uint32 shader);
 
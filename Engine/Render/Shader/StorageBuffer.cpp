@@ -1,5 +1,6 @@
 #include "StorageBuffer.hpp"
 #include "GL/glew.h"
+#include "Utility/Profiler.hpp"
 
 void
 details::CreateBuffer(uint32 &id) {
@@ -10,6 +11,7 @@ details::CreateBuffer(uint32 &id) {
 
 void
 details::Upload(const uint32 id, const size_t size, const void *data) {
+	PROFILE_SCOPE("StorageBuffer::Upload");
 	//glNamedBufferData()
 	glNamedBufferStorage(id, size, data, GL_DYNAMIC_STORAGE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT);
 }
@@ -18,6 +20,7 @@ details::Upload(const uint32 id, const size_t size, const void *data) {
 
 void
 details::GetData(const uint32 id, const size_t offset, const size_t size, void *data) {
+  PROFILE_SCOPE("StorageBuffer::GetData");
   glGetNamedBufferSubData(id, offset, size, data);
 }
 
@@ -25,6 +28,7 @@ details::GetData(const uint32 id, const size_t offset, const size_t size, void *
 
 void
 details::SetData(const uint32 id, const size_t offset, const size_t size, const void *data) {
+  PROFILE_SCOPE("StorageBuffer::SetData");
   glNamedBufferSubData(id, offset, size, data);
 }
 
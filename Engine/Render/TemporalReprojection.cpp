@@ -0,0 +1,169 @@
+#include "TemporalReprojection.hpp"
+#include "Camera.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <atomic>
+#include <bit>
+
+// Positive floats keep their order as bits, so the nearest hit is the smallest value.
+constexpr uint32 noReprojectedDepth = UINT32_MAX;
+
+TemporalReprojection::TemporalReprojection(const Settings &settings)
+    : m_Settings(settings) {
+    m_Settings.margin = std::max(m_Settings.margin, 0.0f);
+    m_Settings.searchRadius = std::max(m_Settings.searchRadius, 0);
+}
+
+void
+TemporalReprojection::Render(BrickMap &bm, const Camera &camera, const int32 width, const int32 height,
+                             TraversalRecorder *recorder) {
+    PROFILE_SCOPE("TemporalReprojection::Render");
+    const uint32 pixelCount = width * height;
+    if (width != m_Width || height != m_Height) {
+        m_Width = width, m_Height = height;
+        m_Depths.assign(pixelCount, noDepth);
+        m_Bricks.assign(pixelCount, EMPTY_BRICK);
+        m_ReprojectedDepths.resize(pixelCount);
+        m_ReprojectedBricks.resize(pixelCount);
+        m_HasHistory = false;
+    }
+    m_Statistics = {};
+    m_Statistics.pixelCount = pixelCount;
+
+    const bool reproject = m_HasHistory;
+    if (reproject)
+        Reproject(camera);
+
+    const float voxelSize = bm.GetVoxelSize();
+    const float margin = m_Settings.margin * voxelSize;
+    const int32 radius = m_Settings.searchRadius;
+    const vec2 resolution(width, height);
+
+    std::vector<TraversalRecorder> recorders(recorder ? parallel::GetThreadCount() : 0,
+                                             TraversalRecorder(bm.GetBricks().size()));
+    std::atomic<uint32> reprojectedCount = 0, retracedCount = 0;
+
+    // Rows are traced in parallel, every pixel only writes its own depth and brick.
+    parallel::For(height, [&](const uint32 y, const uint32 thread) {
+        TraversalRecorder *threadRecorder = recorder ? &recorders[thread] : nullptr;
+        uint32 reprojected = 0, retraced = 0;
+
+        for (int32 x = 0; x < width; ++x) {
+            const uint32 pixel = x + y * width;
+            const vec2 uv = vec2(x, y) / resolution * 2.0f - 1.0f;
+            const math::Ray ray = camera.GetPixelRay(uv);
+
+            // Rays start at the nearest reprojected hit around the pixel, and are checked against the pixel's own hit.
+            // Holes left by the scatter are where surfaces get disoccluded, they are checked against the nearest one.
+            uint32 nearestBits = noReprojectedDepth, expectedBits = noReprojectedDepth, expectedBrick = EMPTY_BRICK;
+            if (reproject) {
+                expectedBits = m_ReprojectedDepths[pixel];
+                expectedBrick = m_ReprojectedBricks[pixel];
+                for (int32 dy = -radius; dy <= radius; ++dy) {
+                    for (int32 dx = -radius; dx <= radius; ++dx) {
+                        const ivec2 neighbour = clamp(ivec2(x + dx, y + dy), ivec2(0), ivec2(width, height) - 1);
+                        const uint32 index = neighbour.x + neighbour.y * width;
+                        if (m_ReprojectedDepths[index] < nearestBits) {
+                            nearestBits = m_ReprojectedDepths[index];
+                            if (expectedBits == noReprojectedDepth)
+                                expectedBrick = m_ReprojectedBricks[index];
+                        }
+                    }
+                }
+                if (expectedBits == noReprojectedDepth)
+                    expectedBits = nearestBits;
+            }
+
+            float startDistance = 0.0f;
+            float expectedDepth = 0.0f;
+            if (nearestBits != noReprojectedDepth) {
+                expectedDepth = std::bit_cast<float>(expectedBits);
+                startDistance = std::max(std::bit_cast<float>(nearestBits) - margin, 0.0f);
+                reprojected += startDistance > 0.0f;
+            }
+
+            auto hit = bm.RayCast(ray, 0.0f, threadRecorder, startDistance);
+            float depth = noDepth;
+            uint32 brick = EMPTY_BRICK;
+            const auto resolve = [&] {
+                depth = noDepth, brick = EMPTY_BRICK;
+                if (!hit)
+                    return;
+                // Entry distance of the voxel that was hit.
+                const vec3 voxelMin = bm.GetBoundingBox().min + vec3(hit->position) * voxelSize;
+                float tNear, tFar;
+                ray.Intersect(math::BoundingBox(voxelMin, voxelMin + voxelSize), tNear, tFar);
+                depth = std::max(tNear, 0.0f);
+                brick = bm.GetGrid()[bm.GetCellIndex(hit->position / BRICK_DIMENSIONS)];
+            };
+            resolve();
+
+            // A surface in front of the start is only disoccluded where the ray lands behind the expected hit.
+            if (startDistance > 0.0f && (!hit || (brick != expectedBrick && depth > expectedDepth + margin))) {
+                retraced++;
+                hit = bm.RayCast(ray, 0.0f, threadRecorder);
+                resolve();
+            }
+
+            m_Depths[pixel] = depth;
+            m_Bricks[pixel] = brick;
+        }
+
+        reprojectedCount += reprojected;
+        retracedCount += retraced;
+    });
+
+    for (const TraversalRecorder &threadRecorder: recorders)
+        recorder->Merge(threadRecorder);
+
+    m_Statistics.reprojectedCount = reprojectedCount;
+    m_Statistics.retracedCount = retracedCount;
+
+    m_HasHistory = true;
+    m_PreviousCamera = camera;
+}
+
+void
+TemporalReprojection::Invalidate() {
+    m_HasHistory = false;
+}
+
+void
+TemporalReprojection::Reproject(const Camera &camera) {
+    PROFILE_SCOPE("TemporalReprojection::Reproject");
+    std::fill(m_ReprojectedDepths.begin(), m_ReprojectedDepths.end(), noReprojectedDepth);
+    std::fill(m_ReprojectedBricks.begin(), m_ReprojectedBricks.end(), EMPTY_BRICK);
+
+    const vec2 resolution(m_Width, m_Height);
+    const mat4 &projView = camera.GetProjView();
+
+    // The shader scatters with atomicMin in one pass and writes the bricks of the nearest hits in a second, serial
+    // order gives the same result here.
+    for (int32 y = 0; y < m_Height; ++y) {
+        for (int32 x = 0; x < m_Width; ++x) {
+            const uint32 pixel = x + y * m_Width;
+            if (m_Depths[pixel] == noDepth)
+                continue;
+
+            const vec2 uv = vec2(x, y) / resolution * 2.0f - 1.0f;
+            const math::Ray ray = m_PreviousCamera.GetPixelRay(uv);
+            const vec3 position = ray.origin + ray.direction * m_Depths[pixel];
+
+            const vec4 clip = projView * vec4(position, 1.0f);
+            if (clip.w <= 0.0f)
+                continue;
+            const ivec2 target = ivec2(round((vec2(clip.x, clip.y) / clip.w * 0.5f + 0.5f) * resolution));
+            if (any(lessThan(target, ivec2(0))) || any(greaterThanEqual(target, ivec2(m_Width, m_Height))))
+                continue;
+
+            const uint32 targetPixel = target.x + target.y * m_Width;
+            const uint32 depthBits = std::bit_cast<uint32>(distance(position, camera.GetPosition()));
+            if (depthBits < m_ReprojectedDepths[targetPixel]) {
+                m_ReprojectedDepths[targetPixel] = depthBits;
+                m_ReprojectedBricks[targetPixel] = m_Bricks[pixel];
+            }
+        }
+    }
+}
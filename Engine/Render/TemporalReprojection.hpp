@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Camera.hpp"
+
+#include <cfloat>
+
+class BrickMap;
+class TraversalRecorder;
+
+// CPU reference of the reprojection done by reproject.comp and rtBrickmap.comp. Every frame keeps the hit depth and
+// brick of its pixels. The next frame scatters those hits into its own view, keeping the nearest per pixel, and starts
+// each primary ray a margin in front of the nearest reprojected hit around the pixel instead of at the camera. A ray
+// that then misses, or hits another brick further than the margin behind the pixel's own reprojected hit, may have
+// skipped a disoccluded surface and is traced again from the camera.
+class TemporalReprojection {
+public:
+    struct Settings {
+        // Distance in voxels the rays start in front of the reprojected hit.
+        float margin = 4.0f;
+        // Pixels searched around a pixel for the nearest reprojected hit, covers holes left by the scatter. The shader
+        // uses REPROJECTION_RADIUS.
+        int32 searchRadius = 1;
+    };
+
+    struct Statistics {
+        uint32 pixelCount = 0;
+        // Pixels that started at a reprojected depth.
+        uint32 reprojectedCount = 0;
+        // Reprojected pixels that failed the disocclusion test and were traced again from the camera.
+        uint32 retracedCount = 0;
+    };
+
+    // Written for pixels without a hit.
+    static constexpr float noDepth = FLT_MAX;
+
+    explicit TemporalReprojection(const Settings &settings);
+
+    // Traces a frame of primary rays, the same rays as CastRay in rt.glsl, reprojecting the previous frame if there is
+    // one of the same size. Brick maps are traversed at full resolution.
+    void Render(BrickMap &bm, const Camera &camera, int32 width, int32 height, TraversalRecorder *recorder = nullptr);
+
+    // Forgets the previous frame, the next one is traced from the camera. Needed after the brick map is edited.
+    void Invalidate();
+
+    // Distance from the camera to the hit of every pixel of the last frame, noDepth for misses.
+    const std::vector<float> &GetDepths() const { return m_Depths; }
+
+    // Brick hit by every pixel of the last frame, EMPTY_BRICK for misses.
+    const std::vector<uint32> &GetBricks() const { return m_Bricks; }
+
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+private:
+    // Scatters the hits of the previous frame into the view of the camera.
+    void Reproject(const Camera &camera);
+
+    Settings m_Settings;
+    Statistics m_Statistics;
+
+    int32 m_Width = 0, m_Height = 0;
+    bool m_HasHistory = false;
+    Camera m_PreviousCamera;
+
+    std::vector<float> m_Depths;
+    std::vector<uint32> m_Bricks;
+
+    // Nearest depth scattered into every pixel as float bits, and the brick it came from.
+    std::vector<uint32> m_ReprojectedDepths;
+    std::vector<uint32> m_ReprojectedBricks;
+};
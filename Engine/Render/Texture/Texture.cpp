@@ -5,9 +5,34 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+static GLenum
+GetInternalFormat(const TextureFormat format) {
+    switch (format) {
+        case TextureFormat::Rgba8:
+            return GL_RGBA8;
+        case TextureFormat::R11G11B10f:
+            return GL_R11F_G11F_B10F;
+        default:
+            return GL_RGBA32F;
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
 Texture::Texture(Texture &&other) noexcept {
     m_Id = other.m_Id;
     m_Target = other.m_Target;
+    m_Width = other.m_Width, m_Height = other.m_Height;
+    m_Format = other.m_Format;
 
     other.m_Id = 0;
     other.m_Target = 0;
@@ -18,8 +43,14 @@ Texture::Texture(Texture &&other) noexcept {
 Texture &
 Texture::operator=(Texture &&other) noexcept {
     if (this != &other) {
+        // The render texture is replaced whenever its size or format changes.
+        if (m_Id != 0)
+            glDeleteTextures(1, &m_Id);
+
         m_Id = other.m_Id;
         m_Target = other.m_Target;
+        m_Width = other.m_Width, m_Height = other.m_Height;
+        m_Format = other.m_Format;
 
         other.m_Id = 0;
         other.m_Target = 0;
@@ -30,7 +61,10 @@ Texture::operator=(Texture &&other) noexcept {
 
 //------------------------------------------------------------------------------------------
 
-Texture::Texture(const int32 width, const int32 height) {
+Texture::Texture(const int32 width, const int32 height, const TextureFormat format)
+    : m_Width(width),
+      m_Height(height),
+      m_Format(format) {
     glGenTextures(1, &m_Id);
     glActiveTexture(GL_TEXTURE0);
     m_Target = GL_TEXTURE_2D;
@@ -39,8 +73,10 @@ Texture::Texture(const int32 width, const int32 height) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA,
-                 GL_FLOAT, nullptr);
+    // Nothing is uploaded, the client format only has to be valid for the internal one.
+    const GLenum clientFormat = format == TextureFormat::R11G11B10f ? GL_RGB : GL_RGBA;
+    const GLenum type = format == TextureFormat::Rgba8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+    glTexImage2D(GL_TEXTURE_2D, 0, GetInternalFormat(format), width, height, 0, clientFormat, type, nullptr);
 }
 
 //------------------------------------------------------------------------------------------
@@ -82,8 +118,74 @@ Texture::BindTexture() const {
 //------------------------------------------------------------------------------------------
 
 void
-Texture::BindImageTexture() const {
-    glBindImageTexture(0, m_Id, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+Texture::BindImageTexture(const uint32 unit) const {
+    glBindImageTexture(unit, m_Id, 0, GL_FALSE, 0, GL_READ_WRITE, GetInternalFormat(m_Format));
+}
+
+//------------------------------------------------------------------------------------------
+
+const char *
+Texture::GetFormatQualifier(const TextureFormat format) {
+    switch (format) {
+        case TextureFormat::Rgba8:
+            return "rgba8";
+        case TextureFormat::R11G11B10f:
+            return "r11f_g11f_b10f";
+        default:
+            return "rgba32f";
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+uint32
+Texture::GetBytesPerPixel(const TextureFormat format) {
+    return format == TextureFormat::Rgba32f ? 16 : 4;
+}
+
+//------------------------------------------------------------------------------------------
+
+// math::Color keeps red in the highest byte, so every pixel has its bytes reversed.
+static void
+ConvertRGBA(const uint8 *data, const size_t count, math::Color *pixels) {
+    size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX2__)
+    const __m128i reverse = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), _mm_shuffle_epi8(rgba, reverse));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; i + 4 <= count; i += 4) {
+        __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 4));
+        // Swap the bytes of every 16 bit half, then swap the halves.
+        rgba = _mm_or_si128(_mm_slli_epi16(rgba, 8), _mm_srli_epi16(rgba, 8));
+        rgba = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rgba, 0xB1), 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), rgba);
+    }
+#endif
+    for (; i < count; ++i) {
+        pixels[i] = math::Color(data[i * 4 + 0], data[i * 4 + 1], data[i * 4 + 2], data[i * 4 + 3]);
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+static void
+ConvertRGB(const uint8 *data, const size_t count, math::Color *pixels) {
+    size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX2__)
+    // Every load reads 16 bytes but only uses the 12 of 4 pixels, stop early enough to stay inside the data.
+    const __m128i expand = _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9);
+    const __m128i alpha = _mm_set1_epi32(0xFF);
+    for (; i + 6 <= count; i += 4) {
+        const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), _mm_or_si128(_mm_shuffle_epi8(rgb, expand), alpha));
+    }
+#endif
+    for (; i < count; ++i) {
+        pixels[i] = math::Color(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2], 255);
+    }
 }
 
 //------------------------------------------------------------------------------------------
@@ -95,19 +197,157 @@ Image::Image(const uint8 *data,
     : width(width),
       height(height),
       numChannels(numChannels) {
+    assert(numChannels == 3 || numChannels == 4);
     pixels.resize(width * height);
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            const int index = x + y * width;
-            const uint8 alpha = numChannels == 4 ? data[index * numChannels + 3] : 255;
-
-            pixels[index] = math::Color(
-                data[index * numChannels + 0],
-                data[index * numChannels + 1],
-                data[index * numChannels + 2],
-                alpha
-            );
+    if (numChannels == 4) {
+        ConvertRGBA(data, pixels.size(), pixels.data());
+    } else {
+        ConvertRGB(data, pixels.size(), pixels.data());
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+Image::BuildMips() {
+    PROFILE_SCOPE("Image::BuildMips");
+    if (!mips.empty() || pixels.empty())
+        return;
+
+    const math::Color *source = pixels.data();
+    int32 sourceWidth = width, sourceHeight = height;
+    while (sourceWidth > 1 || sourceHeight > 1) {
+        Mip mip;
+        mip.width = std::max(sourceWidth / 2, 1);
+        mip.height = std::max(sourceHeight / 2, 1);
+        mip.pixels.resize(mip.width * mip.height);
+
+        // Box filter, odd sizes clamp the last row and column.
+        for (int32 y = 0; y < mip.height; ++y) {
+            const int32 y0 = std::min(y * 2, sourceHeight - 1) * sourceWidth;
+            const int32 y1 = std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth;
+            for (int32 x = 0; x < mip.width; ++x) {
+                const int32 x0 = std::min(x * 2, sourceWidth - 1);
+                const int32 x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                const math::Color texels[4] = {source[x0 + y0], source[x1 + y0], source[x0 + y1], source[x1 + y1]};
+
+                uint32 r = 2, g = 2, b = 2, a = 2;
+                for (const math::Color &texel: texels) {
+                    r += texel.r, g += texel.g, b += texel.b, a += texel.a;
+                }
+                mip.pixels[x + y * mip.width] = math::Color(static_cast<uint8>(r / 4), static_cast<uint8>(g / 4),
+                                                            static_cast<uint8>(b / 4), static_cast<uint8>(a / 4));
+            }
         }
+
+        mips.push_back(std::move(mip));
+        source = mips.back().pixels.data();
+        sourceWidth = mips.back().width;
+        sourceHeight = mips.back().height;
+    }
+}
+
+//------------------------------------------------------------------------------------------
+
+static vec4
+SampleBilinear(const math::Color *pixels, const int32 width, const int32 height, const vec2 &uv) {
+    const float x = fract(uv.x) * static_cast<float>(width) - 0.5f;
+    const float y = fract(uv.y) * static_cast<float>(height) - 0.5f;
+    const float floorX = std::floor(x), floorY = std::floor(y);
+    const float fx = x - floorX, fy = y - floorY;
+
+    // Wrap, the floor can be -1 at the left and top edges.
+    const int32 x0 = (static_cast<int32>(floorX) + width) % width;
+    const int32 y0 = (static_cast<int32>(floorY) + height) % height;
+    const int32 x1 = (x0 + 1) % width;
+    const int32 y1 = (y0 + 1) % height;
+
+    const auto texel = [&](const int32 tx, const int32 ty) {
+        const math::Color color = pixels[tx + ty * width];
+        return vec4(color.r, color.g, color.b, color.a);
+    };
+
+    const vec4 top = mix(texel(x0, y0), texel(x1, y0), fx);
+    const vec4 bottom = mix(texel(x0, y1), texel(x1, y1), fx);
+    return mix(top, bottom, fy);
+}
+
+//------------------------------------------------------------------------------------------
+
+vec4
+Image::Sample(const vec2 &uv, const float footprint) const {
+    if (pixels.empty())
+        return vec4(0.0f);
+
+    const float level = std::clamp(std::log2(std::max(footprint, 1.0f)), 0.0f, static_cast<float>(mips.size()));
+    const uint32 level0 = static_cast<uint32>(level);
+    const uint32 level1 = std::min(level0 + 1, static_cast<uint32>(mips.size()));
+
+    const auto sampleLevel = [&](const uint32 index) {
+        if (index == 0)
+            return SampleBilinear(pixels.data(), width, height, uv);
+        const Mip &mip = mips[index - 1];
+        return SampleBilinear(mip.pixels.data(), mip.width, mip.height, uv);
+    };
+
+    const vec4 color0 = sampleLevel(level0);
+    if (level1 == level0)
+        return color0;
+    return mix(color0, sampleLevel(level1), level - static_cast<float>(level0));
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+TextureManager::LoadFiles(const std::vector<std::string> &paths, const bool upload) {
+    PROFILE_SCOPE("TextureManager::LoadFiles");
+    struct DecodedFile {
+        std::string path;
+        uint8 *data = nullptr;
+        int32 width = 0, height = 0, numChannels = 0;
+        std::shared_ptr<Image> image;
+    };
+
+    std::vector<DecodedFile> files;
+    for (const std::string &path: paths) {
+        const bool loaded = m_ImagesByPath.contains(path) && (!upload || m_Textures.contains(path));
+        const bool queued = std::any_of(files.begin(), files.end(), [&](const DecodedFile &file) {
+            return file.path == path;
+        });
+        if (!loaded && !queued)
+            files.push_back({path});
+    }
+
+    parallel::For(files.size(), [&](const uint32 i, uint32) {
+        DecodedFile &file = files[i];
+        // Gray images are expanded to RGB(A) by the decoder.
+        int32 channels = 0;
+        if (stbi_info(file.path.c_str(), &file.width, &file.height, &channels) && channels < 3)
+            channels = channels == 2 ? STBI_rgb_alpha : STBI_rgb;
+        else
+            channels = 0;
+
+        file.data = stbi_load(file.path.c_str(), &file.width, &file.height, &file.numChannels, channels);
+        if (file.data == nullptr)
+            return;
+        if (channels != 0)
+            file.numChannels = channels;
+        file.image = std::make_shared<Image>(file.data, file.width, file.height, file.numChannels);
+    });
+
+    for (DecodedFile &file: files) {
+        if (file.data == nullptr) {
+            std::cerr << "Failed to load texture \"" << file.path << "\"\n";
+            continue;
+        }
+
+        m_ImagesByPath[file.path] = file.image;
+        if (upload) {
+            const auto texture = std::make_shared<Texture>(file.data, file.width, file.height, file.numChannels);
+            m_Textures[file.path] = texture;
+            m_Images[texture->GetId()] = file.image;
+        }
+        stbi_image_free(file.data);
     }
 }
 
@@ -115,19 +355,43 @@ Image::Image(const uint8 *data,
 
 std::shared_ptr<Texture>
 TextureManager::Load(const std::string &path, const bool reload) {
-    if (m_Textures.contains(path) && !reload) {
-        return m_Textures[path];
+    if (reload) {
+        m_Textures.erase(path);
+        m_ImagesByPath.erase(path);
     }
 
-    int32 w, h, n;
-    uint8 *data = stbi_load(path.c_str(), &w, &h, &n, 0);
-    assert(data);
+    if (!m_UploadEnabled)
+        return nullptr;
 
-    m_Textures[path] = std::make_shared<Texture>(data, w, h, n);
-    m_Images[m_Textures[path]->GetId()] = std::make_shared<Image>(data, w, h, n);
-    stbi_image_free(data);
+    if (!m_Textures.contains(path)) {
+        LoadFiles({path}, true);
+    }
+
+    const auto texture = m_Textures.find(path);
+    return texture != m_Textures.end() ? texture->second : nullptr;
+}
 
-    return m_Textures[path];
+//------------------------------------------------------------------------------------------
+
+std::shared_ptr<Image>
+TextureManager::LoadImage(const std::string &path, const bool reload) {
+    if (reload) {
+        m_ImagesByPath.erase(path);
+    }
+
+    if (!m_ImagesByPath.contains(path)) {
+        LoadFiles({path}, false);
+    }
+
+    const auto image = m_ImagesByPath.find(path);
+    return image != m_ImagesByPath.end() ? image->second : nullptr;
+}
+
+//------------------------------------------------------------------------------------------
+
+void
+TextureManager::Preload(const std::vector<std::string> &paths) {
+    LoadFiles(paths, m_UploadEnabled);
 }
 
 //------------------------------------------------------------------------------------------
@@ -6,6 +6,14 @@ struct Image;
 
 typedef uint32 TextureId;
 
+// Formats of the textures compute shaders write, see Texture(width, height, format).
+enum class TextureFormat : uint32 {
+    Rgba32f,
+    Rgba8,
+    // Unsigned floats without alpha, 4 bytes like Rgba8 but keeps colors above 1.
+    R11G11B10f,
+};
+
 //------------------------------------------------------------------------------------------
 
 class Texture {
@@ -16,7 +24,7 @@ public:
 
     Texture &operator=(Texture &&other) noexcept;
 
-    Texture(int32 width, int32 height);
+    Texture(int32 width, int32 height, TextureFormat format = TextureFormat::Rgba32f);
 
     Texture(const uint8 *data, int32 width, int32 height, int32 numChannels);
 
@@ -24,28 +32,51 @@ public:
 
     void BindTexture() const;
 
-    void BindImageTexture() const;
+    // Binds a texture created with a format to an image unit for reading and writing.
+    void BindImageTexture(uint32 unit = 0) const;
 
     TextureId GetId() const { return m_Id; }
 
+    TextureFormat GetFormat() const { return m_Format; }
+
     int32 GetWidth() const { return m_Width; }
     int32 GetHeight() const { return m_Height; }
 
+    // Layout qualifier of image variables of the format, such as rgba8.
+    static const char *GetFormatQualifier(TextureFormat format);
+
+    static uint32 GetBytesPerPixel(TextureFormat format);
+
 private:
     TextureId m_Id = 0;
     int32 m_Width = 0, m_Height = 0, m_NumChannels = 0;
     uint32 m_Target = 0;
+    TextureFormat m_Format = TextureFormat::Rgba32f;
 };
 
 //------------------------------------------------------------------------------------------
 
 struct Image {
+    struct Mip {
+        std::vector<math::Color> pixels;
+        int32 width = 0, height = 0;
+    };
+
     Image() = default;
 
     Image(const uint8 *data, int32 width, int32 height, int32 numChannels);
 
+    // Builds the mip chain used by Sample, does nothing if it is already built.
+    void BuildMips();
+
+    // Trilinear sample in the range [0, 255], uv wraps around. Footprint is the side of the sampled area in texels of
+    // the full image and selects the mip level.
+    vec4 Sample(const vec2 &uv, float footprint) const;
+
     std::vector<math::Color> pixels;
     int32 width = 0, height = 0, numChannels = 0;
+    // Levels below the full image, each half the size of the previous one down to 1x1.
+    std::vector<Mip> mips;
 };
 
 //------------------------------------------------------------------------------------------
@@ -54,13 +85,28 @@ class TextureManager {
     SINGLETON(TextureManager)
 
 public:
+    // Returns nullptr if the file could not be loaded or uploads are disabled.
     std::shared_ptr<Texture> Load(const std::string &path, bool reload = false);
 
+    // Decoded pixels of an image file, never creates a GL texture.
+    std::shared_ptr<Image> LoadImage(const std::string &path, bool reload = false);
+
+    // Decodes every file that is not loaded yet on the worker threads, textures are then uploaded on this thread.
+    void Preload(const std::vector<std::string> &paths);
+
+    // With uploads disabled only images are loaded, so no GL context is needed.
+    void SetUploadEnabled(const bool enabled) { m_UploadEnabled = enabled; }
+    bool IsUploadEnabled() const { return m_UploadEnabled; }
+
     std::shared_ptr<Image> GetTextureImage(const Texture &texture);
 
     std::shared_ptr<Image> GetTextureImage(TextureId texture);
 
 private:
+    void LoadFiles(const std::vector<std::string> &paths, bool upload);
+
+    bool m_UploadEnabled = true;
     std::unordered_map<std::string, std::shared_ptr<Texture> > m_Textures;
+    std::unordered_map<std::string, std::shared_ptr<Image> > m_ImagesByPath;
     std::unordered_map<TextureId, std::shared_ptr<Image> > m_Images;
 };
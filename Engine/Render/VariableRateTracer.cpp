@@ -0,0 +1,178 @@
+#include "VariableRateTracer.hpp"
+#include "Camera.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "DataStructures/TraversalStatistics.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+// Not normalized, the same as in rtBrickmap.comp.
+constexpr vec3 sun(0.3f, 1.0f, 0.3f);
+
+VariableRateTracer::VariableRateTracer(const Settings &settings)
+    : m_Settings(settings) {
+    m_Settings.spacing = std::max(m_Settings.spacing, 1);
+    m_Settings.depthThreshold = std::max(m_Settings.depthThreshold, 0.0f);
+}
+
+void
+VariableRateTracer::Render(BrickMap &bm, const Camera &camera, const int32 width, const int32 height,
+                           TraversalRecorder *recorder) {
+    PROFILE_SCOPE("VariableRateTracer::Render");
+    const int32 spacing = m_Settings.spacing;
+    const ivec2 size(width, height);
+    const vec2 resolution(size);
+    const ivec2 blocks = (size + spacing - 1) / spacing;
+    // Samples past the last pixel are clamped to it.
+    const ivec2 samples = blocks + 1;
+
+    m_Image.resize(width * height);
+    m_Samples.resize(samples.x * samples.y);
+    m_Statistics = {};
+    m_Statistics.pixelCount = width * height;
+    m_Statistics.blockCount = blocks.x * blocks.y;
+
+    std::vector<TraversalRecorder> recorders(parallel::GetThreadCount(), TraversalRecorder(bm.GetBricks().size()));
+    parallel::For(samples.y, [&](const uint32 y, const uint32 thread) {
+        for (int32 x = 0; x < samples.x; ++x) {
+            const ivec2 pixel = glm::min(ivec2(x, y) * spacing, size - 1);
+            m_Samples[x + y * samples.x] = Trace(bm, camera, pixel, resolution, recorders[thread]);
+        }
+    });
+
+    std::atomic<uint32> refinedBlockCount = 0;
+    parallel::For(blocks.y, [&](const uint32 blockY, const uint32 thread) {
+        uint32 refined = 0;
+        for (int32 blockX = 0; blockX < blocks.x; ++blockX) {
+            const uint32 sample = blockX + blockY * samples.x;
+            const Sample *corners[4] = {
+                &m_Samples[sample], &m_Samples[sample + 1], &m_Samples[sample + samples.x],
+                &m_Samples[sample + samples.x + 1]
+            };
+            const bool refine = NeedsRefinement(corners);
+            refined += refine;
+
+            const ivec2 first = ivec2(blockX, blockY) * spacing;
+            const ivec2 last = glm::min(first + spacing, size - 1);
+            const ivec2 end = glm::min(first + spacing, size);
+            const vec2 extent = vec2(glm::max(last - first, ivec2(1)));
+            for (int32 y = first.y; y < end.y; ++y) {
+                for (int32 x = first.x; x < end.x; ++x) {
+                    vec3 &color = m_Image[x + y * width];
+                    // Corners were traced by the first pass, the last one may lie inside the block at the screen edge.
+                    const int32 cornerX = x == first.x ? 0 : x == last.x ? 1 : -1;
+                    const int32 cornerY = y == first.y ? 0 : y == last.y ? 1 : -1;
+                    if (cornerX >= 0 && cornerY >= 0) {
+                        color = corners[cornerX + cornerY * 2]->color;
+                    } else if (refine) {
+                        color = Trace(bm, camera, ivec2(x, y), resolution, recorders[thread]).color;
+                    } else {
+                        const vec2 f = vec2(x - first.x, y - first.y) / extent;
+                        color = mix(mix(corners[0]->color, corners[1]->color, f.x),
+                                    mix(corners[2]->color, corners[3]->color, f.x), f.y);
+                    }
+                }
+            }
+        }
+        refinedBlockCount += refined;
+    });
+    m_Statistics.refinedBlockCount = refinedBlockCount;
+
+    for (const TraversalRecorder &threadRecorder: recorders) {
+        m_Statistics.rayCount += threadRecorder.GetStatistics().rayCount;
+        if (recorder)
+            recorder->Merge(threadRecorder);
+    }
+}
+
+void
+VariableRateTracer::RenderFull(BrickMap &bm, const Camera &camera, const int32 width, const int32 height,
+                               TraversalRecorder *recorder) {
+    PROFILE_SCOPE("VariableRateTracer::RenderFull");
+    const vec2 resolution(width, height);
+    m_Image.resize(width * height);
+    m_Statistics = {};
+    m_Statistics.pixelCount = width * height;
+    m_Statistics.rayCount = width * height;
+
+    std::vector<TraversalRecorder> recorders(parallel::GetThreadCount(), TraversalRecorder(bm.GetBricks().size()));
+    parallel::For(height, [&](const uint32 y, const uint32 thread) {
+        for (int32 x = 0; x < width; ++x)
+            m_Image[x + y * width] = Trace(bm, camera, ivec2(x, y), resolution, recorders[thread]).color;
+    });
+
+    if (recorder) {
+        for (const TraversalRecorder &threadRecorder: recorders)
+            recorder->Merge(threadRecorder);
+    }
+}
+
+float
+VariableRateTracer::ComputePsnr(const std::vector<vec3> &image, const std::vector<vec3> &reference) {
+    assert(image.size() == reference.size());
+    double errorSq = 0.0;
+    for (size_t i = 0; i < image.size(); ++i) {
+        const vec3 error = clamp(image[i], 0.0f, 1.0f) - clamp(reference[i], 0.0f, 1.0f);
+        errorSq += dot(error, error);
+    }
+    if (errorSq == 0.0)
+        return INFINITY;
+    return static_cast<float>(10.0 * std::log10(3.0 * static_cast<double>(image.size()) / errorSq));
+}
+
+VariableRateTracer::Sample
+VariableRateTracer::Trace(BrickMap &bm, const Camera &camera, const ivec2 &pixel, const vec2 &resolution,
+                          TraversalRecorder &recorder) {
+    const math::Ray ray = camera.GetPixelRay(vec2(pixel) / resolution * 2.0f - 1.0f);
+    const uint32 bricksEntered = recorder.GetStatistics().bricksEnteredTotal;
+    const auto hit = bm.RayCast(ray, 0.0f, &recorder);
+
+    Sample sample;
+    if (!hit) {
+        sample.nearMiss = recorder.GetStatistics().bricksEnteredTotal != bricksEntered;
+        const float alignment = dot(ray.direction, sun);
+        const vec3 specular = vec3(1.0f, 0.9f, 1.0f) * smoothstep(0.95f, 1.2f, alignment);
+        sample.color = vec3(0.3f, 0.4f, 0.6f) * (alignment * 0.5f + 0.5f) + specular;
+        return sample;
+    }
+
+    const math::Color voxel = bm.GetVoxel(hit->position).value();
+    sample.color = vec3(voxel.r, voxel.g, voxel.b) / 255.0f * std::max(dot(vec3(hit->normal), sun), 0.1f);
+
+    // Entry distance of the voxel that was hit.
+    const float voxelSize = bm.GetVoxelSize();
+    const vec3 voxelMin = bm.GetBoundingBox().min + vec3(hit->position) * voxelSize;
+    float tNear, tFar;
+    ray.Intersect(math::BoundingBox(voxelMin, voxelMin + voxelSize), tNear, tFar);
+    sample.depth = std::max(tNear, 0.0f);
+    return sample;
+}
+
+bool
+VariableRateTracer::NeedsRefinement(const Sample *corners[4]) const {
+    float minLuma = FLT_MAX, maxLuma = 0.0f;
+    float minDepth = noDepth, maxDepth = 0.0f;
+    uint32 hitCount = 0;
+    for (uint32 i = 0; i < 4; ++i) {
+        const Sample &corner = *corners[i];
+        if (corner.nearMiss)
+            return true;
+        // rgb2luma of post.glsl.
+        const float luma = std::sqrt(dot(corner.color, vec3(0.299f, 0.587f, 0.114f)));
+        minLuma = std::min(minLuma, luma), maxLuma = std::max(maxLuma, luma);
+        if (corner.depth != noDepth) {
+            hitCount++;
+            minDepth = std::min(minDepth, corner.depth), maxDepth = std::max(maxDepth, corner.depth);
+        }
+    }
+
+    if (hitCount != 0 && hitCount != 4)
+        return true;
+    if (hitCount == 4 && maxDepth - minDepth > minDepth * m_Settings.depthThreshold)
+        return true;
+    return maxLuma - minLuma >= std::max(m_Settings.thresholdMin, maxLuma * m_Settings.thresholdMax);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cfloat>
+
+class BrickMap;
+class Camera;
+class TraversalRecorder;
+
+// CPU reference of the variable rate mode of rtBrickmap.comp and variableRate.comp. A first pass traces one pixel every
+// spacing pixels in both directions, the corners of blocks of spacing x spacing pixels. A block is refined, all of its
+// pixels traced, if its corners fail the luma contrast test of post.glsl, are not all hits or all misses, differ in
+// depth by more than a fraction of the nearest, or one of them is a miss that entered a brick and so passed close to
+// geometry. The pixels of the other blocks are interpolated bilinearly from the corners.
+class VariableRateTracer {
+public:
+    struct Settings {
+        // Pixels between the samples of the first pass, the shader uses VARIABLE_RATE_SPACING.
+        int32 spacing = 4;
+        // Contrast thresholds of the post.glsl edge test, absolute and relative to the brightest corner.
+        float thresholdMin = 0.0312f;
+        float thresholdMax = 0.125f;
+        // Difference in depth relative to the nearest corner that counts as a discontinuity.
+        float depthThreshold = 0.05f;
+    };
+
+    struct Statistics {
+        uint32 pixelCount = 0;
+        uint32 blockCount = 0;
+        uint32 refinedBlockCount = 0;
+        // Rays of both passes.
+        uint32 rayCount = 0;
+    };
+
+    // Depth of pixels without a hit.
+    static constexpr float noDepth = FLT_MAX;
+
+    explicit VariableRateTracer(const Settings &settings);
+
+    // Traces a frame in two passes, the same rays as CastRay in rt.glsl, shaded like rtBrickmap.comp without
+    // occlusion, sun shadows or probes.
+    void Render(BrickMap &bm, const Camera &camera, int32 width, int32 height, TraversalRecorder *recorder = nullptr);
+
+    // Traces every pixel of a frame, the reference for Render.
+    void RenderFull(BrickMap &bm, const Camera &camera, int32 width, int32 height,
+                    TraversalRecorder *recorder = nullptr);
+
+    // Linear colors of the last frame, rows from the bottom of the screen.
+    const std::vector<vec3> &GetImage() const { return m_Image; }
+
+    const Settings &GetSettings() const { return m_Settings; }
+
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+    // Peak signal to noise ratio in dB of an image against a reference with colors clamped to [0, 1], infinite for
+    // identical images.
+    static float ComputePsnr(const std::vector<vec3> &image, const std::vector<vec3> &reference);
+
+private:
+    struct Sample {
+        vec3 color{};
+        float depth = noDepth;
+        // A miss that entered a brick.
+        bool nearMiss = false;
+    };
+
+    static Sample Trace(BrickMap &bm, const Camera &camera, const ivec2 &pixel, const vec2 &resolution,
+                        TraversalRecorder &recorder);
+
+    // Whether the pixels between four corner samples have to be traced.
+    bool NeedsRefinement(const Sample *corners[4]) const;
+
+    Settings m_Settings;
+    Statistics m_Statistics;
+
+    std::vector<vec3> m_Image;
+    std::vector<Sample> m_Samples;
+};
@@ -0,0 +1,98 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path) {
+#ifdef _WIN32
+    m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE) {
+        m_File = nullptr;
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0) {
+        Close();
+        return;
+    }
+
+    m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping == nullptr) {
+        Close();
+        return;
+    }
+
+    m_Data = static_cast<const uint8 *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_Data == nullptr) {
+        Close();
+        return;
+    }
+    m_Size = size.QuadPart;
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return;
+
+    struct stat status{};
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            m_Data = static_cast<const uint8 *>(data);
+            m_Size = status.st_size;
+        }
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(file);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &
+MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        Close();
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+#ifdef _WIN32
+        std::swap(m_File, other.m_File);
+        std::swap(m_Mapping, other.m_Mapping);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+void
+MappedFile::Close() {
+#ifdef _WIN32
+    if (m_Data != nullptr)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping != nullptr)
+        CloseHandle(m_Mapping);
+    if (m_File != nullptr)
+        CloseHandle(m_File);
+    m_File = nullptr;
+    m_Mapping = nullptr;
+#else
+    if (m_Data != nullptr)
+        munmap(const_cast<uint8 *>(m_Data), m_Size);
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Read only view of a whole file mapped into memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(MappedFile &&other) noexcept;
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    // False if the file could not be opened or is empty.
+    bool IsOpen() const { return m_Data != nullptr; }
+
+    const uint8 *GetData() const { return m_Data; }
+    size_t GetSize() const { return m_Size; }
+
+private:
+    void Close();
+
+    const uint8 *m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    void *m_File = nullptr;
+    void *m_Mapping = nullptr;
+#endif
+};
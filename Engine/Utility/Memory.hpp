@@ -0,0 +1,6 @@
+#pragma once
+
+namespace memory {
+    // Largest resident set size of the process so far in bytes, 0 where it cannot be queried.
+    size_t GetPeakUsage();
+}
@@ -0,0 +1,54 @@
+#include "Parallel.hpp"
+#include <atomic>
+#include <thread>
+
+namespace parallel {
+    static uint32 s_ThreadCount = 0;
+
+    //------------------------------------------------------------------------------------------
+
+    uint32
+    GetThreadCount() {
+        if (s_ThreadCount == 0)
+            return std::max(std::thread::hardware_concurrency(), 1u);
+        return s_ThreadCount;
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    SetThreadCount(const uint32 count) {
+        s_ThreadCount = count;
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    For(const uint32 count, const std::function<void(uint32 index, uint32 threadIndex)> &func) {
+        const uint32 threadCount = std::min(GetThreadCount(), count);
+        if (threadCount <= 1) {
+            for (uint32 i = 0; i < count; ++i)
+                func(i, 0);
+            return;
+        }
+
+        std::atomic<uint32> next = 0;
+        const auto worker = [&](const uint32 threadIndex) {
+            for (uint32 i = next++; i < count; i = next++)
+                func(i, threadIndex);
+        };
+
+        // The calling thread works as well instead of idling until the others are done.
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (uint32 i = 1; i < threadCount; ++i)
+            threads.emplace_back(worker, i);
+
+        worker(0);
+
+        for (auto &thread: threads)
+            thread.join();
+    }
+
+    //------------------------------------------------------------------------------------------
+}
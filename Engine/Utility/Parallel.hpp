@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+
+namespace parallel {
+    // Number of threads used by For, defaults to the hardware concurrency.
+    uint32 GetThreadCount();
+
+    // A count of 0 resets to the hardware concurrency.
+    void SetThreadCount(uint32 count);
+
+    // Calls func(index, threadIndex) for every index in [0, count) on the worker threads and waits for all of them.
+    // Indices are handed out dynamically, results must not depend on which thread ran an index.
+    void For(uint32 count, const std::function<void(uint32 index, uint32 threadIndex)> &func);
+}
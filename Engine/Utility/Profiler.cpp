@@ -0,0 +1,208 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+namespace profiler {
+    // Events per thread, older events are overwritten.
+    constexpr uint64 bufferCapacity = 1 << 15;
+    constexpr uint64 bufferMask = bufferCapacity - 1;
+
+    // Written by one thread at a time, read by EndFrame and ExportChromeTrace.
+    struct ThreadBuffer {
+        std::unique_ptr<Event[]> events = std::make_unique<Event[]>(bufferCapacity);
+        std::atomic<uint64> head = 0;
+        // Index of the first event EndFrame has not collected yet.
+        uint64 collected = 0;
+        uint32 threadIndex = 0;
+    };
+
+    // Buffers outlive their threads, since parallel::For starts new threads on every call a finished thread hands its
+    // buffer to the next one.
+    static std::mutex s_BufferMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer> > s_Buffers;
+    static std::vector<ThreadBuffer *> s_FreeBuffers;
+
+    static const auto s_Epoch = std::chrono::steady_clock::now();
+
+    struct FrameHistory {
+        float ms[historySize] = {};
+        uint32 lastCount = 0;
+    };
+
+    static std::unordered_map<string, FrameHistory> s_Histories;
+    static std::vector<ScopeStatistics> s_Statistics;
+    static uint32 s_FrameIndex = 0;
+    static int64 s_FrameStart = 0;
+
+    //------------------------------------------------------------------------------------------
+
+    class ThreadSlot {
+    public:
+        ~ThreadSlot() {
+            if (m_Buffer) {
+                std::lock_guard lock(s_BufferMutex);
+                s_FreeBuffers.push_back(m_Buffer);
+            }
+        }
+
+        ThreadBuffer &Get() {
+            if (!m_Buffer) {
+                std::lock_guard lock(s_BufferMutex);
+                if (!s_FreeBuffers.empty()) {
+                    m_Buffer = s_FreeBuffers.back();
+                    s_FreeBuffers.pop_back();
+                } else {
+                    m_Buffer = s_Buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+                    m_Buffer->threadIndex = s_Buffers.size() - 1;
+                }
+            }
+            return *m_Buffer;
+        }
+
+    private:
+        ThreadBuffer *m_Buffer = nullptr;
+    };
+
+    static thread_local ThreadSlot t_Slot;
+
+    //------------------------------------------------------------------------------------------
+
+    // Copies the events from first on that are still in the buffer.
+    static void
+    ReadEvents(const ThreadBuffer &buffer, uint64 first, std::vector<Event> &events) {
+        const uint64 end = buffer.head.load(std::memory_order_acquire);
+        first = std::max(first, end > bufferCapacity ? end - bufferCapacity : 0);
+
+        const size_t offset = events.size();
+        for (uint64 i = first; i < end; ++i) {
+            events.push_back(buffer.events[i & bufferMask]);
+        }
+
+        // The owning thread may have overwritten the oldest events while they were copied.
+        const uint64 after = buffer.head.load(std::memory_order_acquire);
+        const uint64 valid = after + 1 > bufferCapacity ? after + 1 - bufferCapacity : 0;
+        if (valid > first) {
+            const size_t overwritten = std::min(valid - first, end - first);
+            events.erase(events.begin() + offset, events.begin() + offset + overwritten);
+        }
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    SetEnabled(const bool enabled) {
+        details::enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    int64
+    Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_Epoch).count();
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    Record(const char *name, const int64 start, const int64 end) {
+        ThreadBuffer &buffer = t_Slot.Get();
+        const uint64 head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head & bufferMask] = {name, start, end};
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    void
+    EndFrame() {
+        const int64 now = Now();
+        if (!IsEnabled()) {
+            s_FrameStart = now;
+            return;
+        }
+        Record("Frame", s_FrameStart, now);
+        s_FrameStart = now;
+
+        std::vector<Event> events;
+        {
+            std::lock_guard lock(s_BufferMutex);
+            for (const auto &buffer: s_Buffers) {
+                ReadEvents(*buffer, buffer->collected, events);
+                buffer->collected = buffer->head.load(std::memory_order_acquire);
+            }
+        }
+
+        const uint32 frame = s_FrameIndex++ % historySize;
+        for (auto &[name, history]: s_Histories) {
+            history.ms[frame] = 0.0f;
+            history.lastCount = 0;
+        }
+        for (const Event &event: events) {
+            FrameHistory &history = s_Histories[event.name];
+            history.ms[frame] += static_cast<float>(event.end - event.start) * 1e-6f;
+            history.lastCount++;
+        }
+
+        // Scopes that have not run for a whole history are dropped.
+        std::erase_if(s_Histories, [](const auto &entry) {
+            return std::all_of(std::begin(entry.second.ms), std::end(entry.second.ms), [](const float ms) {
+                return ms == 0.0f;
+            }) && entry.second.lastCount == 0;
+        });
+
+        s_Statistics.clear();
+        const uint32 frameCount = std::min(s_FrameIndex, historySize);
+        for (const auto &[name, history]: s_Histories) {
+            ScopeStatistics &statistics = s_Statistics.emplace_back();
+            statistics.name = name;
+            statistics.lastMs = history.ms[frame];
+            statistics.lastCount = history.lastCount;
+            for (uint32 i = 0; i < frameCount; ++i) {
+                statistics.averageMs += history.ms[i];
+                statistics.maxMs = std::max(statistics.maxMs, history.ms[i]);
+            }
+            statistics.averageMs /= static_cast<float>(frameCount);
+        }
+        std::sort(s_Statistics.begin(), s_Statistics.end(), [](const ScopeStatistics &a, const ScopeStatistics &b) {
+            return a.averageMs > b.averageMs;
+        });
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    const std::vector<ScopeStatistics> &
+    GetScopeStatistics() {
+        return s_Statistics;
+    }
+
+    //------------------------------------------------------------------------------------------
+
+    bool
+    ExportChromeTrace(const std::string &path) {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Failed to write trace \"" << path << "\"\n";
+            return false;
+        }
+
+        file << std::fixed << std::setprecision(3);
+        file << "{\"traceEvents\":[\n";
+        bool first = true;
+        std::lock_guard lock(s_BufferMutex);
+        for (const auto &buffer: s_Buffers) {
+            std::vector<Event> events;
+            ReadEvents(*buffer, 0, events);
+            for (const Event &event: events) {
+                file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                        << buffer->threadIndex << ",\"ts\":" << static_cast<double>(event.start) * 1e-3
+                        << ",\"dur\":" << static_cast<double>(event.end - event.start) * 1e-3 << "}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+
+// Scoped CPU timers. Every thread records into its own ring buffer, so timing a scope costs two clock reads and a store.
+// While profiling is disabled a scope costs a single load, builds without VOX_ENABLE_PROFILER compile scopes out.
+namespace profiler {
+    // Times in nanoseconds since the profiler started.
+    struct Event {
+        const char *name = nullptr;
+        int64 start = 0;
+        int64 end = 0;
+    };
+
+    // Time spent in a scope per frame over the last historySize frames, summed over all threads.
+    struct ScopeStatistics {
+        string name;
+        float lastMs = 0.0f;
+        float averageMs = 0.0f;
+        float maxMs = 0.0f;
+        uint32 lastCount = 0;
+    };
+
+    constexpr uint32 historySize = 120;
+
+    namespace details {
+        inline std::atomic<bool> enabled = false;
+    }
+
+    inline bool
+    IsEnabled() {
+        return details::enabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool enabled);
+
+    int64 Now();
+
+    // name must outlive the profiler, scopes use string literals.
+    void Record(const char *name, int64 start, int64 end);
+
+    // Collects the events recorded since the last call into the statistics and records a frame event. Call once per
+    // frame from one thread.
+    void EndFrame();
+
+    // Sorted by average time, slowest first.
+    const std::vector<ScopeStatistics> &GetScopeStatistics();
+
+    // Writes every event still held by the ring buffers in the Chrome trace event format, to open in chrome://tracing
+    // or Perfetto.
+    bool ExportChromeTrace(const std::string &path);
+
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(const char *name) : m_Name(IsEnabled() ? name : nullptr) {
+            if (m_Name) m_Start = Now();
+        }
+
+        ~ScopedTimer() {
+            if (m_Name) Record(m_Name, m_Start, Now());
+        }
+
+        NON_COPYABLE(ScopedTimer)
+
+    private:
+        const char *m_Name;
+        int64 m_Start = 0;
+    };
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef VOX_ENABLE_PROFILER
+// Times the rest of the enclosing scope.
+#define PROFILE_SCOPE(name) const profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
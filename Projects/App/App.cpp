@@ -10,6 +10,9 @@
 #include "Render/GraphicsNode.hpp"
 #include "Render/Shader/Shader.hpp"
 #include "Render/Renderer.hpp"
+#include "Render/BeamPrepass.hpp"
+#include "Render/PostProcess.hpp"
+#include "Render/ResolutionController.hpp"
 #include "Render/Shader/StorageBuffer.hpp"
 
 #include "DataStructures/BrickMap.hpp"
@@ -20,7 +23,11 @@
 
 #include "Render/Model/ObjLoader.hpp"
 #include "Render/Model/Voxelizer.hpp"
+#include "Render/Lighting/OcclusionBaker.hpp"
+#include "Render/Lighting/RadianceCache.hpp"
+#include "Render/Lighting/SunShadowBaker.hpp"
 #include "Render/Debug.hpp"
+#include "Utility/Profiler.hpp"
 
 bool
 App::Open() {
@@ -87,6 +94,9 @@ App::Run() {
 
     BrickMap brickMap = Voxelize(model, m_Subdivisions, 0.1f);
     //, math::Color(0xFFFFFFFF)); //octree.CreateBrickMap(0.1f);
+    // Neighbouring cells and bricks share cache lines, the shader reads the grid in the same layout.
+    brickMap.SetGridLayout(BrickMap::GridLayout::Tiled);
+    brickMap.SortBricks();
     brickMap.PrintByteSize();
     //brickMap.PrintByteSize();
     ObjLoader::Get().Remove(m_ModelPath);
@@ -96,13 +106,23 @@ App::Run() {
 
     Renderer renderer;
     renderer.SetBrickMap(&brickMap);
+    GpuTimerPool &gpuTimers = renderer.GetGpuTimers();
+    m_Inspector.SetGpuTimers(&gpuTimers);
+    m_Inspector.SetTraversalStatistics(&renderer.GetTraversalStatistics());
 
     StorageBuffer<uint32> &gridBuffer = renderer.GetBrickGridBuffer();
     StorageBuffer<BrickMap::Brick> &brickBuffer = renderer.GetSolidMaskBuffer();
+    StorageBuffer<uint32> &colorPointerBuffer = renderer.GetColorPointerBuffer();
     StorageBuffer<BrickMap::BrickTexture> &textureBuffer = renderer.GetBrickTextureBuffer();
+    StorageBuffer<BrickMap::BrickLod> &lodBuffer = renderer.GetBrickLodBuffer();
+    StorageBuffer<BrickMap::BrickAttributes> &attributeBuffer = renderer.GetAttributeBuffer();
     gridBuffer.Upload(brickMap.GetGrid());
     brickBuffer.Upload(brickMap.GetBricks());
+    colorPointerBuffer.Upload(brickMap.GetColorPointers());
     textureBuffer.Upload(brickMap.GetBrickTextures());
+    lodBuffer.Upload(brickMap.GetBrickLods());
+    // Voxelized models always have attributes.
+    attributeBuffer.Upload(brickMap.GetBrickAttributes());
 
     int32 windowWidth, windowHeight;
     m_Window.GetSize(windowWidth, windowHeight);
@@ -116,23 +136,126 @@ App::Run() {
 
     m_Inspector.AddBool("Show steps");
     m_Inspector.AddBool("Show normals");
+    m_Inspector.AddBool("Show occlusion");
+    m_Inspector.AddBool("Collect statistics");
+    m_Inspector.AddBool("Reprojection");
+    m_Inspector.AddBool("Beam pre-pass");
+    m_Inspector.AddBool("Checkerboard");
+    m_Inspector.AddBool("Variable rate");
+    m_Inspector.AddBool("Dynamic resolution");
+    m_Inspector.AddFloat("Frame budget (ms)", ResolutionController::Settings().budgetMs, 0.5f);
+    // 0 is RGBA32F, 1 RGBA8 and 2 R11G11B10F, see TextureFormat.
+    m_Inspector.AddInt("Render target format", 0);
+    m_Inspector.AddBool("Post process");
+    m_Inspector.AddBool("Fused post process");
+    m_Inspector.AddFloat("Exposure", PostProcess::Settings().exposure, 0.05f);
     m_Inspector.AddInt("Radius", 1);
+    m_Inspector.AddFloat("LOD bias", 1.0f, 0.05f);
 
     m_Inspector.AddButton("Recompile shader", [&renderer] {
         renderer.GetRaytraceShader() = ShaderManager::Get().Load("shaders/rtBrickmap.comp");
     });
 
+    // Edits only re-bake around themselves once the whole map has been baked.
+    OcclusionBaker occlusionBaker({});
+    bool occlusionBaked = false;
+    m_Inspector.AddButton("Bake occlusion", [&] {
+        const auto bakeStart = std::chrono::high_resolution_clock::now();
+        occlusionBaker.BakeAll(brickMap);
+        attributeBuffer.SetData(0, brickMap.GetBrickAttributes());
+        occlusionBaked = true;
+
+        const auto &statistics = occlusionBaker.GetStatistics();
+        std::cout << "Baked occlusion of " << statistics.exposedVoxels << " voxels with " << statistics.rayCount
+                << " rays in " << std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - bakeStart).
+                count() << " s\n";
+    });
+
+    SunShadowBaker sunShadowBaker({});
+    bool sunShadowsBaked = false;
+    m_Inspector.AddButton("Bake sun shadows", [&] {
+        sunShadowBaker.Bake(brickMap);
+        attributeBuffer.SetData(0, brickMap.GetBrickAttributes());
+        sunShadowsBaked = true;
+        renderer.SetSunShadows(true);
+    });
+
+    // Probes are refined a little every frame while indirect light is enabled.
+    RadianceCache radianceCache({});
+    radianceCache.Build(brickMap);
+    StorageBuffer<uint32> &probeCellBuffer = renderer.GetProbeCellBuffer();
+    StorageBuffer<RadianceCache::ProbeIrradiance> &probeBuffer = renderer.GetProbeBuffer();
+    probeCellBuffer.Upload(radianceCache.GetProbeCells());
+    probeBuffer.Upload(radianceCache.GetProbeIrradiance());
+    m_Inspector.AddBool("Indirect light");
+    m_Inspector.AddInt("Probe rays", 8192);
+
+    // Edits only refresh the pyramid around themselves.
+    BeamPrepass beamPrepass({});
+    beamPrepass.Build(brickMap);
+    StorageBuffer<uint32> &occupancyBuffer = renderer.GetOccupancyBuffer();
+    occupancyBuffer.Upload(beamPrepass.GetPyramid());
+
+    // CPU work after an edit of the inclusive region around it, the results are uploaded with the edited bricks so the
+    // GPU timer of the upload does not count the bakes.
+    struct EditRefresh {
+        std::vector<uint32> attributeBricks;
+        std::vector<uint32> probes;
+    };
+    const auto refreshAround = [&](const ivec3 &min, const ivec3 &max) {
+        PROFILE_SCOPE("Edit bake");
+        EditRefresh refresh;
+        // Voxels around the edit see different neighbours.
+        refresh.attributeBricks = brickMap.EstimateNormals(min - 1, max + 1);
+        if (occlusionBaked) {
+            const std::vector<uint32> bricks = occlusionBaker.BakeAround(brickMap, min, max);
+            refresh.attributeBricks.insert(refresh.attributeBricks.end(), bricks.begin(), bricks.end());
+        }
+        if (sunShadowsBaked) {
+            const std::vector<uint32> bricks = sunShadowBaker.Update(brickMap, min, max);
+            refresh.attributeBricks.insert(refresh.attributeBricks.end(), bricks.begin(), bricks.end());
+        }
+        std::sort(refresh.attributeBricks.begin(), refresh.attributeBricks.end());
+        refresh.attributeBricks.erase(std::unique(refresh.attributeBricks.begin(), refresh.attributeBricks.end()),
+                                      refresh.attributeBricks.end());
+        refresh.probes = radianceCache.Invalidate(brickMap, min, max);
+        beamPrepass.Update(brickMap, min, max);
+        return refresh;
+    };
+    const auto uploadRefresh = [&](const EditRefresh &refresh) {
+        for (const uint32 brickPointer: refresh.attributeBricks)
+            attributeBuffer.SetData(brickPointer, brickMap.GetBrickAttributes()[brickPointer]);
+        // New probes are appended, freed slots are reused.
+        for (const uint32 probe: refresh.probes) {
+            if (probe < probeBuffer.GetSize())
+                probeBuffer.SetData(probe, radianceCache.GetProbeIrradiance(probe));
+            else
+                probeBuffer.PushBack(radianceCache.GetProbeIrradiance(probe));
+        }
+        probeCellBuffer.SetData(0, radianceCache.GetProbeCells());
+        occupancyBuffer.SetData(0, beamPrepass.GetPyramid());
+    };
+
+    // Fed with the GPU time of the passes traced at the render resolution, which vsync does not hide. Uploads and
+    // overlays cost the same at any scale and would only make edits lower it.
+    ResolutionController resolutionController({});
+    uint32 controlledFrameCount = 0;
+
     float deltaSeconds = 0.0f;
     glfwSwapInterval(1);
 
     while (m_Window.IsOpen()) {
         start = std::chrono::high_resolution_clock::now();
-        m_Window.GetSize(windowWidth, windowHeight);
-        inputManager.BeginFrame();
-        m_Window.Update();
-
-        if (inputManager.mouse.GetHeld(Input::MouseButton::right))
-            firstPersonCamera.Update(deltaSeconds);
+        gpuTimers.BeginFrame();
+        {
+            PROFILE_SCOPE("Input");
+            m_Window.GetSize(windowWidth, windowHeight);
+            inputManager.BeginFrame();
+            m_Window.Update();
+
+            if (inputManager.mouse.GetHeld(Input::MouseButton::right))
+                firstPersonCamera.Update(deltaSeconds);
+        }
 
         if (inputManager.keyboard.GetPressed(Input::Key::Escape))
             break;
@@ -147,10 +270,52 @@ App::Run() {
 
         renderer.SetShowSteps(m_Inspector.GetBool("Show steps"));
         renderer.SetShowNormals(m_Inspector.GetBool("Show normals"));
+        renderer.SetShowOcclusion(m_Inspector.GetBool("Show occlusion"));
+        renderer.SetCollectStatistics(m_Inspector.GetBool("Collect statistics"));
+        renderer.SetLodBias(m_Inspector.GetFloat("LOD bias"));
+        renderer.SetReprojection(m_Inspector.GetBool("Reprojection"));
+        renderer.SetBeamPrepass(m_Inspector.GetBool("Beam pre-pass"));
+        renderer.SetCheckerboard(m_Inspector.GetBool("Checkerboard"));
+        renderer.SetVariableRate(m_Inspector.GetBool("Variable rate"));
+        const int32 format = std::clamp(m_Inspector.GetInt("Render target format"), 0, 2);
+        renderer.SetRenderTargetFormat(static_cast<TextureFormat>(format));
+        renderer.SetPostProcess(m_Inspector.GetBool("Post process"));
+        renderer.SetFusedPostProcess(m_Inspector.GetBool("Fused post process"));
+        renderer.SetExposure(m_Inspector.GetFloat("Exposure"));
+        if (m_Inspector.GetBool("Dynamic resolution")) {
+            if (resolutionController.GetSettings().budgetMs != m_Inspector.GetFloat("Frame budget (ms)")) {
+                ResolutionController::Settings settings;
+                settings.budgetMs = m_Inspector.GetFloat("Frame budget (ms)");
+                resolutionController = ResolutionController(settings);
+            }
+            // Each collected frame is fed once, frames without new results would repeat the last one.
+            if (gpuTimers.GetCollectedFrameCount() != controlledFrameCount) {
+                controlledFrameCount = gpuTimers.GetCollectedFrameCount();
+                float gpuMs = 0.0f;
+                for (const GpuTimerPool::PassStatistics &pass: gpuTimers.GetStatistics()) {
+                    if (Renderer::IsScaledPass(pass.name))
+                        gpuMs += pass.lastMs;
+                }
+                renderer.SetResolutionScale(resolutionController.Update(gpuMs));
+            }
+        } else {
+            resolutionController.Reset();
+            renderer.SetResolutionScale(1.0f);
+        }
+
+        const bool indirectLight = m_Inspector.GetBool("Indirect light");
+        renderer.SetIndirectLight(indirectLight);
+        if (indirectLight) {
+            PROFILE_SCOPE("Probes");
+            for (const uint32 probe: radianceCache.Update(brickMap, m_Inspector.GetInt("Probe rays")))
+                probeBuffer.SetData(probe, radianceCache.GetProbeIrradiance(probe));
+        }
 
         renderer.SetDimensions(windowWidth, windowHeight);
+        m_Inspector.AddVec2("Trace resolution", renderer.GetTraceDimensions());
         renderer.Render();
         if (inputManager.mouse.GetPressed(Input::MouseButton::left)) {
+            PROFILE_SCOPE("Edit");
             const bool actionDelete = inputManager.keyboard.GetHeld(Input::Key::Space);
             //std::cout << "Sent ray\n";
             const math::Ray ray = {firstPersonCamera.GetPosition(), firstPersonCamera.GetForward()};
@@ -187,45 +352,66 @@ App::Run() {
                             }
                         }
                     }
-                    for (auto gridCell: removedBricks) {
-                        auto &grid = brickMap.GetGrid();
-                        auto &bricks = brickMap.GetBricks();
-                        auto &brickTextures = brickMap.GetBrickTextures();
-
-                        const uint32 removedBrickIndex = grid[gridCell];
-                        if (removedBrickIndex == EMPTY_BRICK) continue;
-
-                        // Set GPU data.
-                        gridBuffer.SetData(bricks.back().parent, removedBrickIndex);
-                        gridBuffer.SetData(gridCell, EMPTY_BRICK);
+                    // Bricks are removed first and their final state uploaded, a slot can change more than once.
+                    std::vector<uint32> dirtyCells, dirtyBricks, dirtyTextures;
+                    uint32 removedBrickCount = 0, removedTextureCount = 0;
+                    for (const uint32 gridCell: removedBricks) {
+                        const auto removed = brickMap.RemoveBrick(gridCell);
+                        if (!removed) continue;
+
+                        removedBrickCount++;
+                        dirtyCells.push_back(gridCell);
+                        if (removed->movedCellIndex != EMPTY_BRICK) {
+                            dirtyCells.push_back(removed->movedCellIndex);
+                            dirtyBricks.push_back(removed->brickIndex);
+                        }
+                        if (removed->textureIndex != EMPTY_BRICK) {
+                            removedTextureCount++;
+                            dirtyTextures.push_back(removed->textureIndex);
+                            dirtyBricks.insert(dirtyBricks.end(), removed->remappedBricks.begin(),
+                                               removed->remappedBricks.end());
+                        }
+                    }
+                    const EditRefresh refresh = refreshAround(hitResult.position - radius,
+                                                              hitResult.position + radius - 1);
 
-                        brickBuffer.SetData(removedBrickIndex, bricks.back());
+                    gpuTimers.Begin("Upload");
+                    for (uint32 i = 0; i < removedBrickCount; ++i) {
                         brickBuffer.PopBack();
-
-                        textureBuffer.SetData(removedBrickIndex, brickTextures.back());
+                        colorPointerBuffer.PopBack();
+                        lodBuffer.PopBack();
+                        attributeBuffer.PopBack();
+                    }
+                    for (uint32 i = 0; i < removedTextureCount; ++i)
                         textureBuffer.PopBack();
 
-                        // Set CPU data.
-                        grid[bricks.back().parent] = removedBrickIndex;
-                        grid[gridCell] = EMPTY_BRICK;
+                    for (const uint32 gridCell: dirtyCells)
+                        gridBuffer.SetData(gridCell, brickMap.GetGrid()[gridCell]);
+                    for (const uint32 brickPointer: dirtyBricks) {
+                        if (brickPointer >= brickMap.GetBricks().size()) continue;
 
-                        bricks[removedBrickIndex] = bricks.back();
-                        bricks.pop_back();
-
-                        brickTextures[removedBrickIndex] = brickTextures.back();
-                        brickTextures.pop_back();
+                        brickBuffer.SetData(brickPointer, brickMap.GetBricks()[brickPointer]);
+                        colorPointerBuffer.SetData(brickPointer, brickMap.GetColorPointers()[brickPointer]);
+                        lodBuffer.SetData(brickPointer, brickMap.GetBrickLods()[brickPointer]);
+                        attributeBuffer.SetData(brickPointer, brickMap.GetBrickAttributes()[brickPointer]);
+                    }
+                    for (const uint32 colorPointer: dirtyTextures) {
+                        if (colorPointer < brickMap.GetBrickTextures().size())
+                            textureBuffer.SetData(colorPointer, brickMap.GetBrickTextures()[colorPointer]);
                     }
                     for (auto gridCell: modifiedBricks) {
                         const uint32 brickPointer = brickMap.GetGrid()[gridCell];
                         if (brickPointer == EMPTY_BRICK) continue;
 
-                        const BrickMap::Brick &brick = brickMap.GetBricks()[brickPointer];
-                        const BrickMap::BrickTexture &brickTexture = brickMap.GetBrickTextures()[brick.
-                            colorPointer];
+                        const uint32 colorPointer = brickMap.GetColorPointers()[brickPointer];
 
-                        brickBuffer.SetData(brickPointer, brick);
-                        textureBuffer.SetData(brick.colorPointer, brickTexture);
+                        brickBuffer.SetData(brickPointer, brickMap.GetBricks()[brickPointer]);
+                        textureBuffer.SetData(colorPointer, brickMap.GetBrickTextures()[colorPointer]);
+                        lodBuffer.SetData(brickPointer, brickMap.GetBrickLods()[brickPointer]);
                     }
+                    uploadRefresh(refresh);
+                    gpuTimers.End();
+                    renderer.InvalidateHistory();
                 } else {
                     const math::Color color = brickMap.GetVoxel(hitResult.position).value();
                     std::vector<uint32> newBricks;
@@ -253,24 +439,32 @@ App::Run() {
                             }
                         }
                     }
+                    const EditRefresh refresh = refreshAround(insertPosition - radius, insertPosition + radius - 1);
+
+                    gpuTimers.Begin("Upload");
                     for (const auto gridCell: newBricks) {
                         const uint32 brickPointer = brickMap.GetGrid()[gridCell];
-                        const BrickMap::Brick &brick = brickMap.GetBricks()[brickPointer];
-                        const BrickMap::BrickTexture &brickTexture = brickMap.GetBrickTextures()[brick.colorPointer];
+                        const uint32 colorPointer = brickMap.GetColorPointers()[brickPointer];
 
                         gridBuffer.SetData(gridCell, brickPointer);
-                        brickBuffer.PushBack(brick);
-                        textureBuffer.PushBack(brickTexture);
+                        brickBuffer.PushBack(brickMap.GetBricks()[brickPointer]);
+                        colorPointerBuffer.PushBack(colorPointer);
+                        textureBuffer.PushBack(brickMap.GetBrickTextures()[colorPointer]);
+                        lodBuffer.PushBack(brickMap.GetBrickLods()[brickPointer]);
+                        attributeBuffer.PushBack(brickMap.GetBrickAttributes()[brickPointer]);
                     }
 
                     for (const auto gridCell: modifiedBricks) {
                         const uint32 brickPointer = brickMap.GetGrid()[gridCell];
-                        const BrickMap::Brick &brick = brickMap.GetBricks()[brickPointer];
-                        const BrickMap::BrickTexture &brickTexture = brickMap.GetBrickTextures()[brick.colorPointer];
+                        const uint32 colorPointer = brickMap.GetColorPointers()[brickPointer];
 
-                        brickBuffer.SetData(brickPointer, brick);
-                        textureBuffer.SetData(brick.colorPointer, brickTexture);
+                        brickBuffer.SetData(brickPointer, brickMap.GetBricks()[brickPointer]);
+                        textureBuffer.SetData(colorPointer, brickMap.GetBrickTextures()[colorPointer]);
+                        lodBuffer.SetData(brickPointer, brickMap.GetBrickLods()[brickPointer]);
                     }
+                    uploadRefresh(refresh);
+                    gpuTimers.End();
+                    renderer.InvalidateHistory();
                 }
             }
         }
@@ -288,10 +482,26 @@ App::Run() {
         }
 
 
-        Debug::RenderDebug(firstPersonCamera.GetProjView());
-        Debug::ClearQueue();
+        {
+            PROFILE_SCOPE("Debug draw");
+            gpuTimers.Begin("Debug draw");
+            Debug::RenderDebug(firstPersonCamera.GetProjView());
+            Debug::ClearQueue();
+            gpuTimers.End();
+        }
 
-        m_Window.SwapBuffers();
+        {
+            PROFILE_SCOPE("ImGui");
+            gpuTimers.Begin("ImGui");
+            m_Window.RenderUi();
+            gpuTimers.End();
+        }
+
+        {
+            PROFILE_SCOPE("Swap buffers");
+            m_Window.SwapBuffers();
+        }
+        profiler::EndFrame();
 
         end = std::chrono::high_resolution_clock::now();
         auto frameDuration =
@@ -1,35 +1,124 @@
 #include "Terrain.hpp"
-#include "Math/PerlinNoise.hpp"
+#include "Math/PerlinNoiseBatch.hpp"
 #include "Math/Random.hpp"
+#include "Utility/Parallel.hpp"
+#include "Utility/Profiler.hpp"
+
+// Voxel columns in a brick column.
+constexpr uint32 columnSize = BRICK_DIMENSIONS * BRICK_DIMENSIONS;
+
+static math::Color
+GrassColor() {
+    const uint8 gr = 24 + static_cast<uint8>(math::random::RandomFloat() * 24);
+    const uint8 gg = 124 + static_cast<uint8>(math::random::RandomFloat() * 44);
+    const uint8 gb = 24 + static_cast<uint8>(math::random::RandomFloat() * 24);
+    return {gr, gg, gb, 255};
+}
+
+static math::Color
+DirtColor() {
+    const uint8 dr = 80 + static_cast<uint8>(math::random::RandomFloat() * 24);
+    const uint8 dg = 30 + static_cast<uint8>(math::random::RandomFloat() * 24);
+    const uint8 db = 10 + static_cast<uint8>(math::random::RandomFloat() * 12);
+    return {dr, dg, db, 255};
+}
 
 BrickMap
-GenerateTerrain(const uint32 dims, const float invScale) {
+GenerateTerrain(const uint32 dims, const float invScale, const uint32 seed) {
+    PROFILE_SCOPE("GenerateTerrain");
     constexpr float heightScale = 96.0f;
     BrickMap bm(vec3(), ivec3(dims, dims / 2, dims), 0.1f);
-    siv::PerlinNoise heightMap;
-
-
-    for (uint32 z = 0; z < dims; ++z) {
-        for (uint32 x = 0; x < dims; ++x) {
-            const float fx = static_cast<float>(x) / invScale;
-            const float fz = static_cast<float>(z) / invScale;
-            const float height = heightMap.octave2D_01(fx, fz, 8);
-            int y = height * (height * 1.2) * heightScale;
-
-            const uint8 gr = 24 + static_cast<uint8>(math::random::RandomFloat() * 24);
-            const uint8 gg = 124 + static_cast<uint8>(math::random::RandomFloat() * 44);
-            const uint8 gb = 24 + static_cast<uint8>(math::random::RandomFloat() * 24);
-            const math::Color grass = {gr, gg, gb, 255};
-            bm.Insert({x, y, z}, grass);
-            while (y-- > 0) {
-                const uint8 dr = 80 + static_cast<uint8>(math::random::RandomFloat() * 24);
-                const uint8 dg = 30 + static_cast<uint8>(math::random::RandomFloat() * 24);
-                const uint8 db = 10 + static_cast<uint8>(math::random::RandomFloat() * 12);
-                const math::Color dirt = {dr, dg, db, 255};
-                bm.Insert({x, y, z}, dirt);
+    const math::PerlinNoiseBatch heightMap(siv::PerlinNoise{seed});
+
+    const ivec3 &gridSize = bm.GetDimensions();
+    const int maxHeight = static_cast<int>(dims / 2) - 1;
+    const uint32 brickColumns = gridSize.x * gridSize.z;
+
+    // Height of the top voxel in every voxel column, grouped by brick column. -1 means the column is empty.
+    std::vector<int> heights(brickColumns * columnSize, -1);
+    std::vector<uint32> brickCounts(brickColumns);
+    std::vector<int> minHeights(brickColumns);
+
+    parallel::For(brickColumns, [&](const uint32 column, uint32) {
+        const uint32 originX = column % gridSize.x * BRICK_DIMENSIONS;
+        const uint32 originZ = column / gridSize.x * BRICK_DIMENSIONS;
+        int *columnHeights = &heights[column * columnSize];
+        int top = -1, bottom = maxHeight;
+
+        // Brick rows are as wide as a noise batch.
+        static_assert(BRICK_DIMENSIONS == math::PerlinNoiseBatch::batchSize);
+        float sampleX[BRICK_DIMENSIONS], sampleZ[BRICK_DIMENSIONS], rowHeights[BRICK_DIMENSIONS];
+        for (uint32 z = 0; z < BRICK_DIMENSIONS; ++z) {
+            for (uint32 x = 0; x < BRICK_DIMENSIONS; ++x) {
+                sampleX[x] = static_cast<float>(originX + x) / invScale;
+                sampleZ[x] = static_cast<float>(originZ + z) / invScale;
+            }
+            heightMap.Octave2D01(sampleX, sampleZ, 8, rowHeights);
+
+            for (uint32 x = 0; x < BRICK_DIMENSIONS; ++x) {
+                if (originX + x >= dims || originZ + z >= dims) {
+                    bottom = -1;
+                    continue;
+                }
+                const float height = rowHeights[x];
+                const int y = height * (height * 1.2) * heightScale;
+
+                columnHeights[x + z * BRICK_DIMENSIONS] = y;
+                top = std::max(top, std::min(y, maxHeight));
+                bottom = std::min(bottom, y);
             }
         }
+
+        brickCounts[column] = top < 0 ? 0 : top / BRICK_DIMENSIONS + 1;
+        minHeights[column] = bottom;
+    });
+
+    // Bricks are laid out column by column so the result does not depend on the thread count.
+    std::vector<uint32> firstBricks(brickColumns);
+    uint32 brickCount = 0;
+    for (uint32 column = 0; column < brickColumns; ++column) {
+        firstBricks[column] = brickCount;
+        brickCount += brickCounts[column];
     }
+    const uint32 firstBrick = bm.AllocateBricks(brickCount);
+
+    parallel::For(brickColumns, [&](const uint32 column, uint32) {
+        // Every brick column has its own random stream.
+        math::random::SetSeed(math::random::FastRandom(seed ^ column * 2654435761u));
+
+        const ivec2 brickPosition(column % gridSize.x, column / gridSize.x);
+        const int *columnHeights = &heights[column * columnSize];
+
+        for (uint32 by = 0; by < brickCounts[column]; ++by) {
+            const uint32 brickIndex = firstBrick + firstBricks[column] + by;
+            bm.PlaceBrick(brickIndex, {brickPosition.x, by, brickPosition.y});
+
+            BrickMap::Brick &brick = bm.GetBricks()[brickIndex];
+            BrickMap::BrickTexture &texture = bm.GetBrickTextures()[brickIndex];
+            const int brickBottom = by * BRICK_DIMENSIONS;
+            const int brickTop = brickBottom + BRICK_DIMENSIONS - 1;
+
+            if (minHeights[column] > brickTop) {
+                // Entirely below the surface.
+                std::fill(std::begin(brick.bitmask), std::end(brick.bitmask), 0xFFFFFFFF);
+                for (auto &voxel: texture.voxels)
+                    voxel = DirtColor();
+            } else {
+                for (uint32 i = 0; i < columnSize; ++i) {
+                    const int height = columnHeights[i];
+                    const int top = std::min(height, brickTop);
+                    for (int y = brickBottom; y <= top; ++y) {
+                        const uint32 voxelIndex = i % BRICK_DIMENSIONS +
+                                                  BRICK_DIMENSIONS * (y - brickBottom + BRICK_DIMENSIONS * (i / BRICK_DIMENSIONS));
+                        brick.Set(voxelIndex, true);
+                        texture.voxels[voxelIndex] = y == height ? GrassColor() : DirtColor();
+                    }
+                }
+            }
+            bm.FinalizeBrick(brickIndex);
+        }
+    });
+    bm.RecountVoxels();
 
     return bm;
 }
@@ -1,4 +1,5 @@
 #pragma once
 #include "DataStructures/BrickMap.hpp"
 
-BrickMap GenerateTerrain(uint32 dims, float invScale = 16.0f);
+// Generates a heightmap terrain, the result only depends on the arguments and not on the thread count.
+BrickMap GenerateTerrain(uint32 dims, float invScale = 16.0f, uint32 seed = 0);
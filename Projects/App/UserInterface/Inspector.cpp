@@ -1,5 +1,8 @@
 #include "Inspector.hpp"
 #include "imgui.h"
+#include "DataStructures/TraversalStatistics.hpp"
+#include "Render/GpuTimer.hpp"
+#include "Utility/Profiler.hpp"
 
 void
 Inspector::Draw() {
@@ -65,4 +68,108 @@ Inspector::Draw() {
     ImGui::Text("FPS: %f", ImGui::GetIO().Framerate);
 
     ImGui::End();
+
+    DrawProfiler();
+}
+
+void
+Inspector::DrawProfiler() {
+    ImGui::SetNextWindowSize({380, 300}, ImGuiCond_FirstUseEver);
+    ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_None);
+
+    if (m_GpuTimers && ImGui::BeginTable("Passes", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("GPU pass");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        for (const GpuTimerPool::PassStatistics &pass: m_GpuTimers->GetStatistics()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(pass.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", pass.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", pass.averageMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", pass.maxMs);
+        }
+        ImGui::EndTable();
+
+        if (m_GpuTimers->GetDroppedFrameCount() > 0)
+            ImGui::Text("Dropped frames: %u", m_GpuTimers->GetDroppedFrameCount());
+        ImGui::Separator();
+    }
+
+    if (m_TraversalStatistics && m_TraversalStatistics->rayCount > 0)
+        DrawTraversalStatistics();
+
+#ifdef VOX_ENABLE_PROFILER
+    bool enabled = profiler::IsEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+        profiler::SetEnabled(enabled);
+    ImGui::SameLine();
+    if (ImGui::Button("Save trace"))
+        profiler::ExportChromeTrace("trace.json");
+
+    if (ImGui::BeginTable("Scopes", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+
+        for (const profiler::ScopeStatistics &scope: profiler::GetScopeStatistics()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(scope.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", scope.lastCount);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", scope.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", scope.averageMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", scope.maxMs);
+        }
+        ImGui::EndTable();
+    }
+#else
+    ImGui::TextUnformatted("Built without VOX_ENABLE_PROFILER.");
+#endif
+
+    ImGui::End();
+}
+
+static void
+PlotHistogram(const char *label, const uint32 (&histogram)[TraversalStatistics::histogramBins]) {
+    // Trailing empty bins are cut so the occupied ones are wide enough to read.
+    uint32 binCount = 1;
+    float values[TraversalStatistics::histogramBins];
+    for (uint32 i = 0; i < TraversalStatistics::histogramBins; ++i) {
+        values[i] = static_cast<float>(histogram[i]);
+        if (histogram[i] != 0)
+            binCount = i + 1;
+    }
+    ImGui::PlotHistogram(label, values, static_cast<int>(binCount), 0, nullptr, 0.0f, FLT_MAX, {0, 60});
+}
+
+void
+Inspector::DrawTraversalStatistics() {
+    const TraversalStatistics &statistics = *m_TraversalStatistics;
+    const float rays = static_cast<float>(statistics.rayCount);
+    ImGui::Text("Rays: %u, hits: %.1f%%", statistics.rayCount, 100.0f * static_cast<float>(statistics.hitCount) / rays);
+    ImGui::Text("Per ray: %.1f coarse steps, %.1f fine steps, %.2f bricks",
+                static_cast<float>(statistics.coarseStepTotal) / rays,
+                static_cast<float>(statistics.fineStepTotal) / rays,
+                static_cast<float>(statistics.bricksEnteredTotal) / rays);
+    ImGui::Text("Unique bricks: %u", statistics.uniqueBricks);
+
+    // Bin i holds the rays with [2^(i-1), 2^i) steps.
+    PlotHistogram("Coarse steps", statistics.coarseSteps);
+    PlotHistogram("Fine steps", statistics.fineSteps);
+    PlotHistogram("Bricks entered", statistics.bricksEntered);
+    ImGui::Separator();
 }
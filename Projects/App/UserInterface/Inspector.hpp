@@ -2,6 +2,9 @@
 #include <functional>
 #include <unordered_map>
 
+class GpuTimerPool;
+struct TraversalStatistics;
+
 struct InspTexture {
     uint32 id = 0;
     int32 width = 0, height = 0;
@@ -90,7 +93,22 @@ public:
         m_Buttons[name] = func;
     }
 
+    // Per pass GPU times are shown in the profiler window.
+    void SetGpuTimers(const GpuTimerPool *timers) {
+        m_GpuTimers = timers;
+    }
+
+    // Shown in the profiler window while the renderer collects them.
+    void SetTraversalStatistics(const TraversalStatistics *statistics) {
+        m_TraversalStatistics = statistics;
+    }
+
 private:
+    // Rolling per scope timings of the profiler.
+    void DrawProfiler();
+
+    void DrawTraversalStatistics();
+
     std::unordered_map<string, int32> m_Ints;
     std::unordered_map<string, bool> m_Bools;
     std::unordered_map<string, InspFloat> m_Floats;
@@ -99,6 +117,8 @@ private:
     std::unordered_map<string, vec4> m_Vec4s;
     std::unordered_map<string, InspTexture> m_Textures;
     std::unordered_map<string, std::function<void()> > m_Buttons;
+    const GpuTimerPool *m_GpuTimers = nullptr;
+    const TraversalStatistics *m_TraversalStatistics = nullptr;
 
     bool m_ShowViewport = true;
 };
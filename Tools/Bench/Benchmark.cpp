@@ -0,0 +1,119 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+BenchmarkResult
+RunBenchmark(const Benchmark &benchmark, const uint32 repetitions) {
+    benchmark.run();
+
+    std::vector<double> times(repetitions);
+    for (double &time: times) {
+        time = benchmark.run();
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.itemCount = benchmark.itemCount;
+    result.repetitions = repetitions;
+    result.medianSeconds = times[times.size() / 2];
+    result.minSeconds = times.front();
+    return result;
+}
+
+bool
+WriteResults(const string &path, const std::vector<BenchmarkResult> &results, const uint32 threadCount) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to write benchmark results \"" << path << "\"\n";
+        return false;
+    }
+
+    file << std::setprecision(9);
+    file << "{\n";
+    file << "  \"threads\": " << threadCount << ",\n";
+    file << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult &result = results[i];
+        file << "    {\"name\": \"" << result.name << "\", \"items\": " << result.itemCount
+                << ", \"repetitions\": " << result.repetitions << ", \"median_s\": " << result.medianSeconds
+                << ", \"min_s\": " << result.minSeconds << ", \"ns_per_item\": " << result.GetNanosecondsPerItem()
+                << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    file << "  ]\n";
+    file << "}\n";
+    return static_cast<bool>(file);
+}
+
+// Value of a field in a benchmark line, empty if the line does not have it.
+static string
+FindField(const string &line, const string &field) {
+    const string key = "\"" + field + "\": ";
+    const size_t start = line.find(key);
+    if (start == string::npos)
+        return {};
+
+    size_t begin = start + key.size();
+    if (line[begin] == '"') {
+        begin++;
+        return line.substr(begin, line.find('"', begin) - begin);
+    }
+    return line.substr(begin, line.find_first_of(",}", begin) - begin);
+}
+
+std::optional<std::vector<BenchmarkResult> >
+ReadResults(const string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to read benchmark results \"" << path << "\"\n";
+        return std::nullopt;
+    }
+
+    std::vector<BenchmarkResult> results;
+    string line;
+    while (std::getline(file, line)) {
+        const string name = FindField(line, "name");
+        if (name.empty())
+            continue;
+
+        try {
+            BenchmarkResult &result = results.emplace_back();
+            result.name = name;
+            result.itemCount = std::stoull(FindField(line, "items"));
+            result.repetitions = std::stoul(FindField(line, "repetitions"));
+            result.medianSeconds = std::stod(FindField(line, "median_s"));
+            result.minSeconds = std::stod(FindField(line, "min_s"));
+        } catch (const std::exception &) {
+            std::cerr << "Failed to parse benchmark results \"" << path << "\"\n";
+            return std::nullopt;
+        }
+    }
+    return results;
+}
+
+uint32
+CompareResults(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline,
+               const double tolerance) {
+    uint32 regressionCount = 0;
+    std::cout << "\nCompared to baseline:\n";
+    for (const BenchmarkResult &result: results) {
+        const auto base = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult &b) {
+            return b.name == result.name;
+        });
+        std::cout << "  " << std::left << std::setw(32) << result.name << std::right;
+        if (base == baseline.end()) {
+            std::cout << "not in baseline\n";
+            continue;
+        }
+
+        const double change = result.GetNanosecondsPerItem() / base->GetNanosecondsPerItem() - 1.0;
+        const bool regressed = change > tolerance;
+        regressionCount += regressed;
+        std::cout << std::showpos << std::fixed << std::setprecision(1) << std::setw(8) << change * 100.0 << "%"
+                << std::noshowpos << (regressed ? "   REGRESSION" : "") << '\n';
+    }
+    return regressionCount;
+}
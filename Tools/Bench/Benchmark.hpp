@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+
+// A benchmark runs one repetition per call and returns the seconds spent in its measured part, so setup that should not
+// be measured can happen in the same call.
+struct Benchmark {
+    string name;
+    // Operations in one repetition, results are reported per operation.
+    uint64 itemCount = 1;
+    std::function<double()> run;
+};
+
+struct BenchmarkResult {
+    string name;
+    uint64 itemCount = 0;
+    uint32 repetitions = 0;
+    double medianSeconds = 0.0;
+    double minSeconds = 0.0;
+
+    double GetNanosecondsPerItem() const { return medianSeconds * 1e9 / static_cast<double>(itemCount); }
+};
+
+// Seconds spent in func.
+template<typename Func>
+double
+Measure(Func &&func) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Keeps the compiler from removing work whose result is otherwise unused.
+template<typename T>
+void
+Consume(const T &value) {
+    static volatile T sink;
+    sink = value;
+}
+
+// Runs one warm up repetition that is not counted, then the given number of repetitions.
+BenchmarkResult RunBenchmark(const Benchmark &benchmark, uint32 repetitions);
+
+// Writes results as JSON with one benchmark per line.
+bool WriteResults(const string &path, const std::vector<BenchmarkResult> &results, uint32 threadCount);
+
+// Reads results written by WriteResults, it is not a general JSON parser.
+std::optional<std::vector<BenchmarkResult> > ReadResults(const string &path);
+
+// Prints the change of every result relative to the baseline. Returns the number of benchmarks that got slower by more
+// than tolerance, a fraction of the baseline time.
+uint32 CompareResults(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline,
+                      double tolerance);
@@ -0,0 +1,664 @@
+#include "Benchmark.hpp"
+#include "App/Terrain.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Math/PerlinNoiseBatch.hpp"
+#include "Math/Random.hpp"
+#include "Math/Ray.hpp"
+#include "Render/BeamPrepass.hpp"
+#include "Render/Camera.hpp"
+#include "Render/Lighting/OcclusionBaker.hpp"
+#include "Render/Lighting/SunShadowBaker.hpp"
+#include "Render/Model/Voxelizer.hpp"
+#include "Render/PostProcess.hpp"
+#include "Render/TemporalReprojection.hpp"
+#include "Render/VariableRateTracer.hpp"
+#include "Utility/Parallel.hpp"
+
+#include <iomanip>
+
+// Reproducible benchmarks of the hot paths. Every benchmark generates its input from fixed seeds, results are written
+// as JSON and can be compared against a baseline written by an earlier run.
+
+constexpr uint32 mapSize = 256;
+constexpr uint32 editCount = 1 << 18;
+constexpr uint32 lookupCount = 1 << 20;
+constexpr uint32 rayCount = 1 << 16;
+constexpr uint32 noiseCount = 1 << 20;
+constexpr int32 frameWidth = 320, frameHeight = 180;
+constexpr uint32 frameCount = 16;
+
+static std::vector<ivec3>
+RandomPositions(const uint32 count, const ivec3 &size, const uint32 seed) {
+    math::random::SetSeed(seed);
+    std::vector<ivec3> positions(count);
+    for (ivec3 &position: positions) {
+        position = ivec3(math::random::FastRandom() % size.x, math::random::FastRandom() % size.y,
+                         math::random::FastRandom() % size.z);
+    }
+    return positions;
+}
+
+static vec3
+RandomDirection() {
+    // Rejection sampling in the unit ball.
+    while (true) {
+        const vec3 v = vec3(math::random::RandomFloat(), math::random::RandomFloat(), math::random::RandomFloat()) *
+                       2.0f - 1.0f;
+        const float length2 = dot(v, v);
+        if (length2 > 1e-4f && length2 <= 1.0f)
+            return v / std::sqrt(length2);
+    }
+}
+
+// Rays start anywhere in the bounds and go in any direction.
+static std::vector<math::Ray>
+RandomRays(const math::BoundingBox &bounds) {
+    math::random::SetSeed(3);
+    std::vector<math::Ray> rays(rayCount);
+    for (math::Ray &ray: rays) {
+        const vec3 t(math::random::RandomFloat(), math::random::RandomFloat(), math::random::RandomFloat());
+        ray = {bounds.min + t * (bounds.max - bounds.min), RandomDirection()};
+    }
+    return rays;
+}
+
+// A pinhole camera above a corner of the bounds looking at its center.
+static std::vector<math::Ray>
+CameraRays(const math::BoundingBox &bounds) {
+    const vec3 eye(bounds.min.x, bounds.max.y * 1.5f, bounds.min.z);
+    const vec3 forward = normalize(bounds.GetCenter() - eye);
+    const vec3 right = normalize(cross(forward, vec3(0.0f, 1.0f, 0.0f)));
+    const vec3 up = cross(right, forward);
+    const uint32 width = static_cast<uint32>(std::sqrt(static_cast<float>(rayCount)));
+
+    std::vector<math::Ray> rays(rayCount);
+    for (uint32 i = 0; i < rayCount; ++i) {
+        const vec2 uv = (vec2(i % width, i / width) + 0.5f) / static_cast<float>(width) * 2.0f - 1.0f;
+        rays[i] = {eye, normalize(forward + uv.x * right * 0.6f + uv.y * up * 0.6f)};
+    }
+    return rays;
+}
+
+// Camera drifting over the terrain by half a voxel and a tenth of a degree per frame.
+static Camera
+SlowCamera(const BrickMap &map, const uint32 frame) {
+    const math::BoundingBox &bounds = map.GetBoundingBox();
+    const vec3 start(bounds.min.x + 2.0f, bounds.max.y * 0.8f, bounds.min.z + 2.0f);
+    const vec3 eye = start + vec3(0.5f, 0.0f, 0.25f) * (map.GetVoxelSize() * static_cast<float>(frame));
+    const float yaw = 0.6f + radians(0.1f) * static_cast<float>(frame);
+    Camera camera;
+    camera.Perspective(0.1f, 1000.0f, static_cast<float>(frameWidth) / frameHeight, radians(60.0f));
+    camera.LookAt(eye, eye + vec3(std::cos(yaw), -0.35f, std::sin(yaw)), vec3(0.0f, 1.0f, 0.0f));
+    return camera;
+}
+
+// A camera above a corner of the bounds looking at its center, most rays cross open space before reaching a brick.
+static Camera
+OverviewCamera(const BrickMap &map) {
+    const math::BoundingBox &bounds = map.GetBoundingBox();
+    const vec3 eye = bounds.GetCenter() + bounds.GetSize() * vec3(-0.6f, 1.5f, -0.6f);
+    Camera camera;
+    camera.Perspective(0.1f, 1000.0f, static_cast<float>(frameWidth) / frameHeight, radians(60.0f));
+    camera.LookAt(eye, bounds.GetCenter(), vec3(0.0f, 1.0f, 0.0f));
+    return camera;
+}
+
+// A dozen small spheres scattered through an otherwise empty map four times the size of the terrain.
+static BrickMap
+SparseSpheres() {
+    constexpr int32 radius = 12;
+    BrickMap map(vec3(0.0f), ivec3(mapSize * 4), 0.1f);
+    for (const ivec3 &center: RandomPositions(12, ivec3(mapSize * 4 - radius * 2), 5)) {
+        for (int32 z = -radius; z <= radius; ++z)
+            for (int32 y = -radius; y <= radius; ++y)
+                for (int32 x = -radius; x <= radius; ++x)
+                    if (x * x + y * y + z * z <= radius * radius)
+                        map.Insert(center + radius + ivec3(x, y, z), math::Color(0xC0C0C0FF));
+    }
+    return map;
+}
+
+// Hit voxel of the primary ray of every pixel, -1 for misses. Rays start at the distance of their tile if a traced
+// beam pre-pass is given.
+static std::vector<ivec3>
+TraceFrame(BrickMap &map, const Camera &camera, const BeamPrepass *beam, TraversalRecorder *recorder = nullptr) {
+    const int32 tileSize = beam ? beam->GetSettings().tileSize : 1;
+    const int32 tileCount = (frameWidth + tileSize - 1) / tileSize;
+    std::vector<ivec3> hits(frameWidth * frameHeight, ivec3(-1));
+    for (int32 y = 0; y < frameHeight; ++y) {
+        for (int32 x = 0; x < frameWidth; ++x) {
+            const vec2 uv = vec2(x, y) / vec2(frameWidth, frameHeight) * 2.0f - 1.0f;
+            const float start = beam ? beam->GetStartDistances()[x / tileSize + y / tileSize * tileCount] : 0.0f;
+            if (const auto hit = map.RayCast(camera.GetPixelRay(uv), 0.0f, recorder, start))
+                hits[x + y * frameWidth] = hit->position;
+        }
+    }
+    return hits;
+}
+
+// UV sphere of radius 1 with segments * segments quads.
+static std::vector<Triangle>
+SphereTriangles(const uint32 segments, const Material *material) {
+    std::vector<Vertex> vertices;
+    for (uint32 i = 0; i <= segments; ++i) {
+        for (uint32 j = 0; j <= segments; ++j) {
+            const float theta = fPI * static_cast<float>(i) / static_cast<float>(segments);
+            const float phi = 2.0f * fPI * static_cast<float>(j) / static_cast<float>(segments);
+            const vec3 p(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            vertices.push_back({p, p, vec2(j, i) / static_cast<float>(segments)});
+        }
+    }
+
+    std::vector<Triangle> triangles;
+    for (uint32 i = 0; i < segments; ++i) {
+        for (uint32 j = 0; j < segments; ++j) {
+            const uint32 a = i * (segments + 1) + j, b = a + 1, c = a + segments + 1, d = c + 1;
+            triangles.emplace_back(vertices[a], vertices[c], vertices[b], material);
+            triangles.emplace_back(vertices[b], vertices[c], vertices[d], material);
+        }
+    }
+    return triangles;
+}
+
+// Perlin height field in [0, 1]^2 with size * size quads.
+static std::vector<Triangle>
+HeightFieldTriangles(const uint32 size, const Material *material) {
+    const siv::PerlinNoise noise(7);
+    std::vector<Vertex> vertices;
+    for (uint32 z = 0; z <= size; ++z) {
+        for (uint32 x = 0; x <= size; ++x) {
+            const vec2 uv = vec2(x, z) / static_cast<float>(size);
+            const float height = static_cast<float>(noise.octave2D_01(uv.x * 4.0, uv.y * 4.0, 4)) * 0.5f;
+            vertices.push_back({vec3(uv.x, height, uv.y), vec3(0.0f, 1.0f, 0.0f), uv});
+        }
+    }
+
+    std::vector<Triangle> triangles;
+    for (uint32 z = 0; z < size; ++z) {
+        for (uint32 x = 0; x < size; ++x) {
+            const uint32 a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+            triangles.emplace_back(vertices[a], vertices[c], vertices[b], material);
+            triangles.emplace_back(vertices[b], vertices[c], vertices[d], material);
+        }
+    }
+    return triangles;
+}
+
+// Voxelizes triangles the way Voxelize does, without its progress output.
+static BrickMap
+VoxelizeTriangles(std::vector<Triangle> triangles, const uint32 subdivisions) {
+    vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (const Triangle &triangle: triangles) {
+        for (uint32 i = 0; i < 3; ++i) {
+            min = glm::min(min, triangle[i].position);
+            max = glm::max(max, triangle[i].position);
+        }
+    }
+    math::BoundingBox bounds(min, max);
+    const vec3 extent = bounds.GetSize();
+    bounds.SetSize(vec3(std::max(std::max(extent.x, extent.y), extent.z)));
+
+    OctreeMesh octree(std::move(triangles), bounds, subdivisions);
+    BrickMap bm(ivec3(octree.GetSize()), 0.1f);
+    octree.Fill(bm);
+    return bm;
+}
+
+static std::vector<Benchmark>
+CreateBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+    const ivec3 editSize(mapSize);
+
+    benchmarks.push_back({"BrickMap.Insert", editCount, [=] {
+        const std::vector<ivec3> positions = RandomPositions(editCount, editSize, 1);
+        BrickMap bm(vec3(0.0f), editSize, 0.1f);
+        return Measure([&] {
+            for (const ivec3 &position: positions)
+                bm.Insert(position, math::Color(0xFF8040FF));
+        });
+    }});
+
+    benchmarks.push_back({"BrickMap.Delete", editCount, [=] {
+        const std::vector<ivec3> positions = RandomPositions(editCount, editSize, 1);
+        BrickMap bm(vec3(0.0f), editSize, 0.1f);
+        for (const ivec3 &position: positions)
+            bm.Insert(position, math::Color(0xFF8040FF));
+        return Measure([&] {
+            for (const ivec3 &position: positions)
+                bm.Delete(position);
+        });
+    }});
+
+    // The terrain is shared by the lookup and ray benchmarks, which do not change it.
+    auto terrain = std::make_shared<BrickMap>(GenerateTerrain(mapSize));
+
+    benchmarks.push_back({"BrickMap.GetVoxel", lookupCount, [=] {
+        const std::vector<ivec3> positions = RandomPositions(lookupCount, ivec3(mapSize, mapSize / 2, mapSize), 2);
+        return Measure([&] {
+            uint32 hitCount = 0;
+            for (const ivec3 &position: positions)
+                hitCount += terrain->GetVoxel(position).has_value();
+            Consume(hitCount);
+        });
+    }});
+
+    // The same terrain with a tiled grid and bricks sorted to follow it.
+    auto tiledTerrain = std::make_shared<BrickMap>(*terrain);
+    tiledTerrain->SetGridLayout(BrickMap::GridLayout::Tiled);
+    tiledTerrain->SortBricks();
+
+    for (const auto &[suffix, map]: {std::pair{"", terrain}, std::pair{".Tiled", tiledTerrain}}) {
+        benchmarks.push_back({string("RayCast.Random") + suffix, rayCount, [=] {
+            const std::vector<math::Ray> rays = RandomRays(map->GetBoundingBox());
+            return Measure([&] {
+                uint32 hitCount = 0;
+                for (const math::Ray &ray: rays)
+                    hitCount += map->RayCast(ray).has_value();
+                Consume(hitCount);
+            });
+        }});
+
+        benchmarks.push_back({string("RayCast.Coherent") + suffix, rayCount, [=] {
+            const std::vector<math::Ray> rays = CameraRays(map->GetBoundingBox());
+            return Measure([&] {
+                uint32 hitCount = 0;
+                for (const math::Ray &ray: rays)
+                    hitCount += map->RayCast(ray).has_value();
+                Consume(hitCount);
+            });
+        }});
+    }
+
+    // Primary rays of a slowly moving camera, traced from scratch every frame or from the reprojected previous frame.
+    // Reports time per pixel.
+    for (const bool reproject: {false, true}) {
+        const char *name = reproject ? "Reprojection.On" : "Reprojection.Off";
+        benchmarks.push_back({name, frameCount * frameWidth * frameHeight, [=] {
+            TemporalReprojection reprojection({});
+            return Measure([&] {
+                for (uint32 frame = 0; frame < frameCount; ++frame) {
+                    if (!reproject)
+                        reprojection.Invalidate();
+                    reprojection.Render(*terrain, SlowCamera(*terrain, frame), frameWidth, frameHeight);
+                }
+            });
+        }});
+    }
+
+    // Primary rays over open scenes, from the grid entry or from the distance the beam pre-pass found for their tile.
+    // The pre-pass is part of the measurement. Reports time per pixel.
+    auto spheres = std::make_shared<BrickMap>(SparseSpheres());
+    for (const auto &[scene, map]: {std::pair{"Terrain", terrain}, std::pair{"Spheres", spheres}}) {
+        for (const bool useBeam: {false, true}) {
+            const string name = string("Beam.") + scene + (useBeam ? ".On" : ".Off");
+            benchmarks.push_back({name, frameWidth * frameHeight, [=] {
+                const Camera camera = OverviewCamera(*map);
+                BeamPrepass beam({});
+                beam.Build(*map);
+                return Measure([&] {
+                    if (useBeam)
+                        beam.Trace(*map, camera, frameWidth, frameHeight);
+                    Consume(TraceFrame(*map, camera, useBeam ? &beam : nullptr).size());
+                });
+            }});
+        }
+    }
+
+    // A frame over the terrain traced at every pixel or at a variable rate, reports time per pixel.
+    for (const bool variableRate: {false, true}) {
+        const char *name = variableRate ? "VariableRate.On" : "VariableRate.Off";
+        benchmarks.push_back({name, frameWidth * frameHeight, [=] {
+            const Camera camera = SlowCamera(*terrain, 0);
+            VariableRateTracer tracer({});
+            return Measure([&] {
+                if (variableRate)
+                    tracer.Render(*terrain, camera, frameWidth, frameHeight);
+                else
+                    tracer.RenderFull(*terrain, camera, frameWidth, frameHeight);
+                Consume(tracer.GetImage()[0].x);
+            });
+        }});
+    }
+
+    // The pixel pipeline after tracing on a terrain frame, separate with the linear colors in RGBA32F and fused with
+    // the tonemapped ones in RGBA8.
+    for (const bool fused: {false, true}) {
+        benchmarks.push_back({fused ? "PostProcess.Fused" : "PostProcess.Separate", frameWidth * frameHeight, [=] {
+            VariableRateTracer tracer({});
+            tracer.RenderFull(*terrain, SlowCamera(*terrain, 0), frameWidth, frameHeight);
+            PostProcess::Settings settings;
+            settings.format = fused ? TextureFormat::Rgba8 : TextureFormat::Rgba32f;
+            settings.fused = fused;
+            PostProcess postProcess(settings);
+            return Measure([&] {
+                postProcess.Apply(tracer.GetImage(), frameWidth, frameHeight);
+                Consume(postProcess.GetImage()[0].x);
+            });
+        }});
+    }
+
+    // Re-baking the occlusion around an edit in the middle of the terrain, reports time per bake.
+    benchmarks.push_back({"Occlusion.BakeAround", 1, [=] {
+        BrickMap map = *terrain;
+        map.EnableAttributes();
+        OcclusionBaker baker({});
+        // On the surface, so the rays see both the ground and the sky.
+        ivec3 center(mapSize / 2, map.GetDimensions().y * BRICK_DIMENSIONS - 1, mapSize / 2);
+        while (center.y > 0 && !map.IsSolid(center))
+            center.y--;
+        return Measure([&] {
+            Consume(baker.BakeAround(map, center - 4, center + 3).size());
+        });
+    }});
+
+    benchmarks.push_back({"SunShadow.Bake", mapSize * mapSize, [=] {
+        BrickMap map = *terrain;
+        map.EnableAttributes();
+        SunShadowBaker baker({});
+        return Measure([&] {
+            baker.Bake(map);
+        });
+    }});
+
+    // Voxelize benchmarks report time per triangle.
+    static const Material material{vec3(0.8f, 0.5f, 0.3f)};
+    auto sphere = std::make_shared<std::vector<Triangle> >(SphereTriangles(128, &material));
+    for (const uint32 subdivisions: {6u, 7u, 8u}) {
+        benchmarks.push_back({"Voxelize.Sphere." + std::to_string(subdivisions), sphere->size(), [=] {
+            std::vector<Triangle> triangles = *sphere;
+            return Measure([&] {
+                Consume(VoxelizeTriangles(std::move(triangles), subdivisions).GetVoxelCount());
+            });
+        }});
+    }
+
+    auto heightField = std::make_shared<std::vector<Triangle> >(HeightFieldTriangles(128, &material));
+    benchmarks.push_back({"Voxelize.HeightField.8", heightField->size(), [=] {
+        std::vector<Triangle> triangles = *heightField;
+        return Measure([&] {
+            Consume(VoxelizeTriangles(std::move(triangles), 8).GetVoxelCount());
+        });
+    }});
+
+    benchmarks.push_back({"Terrain.Generate." + std::to_string(mapSize), mapSize * mapSize, [] {
+        return Measure([] {
+            Consume(GenerateTerrain(mapSize).GetVoxelCount());
+        });
+    }});
+
+    auto noisePoints = std::make_shared<std::vector<float> >(noiseCount * 3);
+    math::random::SetSeed(4);
+    for (float &value: *noisePoints)
+        value = math::random::RandomFloat() * 64.0f;
+
+    benchmarks.push_back({"Noise.Scalar", noiseCount, [=] {
+        const siv::PerlinNoise noise(5);
+        const float *p = noisePoints->data();
+        return Measure([&] {
+            double sum = 0.0;
+            for (uint32 i = 0; i < noiseCount; ++i)
+                sum += noise.noise3D(p[i], p[i + noiseCount], p[i + 2 * noiseCount]);
+            Consume(sum);
+        });
+    }});
+
+    benchmarks.push_back({string("Noise.Batch.") + math::PerlinNoiseBatch::GetInstructionSet(), noiseCount, [=] {
+        const math::PerlinNoiseBatch noise(siv::PerlinNoise(5));
+        const float *p = noisePoints->data();
+        std::vector<float> result(noiseCount);
+        return Measure([&] {
+            noise.Noise3D(p, p + noiseCount, p + 2 * noiseCount, result.data(), noiseCount);
+        });
+    }});
+
+    return benchmarks;
+}
+
+// Steps and bricks taken by the ray cast benchmarks, these do not depend on the machine.
+static void
+PrintTraversalStatistics() {
+    BrickMap terrain = GenerateTerrain(mapSize);
+    const std::pair<const char *, std::vector<math::Ray> > raySets[] = {
+        {"RayCast.Random", RandomRays(terrain.GetBoundingBox())},
+        {"RayCast.Coherent", CameraRays(terrain.GetBoundingBox())},
+    };
+    for (const auto &[name, rays]: raySets) {
+        TraversalRecorder recorder(terrain.GetBricks().size());
+        for (const math::Ray &ray: rays)
+            terrain.RayCast(ray, 0.0f, &recorder);
+
+        std::cout << '\n' << name << '\n';
+        recorder.GetStatistics().Print(std::cout);
+    }
+}
+
+// Steps saved by reprojection along the camera path of the Reprojection benchmarks, and the pixels whose hit differs
+// from tracing the frame from scratch.
+static void
+PrintReprojectionStatistics() {
+    BrickMap terrain = GenerateTerrain(mapSize);
+    TemporalReprojection reprojected({}), traced({});
+    uint64 stepsReprojected = 0, stepsTraced = 0, reprojectedPixels = 0, retracedPixels = 0, mismatches = 0;
+    for (uint32 frame = 0; frame < frameCount; ++frame) {
+        const Camera camera = SlowCamera(terrain, frame);
+        TraversalRecorder reprojectedRecorder, tracedRecorder;
+        reprojected.Render(terrain, camera, frameWidth, frameHeight, &reprojectedRecorder);
+        traced.Invalidate();
+        traced.Render(terrain, camera, frameWidth, frameHeight, &tracedRecorder);
+        // The first frame has nothing to reproject.
+        if (frame == 0)
+            continue;
+
+        const TraversalStatistics &a = reprojectedRecorder.GetStatistics(), &b = tracedRecorder.GetStatistics();
+        stepsReprojected += a.coarseStepTotal + a.fineStepTotal;
+        stepsTraced += b.coarseStepTotal + b.fineStepTotal;
+        reprojectedPixels += reprojected.GetStatistics().reprojectedCount;
+        retracedPixels += reprojected.GetStatistics().retracedCount;
+        for (uint32 i = 0; i < frameWidth * frameHeight; ++i) {
+            mismatches += reprojected.GetDepths()[i] != traced.GetDepths()[i] ||
+                    reprojected.GetBricks()[i] != traced.GetBricks()[i];
+        }
+    }
+
+    const double pixels = static_cast<double>(frameCount - 1) * frameWidth * frameHeight;
+    std::cout << "\nReprojection: " << frameCount - 1 << " frames of " << frameWidth << 'x' << frameHeight << '\n'
+            << std::setprecision(4)
+            << "  steps/pixel: " << static_cast<double>(stepsReprojected) / pixels << " reprojected, "
+            << static_cast<double>(stepsTraced) / pixels << " traced\n"
+            << "  reprojected pixels: " << 100.0 * static_cast<double>(reprojectedPixels) / pixels << "%, retraced: "
+            << 100.0 * static_cast<double>(retracedPixels) / pixels << "%, hits differing from a full trace: "
+            << mismatches << '\n';
+}
+
+// Coarse steps saved by the beam pre-pass on the scenes of the Beam benchmarks, and the pixels whose hit differs from
+// tracing from the grid entry.
+static void
+PrintBeamStatistics() {
+    for (const string scene: {"Terrain", "Spheres"}) {
+        BrickMap map = scene == "Terrain" ? GenerateTerrain(mapSize) : SparseSpheres();
+        const Camera camera = OverviewCamera(map);
+        BeamPrepass beam({});
+        beam.Build(map);
+        beam.Trace(map, camera, frameWidth, frameHeight);
+
+        TraversalRecorder beamRecorder, tracedRecorder;
+        const std::vector<ivec3> beamHits = TraceFrame(map, camera, &beam, &beamRecorder);
+        const std::vector<ivec3> tracedHits = TraceFrame(map, camera, nullptr, &tracedRecorder);
+        uint32 mismatches = 0;
+        for (uint32 i = 0; i < beamHits.size(); ++i)
+            mismatches += beamHits[i] != tracedHits[i];
+
+        const TraversalStatistics &a = beamRecorder.GetStatistics(), &b = tracedRecorder.GetStatistics();
+        const double pixels = static_cast<double>(frameWidth) * frameHeight;
+        const BeamPrepass::Statistics &statistics = beam.GetStatistics();
+        std::cout << "\nBeam " << scene << ": " << statistics.tileCount << " tiles of " << beam.GetSettings().tileSize
+                << " pixels" << std::setprecision(4) << ", "
+                << static_cast<double>(statistics.stepCount) / statistics.tileCount << " steps/tile\n"
+                << "  coarse steps/pixel: " << static_cast<double>(a.coarseStepTotal) / pixels << " with beam, "
+                << static_cast<double>(b.coarseStepTotal) / pixels << " from the grid entry\n"
+                << "  fine steps/pixel: " << static_cast<double>(a.fineStepTotal) / pixels << " with beam, "
+                << static_cast<double>(b.fineStepTotal) / pixels << " from the grid entry\n"
+                << "  hits differing from a full trace: " << mismatches << '\n';
+    }
+}
+
+// Quality of variable rate frames against tracing every pixel, and the rays and steps they take.
+static void
+PrintVariableRateStatistics() {
+    for (const string scene: {"Terrain", "Overview", "Spheres"}) {
+        BrickMap map = scene == "Spheres" ? SparseSpheres() : GenerateTerrain(mapSize);
+        const Camera camera = scene == "Terrain" ? SlowCamera(map, 0) : OverviewCamera(map);
+        VariableRateTracer variable({}), full({});
+        TraversalRecorder variableRecorder, fullRecorder;
+        variable.Render(map, camera, frameWidth, frameHeight, &variableRecorder);
+        full.RenderFull(map, camera, frameWidth, frameHeight, &fullRecorder);
+
+        const VariableRateTracer::Statistics &statistics = variable.GetStatistics();
+        const TraversalStatistics &a = variableRecorder.GetStatistics(), &b = fullRecorder.GetStatistics();
+        std::cout << "\nVariableRate " << scene << ": " << frameWidth << 'x' << frameHeight << ", blocks of "
+                << variable.GetSettings().spacing << " pixels\n" << std::setprecision(4)
+                << "  PSNR: " << VariableRateTracer::ComputePsnr(variable.GetImage(), full.GetImage()) << " dB\n"
+                << "  rays: " << 100.0 * statistics.rayCount / statistics.pixelCount << "% of the pixels, "
+                << "refined blocks: " << 100.0 * statistics.refinedBlockCount / statistics.blockCount << "%\n"
+                << "  coarse steps: " << 100.0 * a.coarseStepTotal / b.coarseStepTotal << "%, fine steps: "
+                << 100.0 * a.fineStepTotal / b.fineStepTotal << "% of tracing every pixel\n";
+    }
+}
+
+// Quality of every render target format in the separate and fused post process against the separate one in RGBA32F,
+// and the full screen memory traffic they take.
+static void
+PrintPostProcessComparison() {
+    constexpr TextureFormat formats[] = {TextureFormat::Rgba32f, TextureFormat::Rgba8, TextureFormat::R11G11B10f};
+    for (const string scene: {"Terrain", "Overview"}) {
+        BrickMap map = GenerateTerrain(mapSize);
+        const Camera camera = scene == "Terrain" ? SlowCamera(map, 0) : OverviewCamera(map);
+        VariableRateTracer tracer({});
+        tracer.RenderFull(map, camera, frameWidth, frameHeight);
+        // Doubled like under a brighter sun, so parts of the frame are above 1 where RGBA8 clamps linear colors.
+        std::vector<vec3> image = tracer.GetImage();
+        for (vec3 &color: image)
+            color *= 2.0f;
+
+        PostProcess reference({});
+        reference.Apply(image, frameWidth, frameHeight);
+        std::cout << "\nPostProcess " << scene << ": " << frameWidth << 'x' << frameHeight
+                << ", colors scaled by 2, against separate rgba32f\n" << std::setprecision(4);
+        for (const bool fused: {false, true}) {
+            for (const TextureFormat format: formats) {
+                PostProcess::Settings settings;
+                settings.format = format;
+                settings.fused = fused;
+                PostProcess postProcess(settings);
+                postProcess.Apply(image, frameWidth, frameHeight);
+                const PostProcess::Statistics &statistics = postProcess.GetStatistics();
+                std::cout << "  " << (fused ? "fused    " : "separate ") << std::setw(15) << std::left
+                        << Texture::GetFormatQualifier(format) << std::right << "PSNR "
+                        << std::setw(6) << VariableRateTracer::ComputePsnr(postProcess.GetImage(), reference.GetImage())
+                        << " dB, " << std::setw(2) << statistics.bytesWritten << " bytes/pixel written, "
+                        << std::setw(2) << statistics.bytesRead << " read\n";
+            }
+        }
+    }
+}
+
+static void
+PrintUsage() {
+    std::cout << "Usage: vox_bench [options]\n"
+            << "\t--filter text        Only run benchmarks whose name contains text.\n"
+            << "\t--repetitions n      Measured repetitions per benchmark, defaults to 5.\n"
+            << "\t--threads n          Worker threads, defaults to 1 so results are comparable between machines.\n"
+            << "\t--output path        JSON results, defaults to \"bench.json\".\n"
+            << "\t--baseline path      Results to compare against, exits with 1 on regressions.\n"
+            << "\t--tolerance f        Allowed slowdown against the baseline, defaults to 0.1 (10%).\n"
+            << "\t--traversal-stats    Print step and brick histograms of the ray cast benchmarks.\n"
+            << "\t--reprojection       Print the steps saved by reprojection and the pixels it got wrong.\n"
+            << "\t--beam               Print the steps saved by the beam pre-pass and the pixels it got wrong.\n"
+            << "\t--variable-rate      Print the PSNR and the rays saved by variable rate tracing.\n"
+            << "\t--post-process       Print the PSNR and memory traffic of the render target formats.\n";
+}
+
+int
+main(int argc, char *argv[]) {
+    string filter, outputPath = "bench.json", baselinePath;
+    uint32 repetitions = 5, threadCount = 1;
+    double tolerance = 0.1;
+    bool traversalStatistics = false;
+    bool reprojectionStatistics = false;
+    bool beamStatistics = false;
+    bool variableRateStatistics = false;
+    bool postProcessComparison = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string option = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (option == "--filter" && hasValue) {
+                filter = argv[++i];
+            } else if (option == "--repetitions" && hasValue) {
+                repetitions = std::max(std::stoi(argv[++i]), 1);
+            } else if (option == "--threads" && hasValue) {
+                threadCount = std::stoi(argv[++i]);
+            } else if (option == "--output" && hasValue) {
+                outputPath = argv[++i];
+            } else if (option == "--baseline" && hasValue) {
+                baselinePath = argv[++i];
+            } else if (option == "--tolerance" && hasValue) {
+                tolerance = std::stod(argv[++i]);
+            } else if (option == "--traversal-stats") {
+                traversalStatistics = true;
+            } else if (option == "--reprojection") {
+                reprojectionStatistics = true;
+            } else if (option == "--beam") {
+                beamStatistics = true;
+            } else if (option == "--variable-rate") {
+                variableRateStatistics = true;
+            } else if (option == "--post-process") {
+                postProcessComparison = true;
+            } else {
+                PrintUsage();
+                return 1;
+            }
+        }
+    } catch (const std::exception &) {
+        PrintUsage();
+        return 1;
+    }
+
+    parallel::SetThreadCount(threadCount);
+    std::cout << "Threads: " << parallel::GetThreadCount() << ", repetitions: " << repetitions << "\n\n";
+
+    std::vector<BenchmarkResult> results;
+    for (const Benchmark &benchmark: CreateBenchmarks()) {
+        if (!filter.empty() && benchmark.name.find(filter) == string::npos)
+            continue;
+
+        const BenchmarkResult &result = results.emplace_back(RunBenchmark(benchmark, repetitions));
+        std::cout << "  " << std::left << std::setw(32) << result.name << std::right << std::fixed
+                << std::setprecision(3) << std::setw(10) << result.medianSeconds * 1e3 << " ms"
+                << std::setprecision(1) << std::setw(12) << result.GetNanosecondsPerItem() << " ns/item\n";
+    }
+
+    if (traversalStatistics)
+        PrintTraversalStatistics();
+    if (reprojectionStatistics)
+        PrintReprojectionStatistics();
+    if (beamStatistics)
+        PrintBeamStatistics();
+    if (variableRateStatistics)
+        PrintVariableRateStatistics();
+    if (postProcessComparison)
+        PrintPostProcessComparison();
+
+    if (!WriteResults(outputPath, results, parallel::GetThreadCount()))
+        return 1;
+
+    if (!baselinePath.empty()) {
+        const auto baseline = ReadResults(baselinePath);
+        if (!baseline)
+            return 1;
+        if (CompareResults(results, *baseline, tolerance) > 0)
+            return 1;
+    }
+    return 0;
+}
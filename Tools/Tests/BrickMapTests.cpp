@@ -0,0 +1,219 @@
+#include "Tests.hpp"
+#include "DataStructures/BrickMap.hpp"
+#include "Math/Random.hpp"
+
+#include <algorithm>
+#include <bit>
+
+static bool
+InfosEqual(const BrickMap::BrickInfo &a, const BrickMap::BrickInfo &b) {
+    return a.voxelCount == b.voxelCount && std::equal(a.colorSum, a.colorSum + 3, b.colorSum) &&
+           a.min == b.min && a.max == b.max && a.boundsDirty == b.boundsDirty;
+}
+
+static bool
+LodsEqual(const BrickMap::BrickLod &a, const BrickMap::BrickLod &b) {
+    const auto colorsEqual = [](const math::Color &x, const math::Color &y) { return x.data == y.data; };
+    return std::equal(a.occupancy4, a.occupancy4 + 2, b.occupancy4) && a.occupancy2 == b.occupancy2 &&
+           a.color.data == b.color.data && std::equal(a.colors4, a.colors4 + 64, b.colors4, colorsEqual) &&
+           std::equal(a.colors2, a.colors2 + 8, b.colors2, colorsEqual);
+}
+
+// The low bits of FastRandom repeat with short periods.
+static uint32
+RandomBelow(const uint32 count) {
+    return (math::random::FastRandom() >> 16) % count;
+}
+
+// A random solid voxel, the map must not be empty.
+static ivec3
+RandomSolidVoxel(const BrickMap &map) {
+    const uint32 brickIndex = RandomBelow(map.GetBricks().size());
+    const BrickMap::Brick &brick = map.GetBricks()[brickIndex];
+    // The first solid voxel from a random one on, bricks in the map are never empty.
+    uint32 bit = RandomBelow(BRICK_SIZE);
+    while (!brick.VoxelAt(bit))
+        bit = (bit + 1) % BRICK_SIZE;
+    const ivec3 local(bit % 8, bit / 8 % 8, bit / 64);
+    return map.GetCellPosition(map.GetParents()[brickIndex]) * 8 + local;
+}
+
+// Compares everything the edits maintain against a recomputation. BuildLod overwrites the LOD, which is only a
+// change if the maintained one was wrong.
+static bool
+CheckMaintainedState(BrickMap &map) {
+    int32 voxelCount = 0;
+    for (uint32 i = 0; i < map.GetBricks().size(); ++i) {
+        for (const uint32 word: map.GetBricks()[i].bitmask)
+            voxelCount += std::popcount(word);
+
+        // Bounds left loose by a delete are resolved by GetBrickInfo.
+        if (!CHECK(InfosEqual(map.GetBrickInfo(i), map.ComputeBrickInfo(i))))
+            return false;
+
+        const BrickMap::BrickLod lod = map.GetBrickLods()[i];
+        map.BuildLod(i);
+        if (!CHECK(LodsEqual(lod, map.GetBrickLods()[i])))
+            return false;
+    }
+    return CHECK(map.GetVoxelCount() == voxelCount);
+}
+
+// Every texture is referenced by as many bricks as its count says, so no texture is left without a brick.
+static bool
+CheckTextureReferences(const BrickMap &map) {
+    std::vector<uint32> counts(map.GetBrickTextures().size(), 0);
+    for (const uint32 colorPointer: map.GetColorPointers()) {
+        if (!CHECK(colorPointer < counts.size()))
+            return false;
+        counts[colorPointer]++;
+    }
+    for (uint32 i = 0; i < counts.size(); ++i) {
+        if (!CHECK(counts[i] == map.GetBrickTextures()[i].referenceCount))
+            return false;
+    }
+    return true;
+}
+
+// Bricks of one voxel each with their own texture, or sharing one of two textures like maps filled with a single
+// color, removed in random order and sorted in between. Every removal has to release the right texture, sorting must
+// not copy shared textures, and both have to keep the colors of the other bricks.
+void
+TestSharedTextures() {
+    constexpr uint32 sharedCount = 2;
+    BrickMap map(vec3(0.0f), ivec3(32), 1.0f);
+    math::random::SetSeed(26);
+    for (uint32 i = 0; i < sharedCount; ++i) {
+        BrickMap::BrickTexture &texture = map.GetBrickTextures().emplace_back();
+        std::fill_n(texture.voxels, BRICK_SIZE, math::Color(math::random::FastRandom() | 0xFFu));
+    }
+
+    struct Voxel {
+        ivec3 position;
+        math::Color color;
+    };
+    std::vector<Voxel> voxels;
+    for (uint32 cell = 0; cell < 64; ++cell) {
+        const ivec3 position = ivec3(cell % 4, cell / 4 % 4, cell / 16) * 8 + ivec3(RandomBelow(8));
+        const uint32 texture = RandomBelow(sharedCount + 1);
+        if (texture < sharedCount) {
+            map.Insert(position, texture);
+            voxels.push_back({position, map.GetBrickTextures()[texture].voxels[0]});
+        } else {
+            const math::Color color(math::random::FastRandom() | 0xFFu);
+            map.Insert(position, color);
+            voxels.push_back({position, color});
+        }
+    }
+    if (!CheckTextureReferences(map))
+        return;
+
+    for (uint32 step = 0; !voxels.empty(); ++step) {
+        if (step % 16 == 0) {
+            const size_t textureCount = map.GetBrickTextures().size();
+            map.SortBricks();
+            if (!CHECK(map.GetBrickTextures().size() <= textureCount))
+                return;
+        }
+
+        const uint32 removed = RandomBelow(voxels.size());
+        const auto result = map.RemoveBrick(map.GetCellIndex(voxels[removed].position / 8));
+        if (!CHECK(result.has_value()))
+            return;
+        voxels.erase(voxels.begin() + removed);
+
+        if (!CheckTextureReferences(map) || !CheckMaintainedState(map))
+            return;
+        for (const Voxel &voxel: voxels) {
+            const auto color = map.GetVoxel(voxel.position);
+            if (!CHECK(color && color->data == voxel.color.data))
+                return;
+        }
+    }
+    CHECK(map.GetBrickTextures().empty());
+}
+
+// Random inserts, replacing and not, deletes and brick removals in a map of 2^3 bricks. Edits cluster around the
+// middle of a brick, half of the deletes hit a solid voxel, and phases that mostly insert alternate with phases that
+// mostly delete, so bricks fill up, empty out and have their bounds shrink.
+void
+TestBrickInfo() {
+    constexpr uint32 stepCount = 6000, phaseSteps = 500;
+    BrickMap map(vec3(0.0f), ivec3(16), 1.0f);
+    math::random::SetSeed(27);
+
+    const auto randomPosition = [](const uint32 size) {
+        return ivec3(RandomBelow(size), RandomBelow(size), RandomBelow(size));
+    };
+
+    uint32 insertCount = 0, replaceCount = 0, deleteCount = 0, emptiedCount = 0, removeCount = 0;
+    for (uint32 step = 0; step < stepCount; ++step) {
+        const ivec3 brick = randomPosition(2);
+        const ivec3 position = brick * 8 + randomPosition(5) + randomPosition(4);
+        const uint32 operation = RandomBelow(1000);
+        const bool inserting = step / phaseSteps % 2 == 0;
+
+        if (operation < 3) {
+            // Removes a brick that may still hold voxels.
+            removeCount += map.RemoveBrick(map.GetCellIndex(brick)).has_value();
+        } else if (operation < (inserting ? 700 : 150)) {
+            const bool replace = RandomBelow(2) == 0;
+            const bool solid = map.IsSolid(position);
+            const auto result = map.Insert(position, math::Color(math::random::FastRandom() | 0xFFu), replace);
+            if (!CHECK(result.has_value() == (!solid || replace)))
+                return;
+            insertCount += !solid;
+            replaceCount += solid && replace;
+        } else {
+            const bool hit = !map.GetBricks().empty() && RandomBelow(2) == 0;
+            const auto result = map.Delete(hit ? RandomSolidVoxel(map) : position);
+            if (!CHECK(result.has_value() || !hit))
+                return;
+            if (result) {
+                deleteCount++;
+                // Empty bricks are removed like the app does.
+                if (result->isEmpty) {
+                    emptiedCount++;
+                    map.RemoveBrick(result->cellIndex);
+                }
+            }
+        }
+
+        if (!CheckMaintainedState(map)) {
+            std::cerr << "  after step " << step << '\n';
+            return;
+        }
+    }
+
+    // Every kind of edit was exercised.
+    CHECK(insertCount > 0 && replaceCount > 0 && deleteCount > 0 && emptiedCount > 0 && removeCount > 0);
+}
+
+// Fill on a map that already has voxels keeps them, recolors the ones inside the noise volume and adds the rest of the
+// volume like on an empty map.
+void
+TestFillNonEmpty() {
+    BrickMap filled(vec3(0.0f), ivec3(128), 1.0f);
+    filled.Fill();
+    BrickMap map(vec3(0.0f), ivec3(128), 1.0f);
+    math::random::SetSeed(30);
+    std::vector<ivec3> inserted;
+    for (uint32 i = 0; i < 200; ++i) {
+        const ivec3 position(RandomBelow(128), RandomBelow(128), RandomBelow(128));
+        if (map.Insert(position, math::Color(0xFF0000FFu), false))
+            inserted.push_back(position);
+    }
+    map.Fill();
+    if (!CHECK(filled.GetVoxelCount() > 0) || !CheckMaintainedState(map) || !CheckTextureReferences(map))
+        return;
+
+    int32 added = 0;
+    for (const ivec3 &position: inserted) {
+        const auto color = map.GetVoxel(position);
+        const auto filledColor = filled.GetVoxel(position);
+        if (!CHECK(color && color->data == (filledColor ? *filledColor : math::Color(0xFF0000FFu)).data))
+            return;
+        added += !filledColor;
+    }
+    CHECK(map.GetVoxelCount() == filled.GetVoxelCount() + added);
+}
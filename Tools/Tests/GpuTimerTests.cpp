@@ -0,0 +1,152 @@
+#include "Tests.hpp"
+#include "Render/GpuTimer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Completes the queries of a frame a number of frames after they ended, like a GPU running behind the CPU. Also
+// records reads of a query whose frame has not finished, which GL could only answer by stalling.
+class FakeQueryBackend final : public GpuQueryBackend {
+public:
+    uint32 Create() override {
+        m_Queries.emplace_back();
+        return m_Queries.size() - 1;
+    }
+
+    void Destroy(uint32) override {}
+
+    void Begin(uint32) override {}
+
+    void End(const uint32 query) override {
+        Query &state = m_Queries[query];
+        state.endFrame = m_Frame;
+        state.readyFrame = m_Frame + m_Latency;
+        state.nanoseconds = m_NextNanoseconds;
+        m_LastQueries[m_Frame] = query;
+    }
+
+    bool TryGetResult(const uint32 query, uint64 &nanoseconds) override {
+        const Query &state = m_Queries[query];
+        const uint32 lastQuery = m_LastQueries[state.endFrame];
+        if (query != lastQuery && !IsReady(lastQuery))
+            m_EarlyReadCount++;
+        if (!IsReady(query)) {
+            m_FailedPollCount++;
+            return false;
+        }
+        nanoseconds = state.nanoseconds;
+        return true;
+    }
+
+    void NextFrame() { m_Frame++; }
+
+    // Frames until the queries ending from now on are available.
+    void SetLatency(const uint32 frames) { m_Latency = frames; }
+
+    // Result of the next query that ends.
+    void SetNextDuration(const float ms) { m_NextNanoseconds = static_cast<uint64>(std::llround(ms * 1e6)); }
+
+    uint32 GetEarlyReadCount() const { return m_EarlyReadCount; }
+
+    uint32 GetFailedPollCount() const { return m_FailedPollCount; }
+
+private:
+    struct Query {
+        uint32 endFrame = 0;
+        uint32 readyFrame = 0;
+        uint64 nanoseconds = 0;
+    };
+
+    bool IsReady(const uint32 query) const { return m_Frame >= m_Queries[query].readyFrame; }
+
+    std::vector<Query> m_Queries;
+    // Last query that ended in every frame.
+    std::unordered_map<uint32, uint32> m_LastQueries;
+    uint32 m_Frame = 0;
+    uint32 m_Latency = 1;
+    uint64 m_NextNanoseconds = 0;
+    uint32 m_EarlyReadCount = 0;
+    uint32 m_FailedPollCount = 0;
+};
+
+static const GpuTimerPool::PassStatistics *
+FindPass(const GpuTimerPool &pool, const string &name) {
+    for (const GpuTimerPool::PassStatistics &pass: pool.GetStatistics()) {
+        if (pass.name == name)
+            return &pass;
+    }
+    return nullptr;
+}
+
+static bool
+NearlyEqual(const float a, const float b) {
+    return std::abs(a - b) <= 1e-4f * std::max(1.0f, std::abs(b));
+}
+
+// Records frames with two passes into a ring of 3 sets. The GPU is one frame behind, except for every tenth frame
+// which takes five frames and so is still pending when its set comes round again. Those frames are dropped, the
+// frames behind them are collected once the set is free, and the statistics cover the last 120 collected frames.
+void
+TestGpuTimerRing() {
+    constexpr uint32 frameCount = 300, ringSize = 3, slowLatency = 5;
+    const auto traceMs = [](const uint32 frame) { return 1.0f + static_cast<float>(frame * 7 % 13) * 0.25f; };
+    const auto blitMs = [](const uint32 frame) { return 0.5f + static_cast<float>(frame % 3) * 0.1f; };
+    const auto isSlow = [](const uint32 frame) { return frame % 10 == 5; };
+
+    auto ownedBackend = std::make_unique<FakeQueryBackend>();
+    FakeQueryBackend &backend = *ownedBackend;
+    GpuTimerPool pool(std::move(ownedBackend), ringSize);
+
+    for (uint32 frame = 0; frame < frameCount; ++frame) {
+        if (frame > 0)
+            backend.NextFrame();
+        const uint32 failedPollsBefore = backend.GetFailedPollCount();
+        pool.BeginFrame();
+        // A frame that is not done stops the collection, nothing behind it is polled.
+        if (!CHECK(backend.GetFailedPollCount() - failedPollsBefore <= 1))
+            return;
+        // Nothing is available before the first frame finished.
+        if (frame <= 1 && !CHECK(pool.GetStatistics().empty() == (frame == 0)))
+            return;
+
+        backend.SetLatency(isSlow(frame) ? slowLatency : 1);
+        backend.SetNextDuration(traceMs(frame));
+        pool.Begin("Trace");
+        pool.End();
+        backend.SetNextDuration(blitMs(frame));
+        pool.Begin("Blit");
+        pool.End();
+    }
+
+    // No query was read before the last query of its frame was available.
+    CHECK(backend.GetEarlyReadCount() == 0);
+
+    // Every slow frame was dropped when its set was reused three frames later, all others up to the previous frame
+    // were collected.
+    std::vector<uint32> collected;
+    uint32 slowCount = 0;
+    for (uint32 frame = 0; frame + 1 < frameCount; ++frame) {
+        if (isSlow(frame))
+            slowCount++;
+        else
+            collected.push_back(frame);
+    }
+    CHECK(pool.GetDroppedFrameCount() == slowCount);
+    CHECK(pool.GetCollectedFrameCount() == collected.size());
+
+    const uint32 windowStart = collected.size() - GpuTimerPool::historySize;
+    for (const auto &[name, passMs]: {std::pair("Trace", +traceMs), std::pair("Blit", +blitMs)}) {
+        const GpuTimerPool::PassStatistics *pass = FindPass(pool, name);
+        if (!CHECK(pass != nullptr))
+            continue;
+
+        float sum = 0.0f, max = 0.0f;
+        for (uint32 i = windowStart; i < collected.size(); ++i) {
+            sum += passMs(collected[i]);
+            max = std::max(max, passMs(collected[i]));
+        }
+        CHECK(NearlyEqual(pass->lastMs, passMs(collected.back())));
+        CHECK(NearlyEqual(pass->averageMs, sum / GpuTimerPool::historySize));
+        CHECK(NearlyEqual(pass->maxMs, max));
+    }
+}
@@ -0,0 +1,81 @@
+#include "Tests.hpp"
+#include "App/Terrain.hpp"
+#include "Render/Lighting/RadianceCache.hpp"
+#include "Utility/Parallel.hpp"
+
+#include <array>
+#include <numbers>
+
+// Irradiance of the six faces of a probe, integrated with the midpoint rule over a latitude-longitude grid.
+static std::array<vec3, 6>
+IntegrateIrradiance(const RadianceCache &cache, BrickMap &bm, const vec3 &position) {
+    constexpr uint32 thetaSteps = 64, phiSteps = 128;
+    constexpr float pi = std::numbers::pi_v<float>;
+    std::array<vec3, 6> irradiance{};
+    for (uint32 t = 0; t < thetaSteps; ++t) {
+        const float theta = (static_cast<float>(t) + 0.5f) * pi / thetaSteps;
+        const float solidAngle = std::sin(theta) * (pi / thetaSteps) * (2.0f * pi / phiSteps);
+        for (uint32 p = 0; p < phiSteps; ++p) {
+            const float phi = (static_cast<float>(p) + 0.5f) * 2.0f * pi / phiSteps;
+            const vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            const vec3 radiance = cache.TraceRadiance(bm, position, direction);
+            const float weights[6] = {direction.x, -direction.x, direction.y, -direction.y, direction.z, -direction.z};
+            for (uint32 face = 0; face < 6; ++face)
+                irradiance[face] += radiance * std::max(weights[face], 0.0f) * solidAngle;
+        }
+    }
+    return irradiance;
+}
+
+// Refines the probes of a terrain and compares every 4th of them against a brute-force integration. The relative RMS
+// error falls with the square root of the samples per probe, so it has to about halve whenever the samples quadruple.
+// At 4096 samples it is 3%, the bound leaves room for the noise of the estimate and the error of the reference.
+void
+TestRadianceConvergence() {
+    constexpr uint32 maxSamples = 4096;
+    constexpr double minReduction = 1.5, maxError = 0.035;
+    BrickMap terrain = GenerateTerrain(128);
+    RadianceCache cache({});
+    cache.Build(terrain);
+    const std::vector<RadianceCache::Probe> &probes = cache.GetProbes();
+    if (!CHECK(!probes.empty()))
+        return;
+
+    std::vector<uint32> checked;
+    for (uint32 i = 0; i < probes.size(); i += 4)
+        checked.push_back(i);
+    std::vector<std::array<vec3, 6> > reference(checked.size());
+    parallel::For(checked.size(), [&](const uint32 i, uint32) {
+        reference[i] = IntegrateIrradiance(cache, terrain, probes[checked[i]].position);
+    });
+
+    const uint32 raysPerUpdate = RadianceCache::Settings().raysPerUpdate;
+    const uint32 probeRays = static_cast<uint32>(probes.size()) * raysPerUpdate;
+    uint32 samples = 0;
+    double previousError = std::numeric_limits<double>::max(), error = 0.0;
+    for (uint32 target = 16; target <= maxSamples; target *= 4) {
+        while (samples < target) {
+            cache.Update(terrain, probeRays);
+            samples += raysPerUpdate;
+        }
+
+        double errorSq = 0.0, referenceSq = 0.0;
+        for (uint32 i = 0; i < checked.size(); ++i) {
+            const RadianceCache::ProbeIrradiance irradiance = cache.GetProbeIrradiance(checked[i]);
+            for (uint32 face = 0; face < 6; ++face) {
+                const vec3 difference = vec3(irradiance.faces[face]) - reference[i][face];
+                errorSq += dot(difference, difference);
+                referenceSq += dot(reference[i][face], reference[i][face]);
+            }
+        }
+        error = std::sqrt(errorSq / referenceSq);
+        if (!CHECK(error * minReduction < previousError)) {
+            std::cerr << "  relative RMS error " << error << " at " << samples << " samples/probe\n";
+            return;
+        }
+        previousError = error;
+    }
+
+    if (!CHECK(error < maxError))
+        std::cerr << "  relative RMS error " << error << " at " << samples << " samples/probe\n";
+}
@@ -0,0 +1,77 @@
+#include "Tests.hpp"
+#include "Math/Random.hpp"
+#include "Render/ResolutionController.hpp"
+
+#include <cmath>
+
+static bool
+IsOnStep(const ResolutionController &controller) {
+    const float steps = controller.GetScale() / controller.GetSettings().scaleStep;
+    return std::abs(steps - std::round(steps)) < 1e-3f;
+}
+
+// Runs the controller on synthetic frame times. A frame takes a fixed overhead plus a trace cost that grows with the
+// pixel count, times the load of the phase, with 3% noise, and its time is only known two frames later like GPU timer
+// results. Within four decisions after every load step the scale has to reach one whose frame time without the noise
+// is within the tolerance around the budget, or under it at the maximum scale, and stay at such scales. The noise
+// widens the tolerance, since the controller only sees noisy averages.
+void
+TestResolutionSettle() {
+    constexpr float overheadMs = 2.0f, traceMs = 22.0f, noiseAmount = 0.03f;
+    constexpr uint32 phaseFrames = 300, latency = 2, settleDecisions = 4;
+    constexpr float loads[] = {1.0f, 2.0f, 0.5f, 1.0f, 2.0f, 1.0f};
+
+    ResolutionController controller({});
+    const ResolutionController::Settings &settings = controller.GetSettings();
+    const uint32 settleFrames = settleDecisions * (settings.windowFrames + settings.latencyFrames);
+    const auto frameMs = [&](const float scale, const float load) {
+        return (overheadMs + traceMs * scale * scale) * load;
+    };
+    const auto isSettled = [&](const float scale, const float load) {
+        const float relative = frameMs(scale, load) / settings.budgetMs;
+        return std::abs(relative - 1.0f) <= settings.tolerance + noiseAmount ||
+               (scale == settings.maxScale && relative < 1.0f);
+    };
+
+    math::random::SetSeed(48);
+    std::vector<float> pending(latency, 0.0f);
+    for (const float load: loads) {
+        for (uint32 frame = 0; frame < phaseFrames; ++frame) {
+            const float noise = 1.0f + (math::random::RandomFloat() * 2.0f - 1.0f) * noiseAmount;
+            pending.push_back(frameMs(controller.GetScale(), load) * noise);
+            controller.Update(pending.front());
+            pending.erase(pending.begin());
+
+            if (!CHECK(IsOnStep(controller)) ||
+                !CHECK(controller.GetScale() >= settings.minScale && controller.GetScale() <= settings.maxScale) ||
+                (frame >= settleFrames && !CHECK(isSettled(controller.GetScale(), load)))) {
+                std::cerr << "  scale " << controller.GetScale() << " at frame " << frame << " with load " << load
+                        << '\n';
+                return;
+            }
+        }
+    }
+}
+
+// Frames right after a change were timed at the previous scale and must not count towards the next decision. A frame
+// far over budget lowers the scale, then the frames still in flight from before report times far under budget. If
+// they were averaged in, the next window would raise the scale again.
+void
+TestResolutionLatency() {
+    ResolutionController controller({});
+    const ResolutionController::Settings &settings = controller.GetSettings();
+    for (uint32 frame = 0; frame < settings.windowFrames; ++frame)
+        controller.Update(settings.budgetMs * 2.0f);
+    const float scale = controller.GetScale();
+    if (!CHECK(scale < settings.maxScale) || !CHECK(controller.GetStatistics().changeCount == 1))
+        return;
+
+    for (uint32 frame = 0; frame < settings.latencyFrames; ++frame)
+        controller.Update(settings.budgetMs * 0.1f);
+    for (uint32 frame = 0; frame < settings.windowFrames; ++frame)
+        controller.Update(settings.budgetMs);
+
+    CHECK(controller.GetScale() == scale);
+    CHECK(controller.GetStatistics().changeCount == 1);
+    CHECK(controller.GetStatistics().averageMs == settings.budgetMs);
+}
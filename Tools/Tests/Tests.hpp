@@ -0,0 +1,27 @@
+#pragma once
+
+// Headless checks of engine logic that does not need a GL context. Tests use fixed seeds and report every failed
+// check, vox_tests exits with 1 if any of them failed.
+
+// Reports a failed check and returns the condition, so a test can stop at its first failure.
+bool Check(bool condition, const char *expression, const char *file, int line);
+
+#define CHECK(condition) Check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+// BrickMapTests.cpp
+void TestBrickInfo();
+
+void TestSharedTextures();
+
+void TestFillNonEmpty();
+
+// GpuTimerTests.cpp
+void TestGpuTimerRing();
+
+// RadianceCacheTests.cpp
+void TestRadianceConvergence();
+
+// ResolutionControllerTests.cpp
+void TestResolutionSettle();
+
+void TestResolutionLatency();
@@ -0,0 +1,67 @@
+#include "Tests.hpp"
+
+#include <functional>
+
+struct Test {
+    string name;
+    std::function<void()> run;
+};
+
+static uint32 s_FailureCount = 0;
+
+bool
+Check(const bool condition, const char *expression, const char *file, const int line) {
+    if (!condition) {
+        std::cerr << file << ':' << line << ": check failed: " << expression << '\n';
+        s_FailureCount++;
+    }
+    return condition;
+}
+
+static void
+PrintUsage() {
+    std::cout << "Usage: vox_tests [options]\n"
+            << "\t--filter name        Only run tests whose name contains name.\n";
+}
+
+int
+main(int argc, char *argv[]) {
+    string filter;
+    for (int i = 1; i < argc; ++i) {
+        const string option = argv[i];
+        if (option == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    const std::vector<Test> tests = {
+        {"BrickMap.BrickInfo", TestBrickInfo},
+        {"BrickMap.SharedTextures", TestSharedTextures},
+        {"BrickMap.FillNonEmpty", TestFillNonEmpty},
+        {"GpuTimer.Ring", TestGpuTimerRing},
+        {"RadianceCache.Convergence", TestRadianceConvergence},
+        {"ResolutionController.Settle", TestResolutionSettle},
+        {"ResolutionController.Latency", TestResolutionLatency},
+    };
+
+    uint32 failedTestCount = 0;
+    for (const Test &test: tests) {
+        if (!filter.empty() && test.name.find(filter) == string::npos)
+            continue;
+
+        const uint32 failuresBefore = s_FailureCount;
+        test.run();
+        const bool passed = s_FailureCount == failuresBefore;
+        failedTestCount += !passed;
+        std::cout << (passed ? "  passed  " : "  FAILED  ") << test.name << '\n';
+    }
+
+    if (failedTestCount != 0) {
+        std::cout << failedTestCount << " tests failed\n";
+        return 1;
+    }
+    return 0;
+}
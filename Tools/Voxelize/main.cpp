@@ -0,0 +1,207 @@
+#include "DataStructures/BrickMapFile.hpp"
+#include "Render/Model/ObjLoader.hpp"
+#include "Render/Model/StreamingVoxelizer.hpp"
+#include "Render/Model/Voxelizer.hpp"
+#include "Render/Texture/Texture.hpp"
+#include "Utility/Memory.hpp"
+#include "Utility/Parallel.hpp"
+
+#include <filesystem>
+#include <iomanip>
+
+// Voxelizes a model into a brick map file without opening a window, for asset pipelines on machines without a GPU.
+
+struct Options {
+    string modelPath;
+    string outputPath;
+    uint32 subdivisions = 0;
+    uint32 threadCount = 0;
+    float voxelSize = 0.1f;
+    bool stream = false;
+    size_t memoryBudget = static_cast<size_t>(1) << 30;
+    string workDirectory = "voxelize";
+    bool useCache = true;
+};
+
+static void
+PrintUsage() {
+    std::cout << "Usage: voxelize <model> <output> <subdivisions> [options]\n"
+            << "\tmodel          Any format assimp can read, OBJ files can also be streamed from disk.\n"
+            << "\toutput         Brick map file to write.\n"
+            << "\tsubdivisions   The result is 2^n voxels on each side.\n"
+            << "Options:\n"
+            << "\t--threads n          Worker threads, defaults to the hardware concurrency.\n"
+            << "\t--voxel-size f       Size of a voxel, defaults to 0.1.\n"
+            << "\t--stream             Voxelize in bounded memory through bucket files on disk.\n"
+            << "\t--memory-budget mb   Memory budget of --stream, defaults to 1024.\n"
+            << "\t--work-directory d   Bucket files of --stream, defaults to \"voxelize\".\n"
+            << "\t--no-cache           Do not read or write the mesh cache.\n";
+}
+
+static bool
+ParseOptions(const int argc, char *argv[], Options &options) {
+    if (argc < 4)
+        return false;
+
+    try {
+        options.modelPath = argv[1];
+        options.outputPath = argv[2];
+        options.subdivisions = std::stoi(argv[3]);
+
+        for (int i = 4; i < argc; ++i) {
+            const string option = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (option == "--threads" && hasValue) {
+                options.threadCount = std::stoi(argv[++i]);
+            } else if (option == "--voxel-size" && hasValue) {
+                options.voxelSize = std::stof(argv[++i]);
+            } else if (option == "--stream") {
+                options.stream = true;
+            } else if (option == "--memory-budget" && hasValue) {
+                options.memoryBudget = static_cast<size_t>(std::stoull(argv[++i])) << 20;
+            } else if (option == "--work-directory" && hasValue) {
+                options.workDirectory = argv[++i];
+            } else if (option == "--no-cache") {
+                options.useCache = false;
+            } else {
+                std::cerr << "Unknown option \"" << option << "\"\n";
+                return false;
+            }
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Invalid number in arguments\n";
+        return false;
+    }
+
+    return options.subdivisions >= 3 && options.subdivisions <= 16;
+}
+
+// Prints how long a phase took and the peak memory so far.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(const char *name) : m_Name(name), m_Start(std::chrono::steady_clock::now()) {
+        std::cout << m_Name << "...\n";
+    }
+
+    ~PhaseTimer() {
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_Start;
+        std::cout << std::left << std::setw(12) << m_Name << std::right << std::fixed << std::setprecision(3)
+                << std::setw(10) << elapsed.count() << " s    peak memory " << std::setprecision(1)
+                << static_cast<double>(memory::GetPeakUsage()) / (1 << 20) << " mb\n";
+    }
+
+private:
+    const char *m_Name;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+static bool
+VoxelizeInMemory(const Options &options) {
+    const Model *model;
+    {
+        PhaseTimer timer("load");
+        model = &ObjLoader::Get().Load(options.modelPath);
+    }
+    if (model->meshes.empty()) {
+        std::cerr << "Failed to load model \"" << options.modelPath << "\"\n";
+        return false;
+    }
+
+    std::unique_ptr<OctreeMesh> octree;
+    {
+        PhaseTimer timer("subdivide");
+        octree = std::make_unique<OctreeMesh>(*model, options.subdivisions);
+    }
+
+    BrickMap brickMap;
+    {
+        PhaseTimer timer("fill");
+        brickMap = octree->CreateBrickMap(options.voxelSize);
+        octree.reset();
+        ObjLoader::Get().Remove(options.modelPath);
+    }
+
+    PhaseTimer timer("save");
+    BrickMapWriter writer(options.outputPath, vec3(0.0f), brickMap.GetDimensions(), options.voxelSize);
+    if (!writer.IsOpen())
+        return false;
+    writer.Write(brickMap);
+    std::cout << "Bricks: " << writer.GetBrickCount() << ", voxels: " << brickMap.GetVoxelCount() << '\n';
+    return writer.Close();
+}
+
+static bool
+VoxelizeStreaming(const Options &options) {
+    // OBJ files are read straight from disk, other formats have to be loaded as a whole first.
+    std::unique_ptr<TriangleStream> stream;
+    {
+        PhaseTimer timer("load");
+        if (std::filesystem::path(options.modelPath).extension() == ".obj") {
+            auto objStream = std::make_unique<ObjTriangleStream>(options.modelPath, options.workDirectory);
+            if (objStream->IsOpen())
+                stream = std::move(objStream);
+        } else {
+            const Model &model = ObjLoader::Get().Load(options.modelPath);
+            if (!model.meshes.empty())
+                stream = std::make_unique<ModelTriangleStream>(model);
+        }
+    }
+    if (!stream) {
+        std::cerr << "Failed to load model \"" << options.modelPath << "\"\n";
+        return false;
+    }
+
+    StreamingVoxelizer::Settings settings;
+    settings.subdivisions = options.subdivisions;
+    settings.voxelSize = options.voxelSize;
+    settings.memoryBudget = options.memoryBudget;
+    settings.workDirectory = options.workDirectory;
+    settings.onProgress = [lastPercent = -1](const float progress) mutable {
+        const int percent = static_cast<int>(progress * 100.0f);
+        if (percent != lastPercent)
+            std::cout << "\r" << percent << "%" << std::flush;
+        lastPercent = percent;
+    };
+
+    StreamingVoxelizer voxelizer(settings);
+    bool success;
+    {
+        PhaseTimer timer("voxelize");
+        success = voxelizer.Voxelize(*stream, options.outputPath);
+        std::cout << '\n';
+    }
+
+    const StreamingVoxelizer::Statistics &statistics = voxelizer.GetStatistics();
+    std::cout << "Triangles: " << statistics.triangleCount << ", buckets: " << statistics.bucketCount
+            << ", bricks: " << statistics.brickCount << ", voxels: " << statistics.voxelCount << '\n';
+    return success;
+}
+
+int
+main(int argc, char *argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    parallel::SetThreadCount(options.threadCount);
+    std::cout << "Threads: " << parallel::GetThreadCount() << '\n';
+
+    // Textures are only needed as images for coloring, there is no GL context to upload them to.
+    TextureManager::Get().SetUploadEnabled(false);
+    if (!options.useCache)
+        ObjLoader::Get().SetCacheDirectory("");
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool success = options.stream ? VoxelizeStreaming(options) : VoxelizeInMemory(options);
+    if (!success) {
+        std::cerr << "Failed to voxelize \"" << options.modelPath << "\"\n";
+        return 1;
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Wrote \"" << options.outputPath << "\" in " << std::fixed << std::setprecision(3)
+            << elapsed.count() << " s\n";
+    return 0;
+}
@@ -1,11 +1,40 @@
 #version 450 core
 
+#include "post.glsl"
+
 in vec2 uv;
 uniform sampler2D u_Image;
 
+// Fused post process, the trace already tonemapped the image and the FXAA of post.glsl runs here.
+uniform bool u_Fxaa;
+uniform float u_ThresholdMin;
+uniform float u_ThresholdMax;
+
 out vec4 frag;
 
+vec3
+Texel(ivec2 coords) {
+    return texelFetch(u_Image, clamp(coords, ivec2(0), textureSize(u_Image, 0) - 1), 0).rgb;
+}
+
+vec3
+FxaaTexel(ivec2 coords) {
+    return Fxaa(Texel(coords), Texel(coords + ivec2(-1, 0)), Texel(coords + ivec2(1, 0)),
+                Texel(coords + ivec2(0, -1)), Texel(coords + ivec2(0, 1)), u_ThresholdMin, u_ThresholdMax);
+}
+
 void main()
 {
-    frag = texture(u_Image, uv);
-}
\ No newline at end of file
+    if (!u_Fxaa) {
+        frag = texture(u_Image, uv);
+        return;
+    }
+
+    // Filtered like the texture, bilinear between the antialiased texels around the pixel.
+    const vec2 position = uv * vec2(textureSize(u_Image, 0)) - 0.5;
+    const ivec2 base = ivec2(floor(position));
+    const vec2 f = position - vec2(base);
+    const vec3 bottom = mix(FxaaTexel(base), FxaaTexel(base + ivec2(1, 0)), f.x);
+    const vec3 top = mix(FxaaTexel(base + ivec2(0, 1)), FxaaTexel(base + ivec2(1, 1)), f.x);
+    frag = vec4(mix(bottom, top, f.y), 1.0);
+}
@@ -0,0 +1,32 @@
+// Pixel pipeline after tracing, shared by fxaa.comp, rtBrickmap.comp and blit.frag. PostProcess is the CPU version.
+
+float
+rgb2luma(vec3 rgb) {
+    return sqrt(dot(rgb, vec3(0.299, 0.587, 0.114)));
+}
+
+// Fitted ACES curve, maps linear colors to [0, 1].
+vec3
+Tonemap(vec3 color, float exposure) {
+    const vec3 x = max(color * exposure, vec3(0.0));
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+// Averages a pixel with its four neighbours if the contrast between them is above the thresholds, absolute and
+// relative to the brightest of them.
+vec3
+Fxaa(vec3 pixel, vec3 left, vec3 right, vec3 down, vec3 up, float thresholdMin, float thresholdMax) {
+    const float pixelLuma = rgb2luma(pixel);
+    const float leftLuma = rgb2luma(left);
+    const float rightLuma = rgb2luma(right);
+    const float downLuma = rgb2luma(down);
+    const float upLuma = rgb2luma(up);
+
+    const float minLuma = min(min(pixelLuma, min(leftLuma, rightLuma)), min(downLuma, upLuma));
+    const float maxLuma = max(max(pixelLuma, max(leftLuma, rightLuma)), max(downLuma, upLuma));
+
+    if (maxLuma - minLuma < max(thresholdMin, maxLuma * thresholdMax)) {
+        return pixel;
+    }
+    return (pixel + left + right + up + down) / 5.0;
+}
@@ -0,0 +1,5 @@
+// Render texture, Renderer defines SCREEN_FORMAT to the qualifier of its format for the shaders that read it.
+#ifndef SCREEN_FORMAT
+#define SCREEN_FORMAT rgba32f
+#endif
+layout (SCREEN_FORMAT, binding = 0) uniform image2D screen;